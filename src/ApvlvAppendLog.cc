@@ -0,0 +1,180 @@
+/*
+ * This file is part of the apvlv package
+ * Copyright (C) <2024> Alf
+ *
+ * Contact: Alf <naihe2010@126.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+/* @CPPFILE ApvlvAppendLog.cc
+ *
+ *  Author: Alf <naihe2010@126.com>
+ */
+
+#include <QDebug>
+#include <filesystem>
+#include <fstream>
+#ifndef WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "ApvlvAppendLog.h"
+
+namespace apvlv
+{
+
+using namespace std;
+
+// flushes a written file to the disk
+static void
+syncFile (const string &path)
+{
+#ifndef WIN32
+  auto fd = open (path.c_str (), O_RDONLY);
+  if (fd < 0)
+    return;
+  fsync (fd);
+  close (fd);
+#endif
+}
+
+AppendLog::AppendLog (string path, string header)
+    : mPath (std::move (path)), mHeader (std::move (header))
+{
+}
+
+void
+AppendLog::load (const Reader &read)
+{
+  mRecords = 0;
+  mValid = false;
+  ifstream ifs{ mPath, ios::binary };
+  if (!ifs.is_open ())
+    return;
+
+  if (!mHeader.empty ())
+    {
+      string line;
+      getline (ifs, line);
+      if (line != mHeader)
+        {
+          qDebug () << QString::fromLocal8Bit (mPath)
+                    << " is stale, it is written again";
+          return;
+        }
+    }
+  mValid = true;
+
+  auto good = ifs.tellg ();
+  while (read (ifs))
+    {
+      mRecords++;
+      good = ifs.tellg ();
+    }
+
+  ifs.clear ();
+  ifs.seekg (0, ios::end);
+  auto end = ifs.tellg ();
+  ifs.close ();
+  if (good >= 0 && good < end)
+    {
+      error_code code;
+      filesystem::resize_file (mPath, static_cast<uintmax_t> (good), code);
+      qDebug () << "cut the broken tail of " << QString::fromLocal8Bit (mPath);
+    }
+}
+
+bool
+AppendLog::append (const Writer &write, bool sync)
+{
+  error_code code;
+  if (!mValid)
+    filesystem::create_directories (filesystem::path (mPath).parent_path (),
+                                    code);
+
+  ofstream ofs{ mPath, ios::binary | (mValid ? ios::app : ios::trunc) };
+  if (!ofs.is_open ())
+    {
+      qWarning () << "can't write " << QString::fromLocal8Bit (mPath);
+      return false;
+    }
+
+  if (!mValid && !mHeader.empty ())
+    ofs << mHeader << "\n";
+  ofs.seekp (0, ios::end);
+  write (ofs);
+  ofs.close ();
+  if (ofs.fail ())
+    return false;
+
+  mValid = true;
+  mRecords++;
+  if (sync)
+    syncFile (mPath);
+  return true;
+}
+
+bool
+AppendLog::rewrite (size_t live, const Writer &write, bool sync)
+{
+  auto temp = mPath + ".tmp";
+  error_code code;
+  filesystem::create_directories (filesystem::path (mPath).parent_path (),
+                                  code);
+  ofstream ofs{ temp, ios::binary | ios::trunc };
+  if (!ofs.is_open ())
+    return false;
+
+  if (!mHeader.empty ())
+    ofs << mHeader << "\n";
+  write (ofs);
+  ofs.close ();
+  if (ofs.fail ())
+    return false;
+  if (sync)
+    syncFile (temp);
+
+  filesystem::rename (temp, mPath, code);
+  if (code)
+    {
+      qWarning () << "can't write " << QString::fromLocal8Bit (mPath);
+      return false;
+    }
+
+  qDebug () << QString::fromLocal8Bit (mPath) << " compacted, " << mRecords
+            << " records to " << live;
+  mRecords = live;
+  mValid = true;
+  return true;
+}
+
+bool
+AppendLog::readField (istream &is, size_t length, string &field)
+{
+  if (length > FIELD_MAX)
+    return false;
+
+  field.resize (length);
+  is.read (field.data (), static_cast<streamsize> (length));
+  return !is.fail ();
+}
+
+}
+
+// Local Variables:
+// mode: c++
+// End:
@@ -0,0 +1,103 @@
+/*
+ * This file is part of the apvlv package
+ * Copyright (C) <2024> Alf
+ *
+ * Contact: Alf <naihe2010@126.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+/* @CPPFILE ApvlvAppendLog.h
+ *
+ *  Author: Alf <naihe2010@126.com>
+ */
+
+#ifndef _APVLV_APPEND_LOG_H_
+#define _APVLV_APPEND_LOG_H_
+
+#include <cstddef>
+#include <functional>
+#include <iosfwd>
+#include <string>
+
+namespace apvlv
+{
+
+//
+// a file of records appended as they change, the last record of a key
+// replaces the others when it is read
+//
+// The file begins with a header line, a file of another header is
+// written again by the next append. The file is compacted to the live
+// records when the replaced ones are the most of it.
+//
+class AppendLog final
+{
+public:
+  // an empty header is a file of records only
+  explicit AppendLog (std::string path = "", std::string header = "");
+
+  // reads a record, false at the end or at a broken record
+  using Reader = std::function<bool (std::istream &)>;
+  using Writer = std::function<void (std::ostream &)>;
+
+  // a broken tail is cut off, the records appended later would follow it
+  void load (const Reader &read);
+
+  // the stream of write is at the end of the file
+  bool append (const Writer &write, bool sync = false);
+
+  [[nodiscard]] bool
+  needsCompaction (size_t live) const
+  {
+    return mRecords >= 2 * live + 100;
+  }
+
+  // writes the live records to a temporary file and renames it
+  bool rewrite (size_t live, const Writer &write, bool sync = false);
+
+  [[nodiscard]] size_t
+  records () const
+  {
+    return mRecords;
+  }
+
+  [[nodiscard]] const std::string &
+  path () const
+  {
+    return mPath;
+  }
+
+  // reads a field of a record, a longer field is a broken record
+  static bool readField (std::istream &is, size_t length, std::string &field);
+
+  static const size_t FIELD_MAX = 16 * 1024 * 1024;
+
+private:
+  std::string mPath;
+  std::string mHeader;
+  // the records in the file, the replaced ones too
+  size_t mRecords{ 0 };
+  // the file exists with the header
+  bool mValid{ false };
+};
+
+}
+
+#endif
+
+/* Local Variables: */
+/* mode: c++ */
+/* End: */
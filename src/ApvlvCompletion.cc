@@ -29,6 +29,7 @@
 #include <string>
 
 #include "ApvlvCompletion.h"
+#include "ApvlvLog.h"
 #include "ApvlvUtil.h"
 
 namespace apvlv
@@ -68,7 +69,7 @@ ApvlvCompletion::addPath (const string &path)
         {
           auto item = entry.path ().string ()
                       + (entry.is_directory () ? PATH_SEP_S : "");
-          qDebug () << "add a item: " << item;
+          qCDebug (lcCompletion) << "add a item: " << item;
           items.emplace_back (item);
         }
     }
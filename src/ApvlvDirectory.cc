@@ -31,7 +31,11 @@
 #include <QInputDialog>
 #include <QLocale>
 #include <QMessageBox>
+#include <QScrollBar>
 #include <QTimeZone>
+#include <algorithm>
+#include <filesystem>
+#include <limits>
 #include <stack>
 
 #include "ApvlvDirectory.h"
@@ -47,11 +51,17 @@ std::vector<const char *> Directory::ColumnString = {
   QT_TR_NOOP ("Title"),
   QT_TR_NOOP ("Modified Time"),
   QT_TR_NOOP ("File Size"),
+  QT_TR_NOOP ("Pages"),
+  QT_TR_NOOP ("Author"),
+  QT_TR_NOOP ("Document Title"),
 };
 std::vector<const char *> Directory::SortByColumnString = {
   QT_TR_NOOP ("Sort By Title"),
   QT_TR_NOOP ("Sort By Modified Time"),
   QT_TR_NOOP ("Sort By File Size"),
+  QT_TR_NOOP ("Sort By Pages"),
+  QT_TR_NOOP ("Sort By Author"),
+  QT_TR_NOOP ("Sort By Document Title"),
 };
 std::vector<const char *> Directory::FilterTypeString = {
   QT_TR_NOOP ("Filter Title"),
@@ -62,26 +72,729 @@ std::vector<const char *> Directory::FilterTypeString = {
   QT_TR_NOOP ("Filter FileSize <="),
 };
 
+// the rows given to the view at once
+const int FETCH_BATCH = 1000;
+
+// the most directories expanded to show the filtered items
+const int FILTER_EXPAND_LIMIT = 1000;
+
+// the filter is applied when the typing pauses this long
+const int FILTER_DELAY = 100;
+
+// the visible rows are checked for missing metadata once a scroll or a
+// change of the rows pauses this long
+const int METADATA_DELAY = 50;
+
+// a sort by metadata is redone once a batch of files is extracted
+const int RESORT_DELAY = 1000;
+
+// bits of DirectoryModel::mVisible
+const uint8_t NODE_VISIBLE = 1;
+const uint8_t NODE_MATCHED = 2;
+
 void
 ContentTree::keyPressEvent (QKeyEvent *event)
 {
   event->ignore ();
 }
 
+DirectoryModel::DirectoryModel (QObject *parent) : QAbstractItemModel (parent)
+{
+}
+
+void
+DirectoryModel::reset (const FileIndex &index)
+{
+  beginResetModel ();
+  mTree.assign (index);
+  mRows.clear ();
+  mRowOf.assign (mTree.capacity (), 0);
+  mVisible.clear ();
+  mFilter = nullptr;
+  mMetadata.clear ();
+  mCovers.clear ();
+  endResetModel ();
+}
+
+DirectoryModel::Id
+DirectoryModel::append (Id parent, const FileIndex &index)
+{
+  auto first = mTree.capacity ();
+  auto parent_visible = isVisible (parent);
+  auto id = mTree.append (parent, index);
+  mRowOf.resize (mTree.capacity (), 0);
+
+  if (mFilter)
+    {
+      mVisible.resize (mTree.capacity (), 0);
+      for (auto i = static_cast<Id> (first); i < mTree.capacity (); ++i)
+        {
+          auto const &node = mTree.node (i);
+          auto matched = mFollowFile && node.type == FileIndexType::PAGE
+                             ? (mVisible[node.parent] & NODE_MATCHED) != 0
+                             : mFilter (i);
+          mVisible[i] = matched ? NODE_VISIBLE | NODE_MATCHED : 0;
+        }
+      for (auto i = mTree.capacity (); i-- > first;)
+        {
+          if (mVisible[i] & NODE_VISIBLE)
+            mVisible[mTree.node (static_cast<Id> (i)).parent] |= NODE_VISIBLE;
+        }
+
+      if (!isVisible (id))
+        return id;
+
+      if (!parent_visible)
+        {
+          // the ancestors are shown now, filter again
+          setFilter (mFilter, mFollowFile);
+          return id;
+        }
+    }
+
+  auto itr = mRows.find (parent);
+  if (itr == mRows.end ())
+    return id;
+
+  auto &rows = itr->second;
+  auto key = sortKey (id);
+  auto pos = static_cast<int> (
+      std::upper_bound (rows.ids.begin (), rows.ids.end (), key,
+                        [this] (const SortKey &a, Id b) {
+                          return sortBefore (a, sortKey (b));
+                        })
+      - rows.ids.begin ());
+
+  if (pos < rows.fetched
+      || rows.fetched == static_cast<int> (rows.ids.size ()))
+    {
+      beginInsertRows (modelIndex (parent, 0), pos, pos);
+      rows.ids.insert (rows.ids.begin () + pos, id);
+      rows.fetched++;
+      setRow (rows, pos);
+      endInsertRows ();
+    }
+  else
+    {
+      rows.ids.insert (rows.ids.begin () + pos, id);
+      setRow (rows, pos);
+    }
+
+  return id;
+}
+
+void
+DirectoryModel::remove (Id id)
+{
+  auto parent = mTree.node (id).parent;
+  if (parent == FileIndexTree::INVALID_ID)
+    return;
+
+  auto itr = mRows.find (parent);
+  auto row = static_cast<int> (mRowOf[id]);
+  if (itr == mRows.end () || !isVisible (id)
+      || row >= static_cast<int> (itr->second.ids.size ())
+      || itr->second.ids[row] != id)
+    {
+      mTree.remove (id);
+      return;
+    }
+
+  auto &rows = itr->second;
+  auto shown = row < rows.fetched;
+  if (shown)
+    beginRemoveRows (modelIndex (parent, 0), row, row);
+  rows.ids.erase (rows.ids.begin () + row);
+  setRow (rows, row);
+  mTree.remove (id);
+  if (shown)
+    {
+      rows.fetched--;
+      endRemoveRows ();
+    }
+}
+
+void
+DirectoryModel::update (Id id, const FileIndex &index)
+{
+  if (mTree.title (id) != index.title)
+    mTree.setPath (id, index.path);
+  mTree.setFile (id, index.size, index.mtime);
+  mMetadata.erase (id);
+  mCovers.erase (id);
+  rowChanged (id);
+}
+
+void
+DirectoryModel::rename (Id id, const string &path)
+{
+  mTree.setPath (id, path);
+  rowChanged (id);
+}
+
+void
+DirectoryModel::setFilter (const Filter &filter, bool follow_file)
+{
+  beginResetModel ();
+  mFilter = filter;
+  mFollowFile = follow_file;
+  mRows.clear ();
+  mVisible.clear ();
+
+  if (mFilter && !mTree.empty ())
+    {
+      // the parents are before their children in the tree
+      mVisible.assign (mTree.capacity (), 0);
+      for (Id id = 1; id < mTree.capacity (); ++id)
+        {
+          auto const &node = mTree.node (id);
+          if (node.parent == FileIndexTree::INVALID_ID)
+            continue;
+
+          auto matched = mFollowFile && node.type == FileIndexType::PAGE
+                             ? (mVisible[node.parent] & NODE_MATCHED) != 0
+                             : mFilter (id);
+          if (matched)
+            mVisible[id] = NODE_VISIBLE | NODE_MATCHED;
+        }
+      for (auto id = static_cast<Id> (mTree.capacity () - 1); id > 0; --id)
+        {
+          auto parent = mTree.node (id).parent;
+          if ((mVisible[id] & NODE_VISIBLE)
+              && parent != FileIndexTree::INVALID_ID)
+            mVisible[parent] |= NODE_VISIBLE;
+        }
+      mVisible[mTree.root ()] |= NODE_VISIBLE;
+    }
+
+  endResetModel ();
+}
+
+void
+DirectoryModel::setHeaderLabels (const QStringList &labels)
+{
+  mHeaderLabels = labels;
+  emit headerDataChanged (Qt::Horizontal, 0,
+                          static_cast<int> (labels.size ()) - 1);
+}
+
+void
+DirectoryModel::setTypeIcons (const map<FileIndexType, QIcon> &icons)
+{
+  mTypeIcons = icons;
+}
+
+const FileMetadata *
+DirectoryModel::metadata (Id id) const
+{
+  auto const &node = mTree.node (id);
+  if (node.type != FileIndexType::FILE)
+    return nullptr;
+
+  auto itr = mMetadata.find (id);
+  if (itr == mMetadata.end ())
+    {
+      auto meta = MetadataCache::instance ()->find (mTree.path (id),
+                                                    node.mtime, node.size);
+      itr = mMetadata.emplace (id, std::move (meta)).first;
+    }
+  return itr->second.get ();
+}
+
+void
+DirectoryModel::updateMetadata (Id id)
+{
+  mMetadata.erase (id);
+  mCovers.erase (id);
+  rowChanged (id);
+}
+
+void
+DirectoryModel::rowChanged (Id id)
+{
+  auto parent = mTree.node (id).parent;
+  if (parent == FileIndexTree::INVALID_ID || !isVisible (id))
+    return;
+
+  // mRowOf is stale for the rows not given to the view
+  auto r = builtRows (parent);
+  auto row = static_cast<int> (mRowOf[id]);
+  if (r != nullptr && row < r->fetched && r->ids[row] == id)
+    emit dataChanged (modelIndex (id, 0),
+                      modelIndex (id, columnCount ({}) - 1));
+}
+
+DirectoryModel::Id
+DirectoryModel::child (Id parent, string_view title) const
+{
+  for (auto id : mTree.children (parent))
+    {
+      if (mTree.node (id).type != FileIndexType::PAGE
+          && mTree.title (id) == title)
+        return id;
+    }
+  return FileIndexTree::INVALID_ID;
+}
+
+DirectoryModel::Id
+DirectoryModel::findPath (const string &path) const
+{
+  if (mTree.empty ())
+    return FileIndexTree::INVALID_ID;
+
+  auto root = mTree.path (mTree.root ());
+  if (path == root)
+    return mTree.root ();
+
+  auto relative = filesystem::path (path).lexically_relative (root);
+  if (relative.empty () || *relative.begin () == "..")
+    return FileIndexTree::INVALID_ID;
+
+  auto id = mTree.root ();
+  for (auto const &name : relative)
+    {
+      if (name == ".")
+        continue;
+
+      id = child (id, name.string ());
+      if (id == FileIndexTree::INVALID_ID)
+        break;
+    }
+  return id;
+}
+
+DirectoryModel::Id
+DirectoryModel::fileOf (Id id) const
+{
+  while (id != FileIndexTree::INVALID_ID && id != mTree.root ())
+    {
+      if (mTree.node (id).type == FileIndexType::FILE)
+        return id;
+      id = mTree.node (id).parent;
+    }
+  return FileIndexTree::INVALID_ID;
+}
+
+DirectoryModel::Id
+DirectoryModel::idOf (const QModelIndex &index) const
+{
+  if (!index.isValid ())
+    return mTree.root ();
+  return static_cast<Id> (index.internalId ());
+}
+
+QModelIndex
+DirectoryModel::indexOf (Id id)
+{
+  if (mTree.empty () || id == mTree.root () || id >= mTree.capacity ()
+      || mTree.isRemoved (id) || !isVisible (id))
+    return {};
+
+  vector<Id> chain;
+  for (auto i = id; i != mTree.root (); i = mTree.node (i).parent)
+    chain.push_back (i);
+
+  // fetch the rows of the ancestors until the node is given to the view
+  for (auto itr = chain.rbegin (); itr != chain.rend (); ++itr)
+    {
+      auto parent = mTree.node (*itr).parent;
+      auto &r = rows (parent);
+      while (static_cast<int> (mRowOf[*itr]) >= r.fetched)
+        fetchMore (modelIndex (parent, 0));
+    }
+
+  return modelIndex (id, 0);
+}
+
+QModelIndex
+DirectoryModel::index (int row, int column, const QModelIndex &parent) const
+{
+  if (mTree.empty () || row < 0 || column < 0
+      || column >= columnCount (parent))
+    return {};
+
+  auto r = builtRows (idOf (parent));
+  if (r == nullptr || row >= r->fetched)
+    return {};
+  return createIndex (row, column, r->ids[row]);
+}
+
+QModelIndex
+DirectoryModel::parent (const QModelIndex &child) const
+{
+  if (!child.isValid ())
+    return {};
+
+  auto parent = mTree.node (idOf (child)).parent;
+  if (parent == FileIndexTree::INVALID_ID || parent == mTree.root ())
+    return {};
+  return modelIndex (parent, 0);
+}
+
+int
+DirectoryModel::rowCount (const QModelIndex &parent) const
+{
+  if (mTree.empty () || parent.column () > 0)
+    return 0;
+
+  auto r = builtRows (idOf (parent));
+  return r == nullptr ? 0 : r->fetched;
+}
+
+int
+DirectoryModel::columnCount ([[maybe_unused]] const QModelIndex &parent) const
+{
+  return static_cast<int> (Directory::ColumnString.size ());
+}
+
+bool
+DirectoryModel::hasChildren (const QModelIndex &parent) const
+{
+  if (mTree.empty () || parent.column () > 0)
+    return false;
+
+  auto id = idOf (parent);
+  if (auto r = builtRows (id); r != nullptr)
+    return !r->ids.empty ();
+
+  return std::ranges::any_of (mTree.children (id),
+                              [this] (Id child) { return isVisible (child); });
+}
+
+QVariant
+DirectoryModel::data (const QModelIndex &index, int role) const
+{
+  if (!index.isValid ())
+    return {};
+
+  auto id = idOf (index);
+  auto const &node = mTree.node (id);
+  auto column = static_cast<Directory::Column> (index.column ());
+  using enum Directory::Column;
+  switch (role)
+    {
+    case Qt::DisplayRole:
+      if (column == Title)
+        return QString::fromLocal8Bit (mTree.title (id));
+      if (node.type != FileIndexType::FILE)
+        return {};
+      if (column == MTime)
+        {
+          auto date = QDateTime::fromSecsSinceEpoch (
+              node.mtime, QTimeZone::systemTimeZone ());
+          return date.toString ("yyyy-MM-dd HH:mm:ss");
+        }
+      if (column == FileSize)
+        return QLocale ().formattedDataSize (static_cast<qint64> (node.size));
+      if (auto meta = metadata (id); meta != nullptr)
+        {
+          if (column == Pages)
+            return meta->pages > 0 ? QVariant (meta->pages) : QVariant ();
+          if (column == Author)
+            return QString::fromUtf8 (meta->author);
+          return QString::fromUtf8 (meta->title);
+        }
+      return {};
+
+    case Qt::DecorationRole:
+      if (column == Title)
+        {
+          if (auto cover = mCovers.find (id); cover != mCovers.end ())
+            return cover->second;
+
+          auto meta = metadata (id);
+          if (meta != nullptr && meta->coverSize > 0)
+            {
+              auto jpeg = MetadataCache::instance ()->cover (*meta);
+              QPixmap pixmap;
+              pixmap.loadFromData (QByteArray::fromStdString (jpeg));
+              if (!pixmap.isNull ())
+                return mCovers[id] = QIcon (pixmap);
+            }
+
+          auto icon = mTypeIcons.find (node.type);
+          if (icon != mTypeIcons.end ())
+            return icon->second;
+        }
+      return {};
+
+    case Qt::ToolTipRole:
+      if (column == Title)
+        {
+          auto tip = QString::fromLocal8Bit (mTree.path (id));
+          auto meta = metadata (id);
+          if (meta != nullptr && !meta->title.empty ())
+            tip += "\n" + QString::fromUtf8 (meta->title);
+          if (meta != nullptr && !meta->author.empty ())
+            tip += "\n" + QString::fromUtf8 (meta->author);
+          return tip;
+        }
+      return {};
+
+    default:
+      return {};
+    }
+}
+
+QVariant
+DirectoryModel::headerData (int section, Qt::Orientation orientation,
+                            int role) const
+{
+  if (orientation != Qt::Horizontal || role != Qt::DisplayRole || section < 0
+      || section >= mHeaderLabels.size ())
+    return {};
+  return mHeaderLabels[section];
+}
+
+bool
+DirectoryModel::canFetchMore (const QModelIndex &parent) const
+{
+  if (mTree.empty () || parent.column () > 0)
+    return false;
+
+  // the rows not built yet are built by fetchMore
+  auto r = builtRows (idOf (parent));
+  if (r == nullptr)
+    return hasChildren (parent);
+  return r->fetched < static_cast<int> (r->ids.size ());
+}
+
+void
+DirectoryModel::fetchMore (const QModelIndex &parent)
+{
+  if (mTree.empty ())
+    return;
+
+  auto &r = rows (idOf (parent));
+  auto count = std::min (FETCH_BATCH,
+                         static_cast<int> (r.ids.size ()) - r.fetched);
+  if (count <= 0)
+    return;
+
+  beginInsertRows (parent, r.fetched, r.fetched + count - 1);
+  r.fetched += count;
+  endInsertRows ();
+}
+
+void
+DirectoryModel::sort (int column, Qt::SortOrder order)
+{
+  if (column == mSortColumn && order == mSortOrder)
+    return;
+
+  mSortColumn = column;
+  mSortOrder = order;
+  resort ();
+}
+
+void
+DirectoryModel::resort ()
+{
+  // sort the built rows in place, the rows given to the view stay the
+  // same count, and the persistent indexes follow their nodes
+  emit layoutAboutToBeChanged ({}, QAbstractItemModel::VerticalSortHint);
+  for (auto &[parent, r] : mRows)
+    {
+      sortRows (r.ids);
+      setRow (r, 0);
+    }
+
+  auto from = persistentIndexList ();
+  QModelIndexList to;
+  to.reserve (from.size ());
+  for (auto const &index : from)
+    {
+      auto id = idOf (index);
+      auto parent = mTree.node (id).parent;
+      auto itr = mRows.find (parent);
+      if (itr != mRows.end ()
+          && static_cast<int> (mRowOf[id]) < itr->second.fetched)
+        to.append (modelIndex (id, index.column ()));
+      else
+        to.append (QModelIndex ());
+    }
+  changePersistentIndexList (from, to);
+  emit layoutChanged ({}, QAbstractItemModel::VerticalSortHint);
+}
+
+const DirectoryModel::Rows *
+DirectoryModel::builtRows (Id parent) const
+{
+  auto itr = mRows.find (parent);
+  return itr != mRows.end () ? &itr->second : nullptr;
+}
+
+DirectoryModel::Rows &
+DirectoryModel::rows (Id parent)
+{
+  auto itr = mRows.find (parent);
+  if (itr != mRows.end ())
+    return itr->second;
+
+  Rows r;
+  for (auto child : mTree.children (parent))
+    {
+      if (isVisible (child))
+        r.ids.push_back (child);
+    }
+
+  sortRows (r.ids);
+
+  auto &inserted = mRows[parent] = std::move (r);
+  setRow (inserted, 0);
+  return inserted;
+}
+
+void
+DirectoryModel::setRow (const Rows &rows, size_t first)
+{
+  for (auto row = first; row < rows.ids.size (); ++row)
+    mRowOf[rows.ids[row]] = static_cast<uint32_t> (row);
+}
+
+bool
+DirectoryModel::isVisible (Id id) const
+{
+  return mVisible.empty () || (mVisible[id] & NODE_VISIBLE);
+}
+
+void
+DirectoryModel::sortRows (vector<Id> &ids) const
+{
+  // the keys are taken once, not in every comparison
+  vector<pair<SortKey, Id>> keys;
+  keys.reserve (ids.size ());
+  for (auto id : ids)
+    {
+      keys.emplace_back (sortKey (id), id);
+    }
+
+  std::ranges::stable_sort (keys, [this] (auto const &a, auto const &b) {
+    return sortBefore (a.first, b.first);
+  });
+
+  for (size_t i = 0; i < keys.size (); ++i)
+    {
+      ids[i] = keys[i].second;
+    }
+}
+
+DirectoryModel::SortKey
+DirectoryModel::sortKey (Id id) const
+{
+  auto const &node = mTree.node (id);
+  SortKey key{ 0, 0, {}, {} };
+  switch (node.type)
+    {
+      using enum FileIndexType;
+    case DIR:
+      key.group = 0;
+      break;
+    case FILE:
+      key.group = 1;
+      break;
+    case PAGE:
+      // the outline pages keep their order
+      key.group = 2;
+      return key;
+    }
+
+  switch (static_cast<Directory::Column> (mSortColumn))
+    {
+      using enum Directory::Column;
+    case Title:
+      break;
+    case MTime:
+      key.value = node.mtime;
+      break;
+    case FileSize:
+      key.value = node.size;
+      break;
+    case Pages:
+      if (auto meta = metadata (id); meta != nullptr)
+        key.value = meta->pages;
+      break;
+    case Author:
+      if (auto meta = metadata (id); meta != nullptr)
+        key.text = meta->author;
+      break;
+    case DocTitle:
+      if (auto meta = metadata (id); meta != nullptr)
+        key.text = meta->title;
+      break;
+    }
+  key.title = mTree.title (id);
+  return key;
+}
+
+bool
+DirectoryModel::sortBefore (const SortKey &a, const SortKey &b) const
+{
+  // directories first, then the sort column, then the title
+  if (a.group != b.group)
+    return a.group < b.group;
+  if (a.value != b.value)
+    return mSortOrder == Qt::AscendingOrder ? a.value < b.value
+                                            : a.value > b.value;
+  if (a.text != b.text)
+    return mSortOrder == Qt::AscendingOrder ? a.text < b.text
+                                            : a.text > b.text;
+  return mSortOrder == Qt::AscendingOrder ? a.title < b.title
+                                          : a.title > b.title;
+}
+
+QModelIndex
+DirectoryModel::modelIndex (Id id, int column) const
+{
+  if (id == mTree.root ())
+    return {};
+  return createIndex (static_cast<int> (mRowOf[id]), column, id);
+}
+
 Directory::Directory ()
 {
   setLayout (&mLayout);
   mLayout.addWidget (&mToolBar, 0);
-  mLayout.addWidget (&mTreeWidget);
+  mLayout.addWidget (&mTreeView);
   setupToolBar ();
   setupTree ();
-  auto guioptions
-      = ApvlvParams::instance ()->getStringOrDefault ("guioptions");
+  auto guioptions = ApvlvParams::instance ()->get (StringParam::GUIOPTIONS);
   if (guioptions.find ('S') == string::npos)
     {
       mToolBar.hide ();
     }
   QTimer::singleShot (50, this, SLOT (selectFirstItem ()));
+
+  QObject::connect (&mDirIndexTimer, SIGNAL (timeout ()), this,
+                    SLOT (applyUpdates ()));
+
+  mMetadataTimer.setSingleShot (true);
+  mMetadataTimer.setInterval (METADATA_DELAY);
+  QObject::connect (&mMetadataTimer, SIGNAL (timeout ()), this,
+                    SLOT (requestVisibleMetadata ()));
+  QObject::connect (mTreeView.verticalScrollBar (),
+                    SIGNAL (valueChanged (int)), &mMetadataTimer,
+                    SLOT (start ()));
+  QObject::connect (&mTreeView, SIGNAL (expanded (const QModelIndex &)),
+                    &mMetadataTimer, SLOT (start ()));
+  QObject::connect (&mTreeView, SIGNAL (collapsed (const QModelIndex &)),
+                    &mMetadataTimer, SLOT (start ()));
+  QObject::connect (&mModel, SIGNAL (modelReset ()), &mMetadataTimer,
+                    SLOT (start ()));
+  QObject::connect (&mModel, SIGNAL (layoutChanged ()), &mMetadataTimer,
+                    SLOT (start ()));
+  QObject::connect (&mModel,
+                    SIGNAL (rowsInserted (const QModelIndex &, int, int)),
+                    &mMetadataTimer, SLOT (start ()));
+  QObject::connect (&mModel,
+                    SIGNAL (rowsRemoved (const QModelIndex &, int, int)),
+                    &mMetadataTimer, SLOT (start ()));
+  mResortTimer.setSingleShot (true);
+  QObject::connect (&mResortTimer, SIGNAL (timeout ()), &mModel,
+                    SLOT (resort ()));
+  QObject::connect (MetadataCache::instance (),
+                    SIGNAL (extracted (const QString &)), this,
+                    SLOT (onMetadataExtracted (const QString &)));
 }
 
 void
@@ -89,6 +802,9 @@ Directory::setupToolBar ()
 {
   mToolBar.addWidget (&mFilterText);
   QObject::connect (&mFilterText, SIGNAL (textEdited (const QString &)), this,
+                    SLOT (onFilterEdited ()));
+  mFilterTimer.setSingleShot (true);
+  QObject::connect (&mFilterTimer, SIGNAL (timeout ()), this,
                     SLOT (onFilter ()));
   mToolBar.addSeparator ();
   mToolBar.addWidget (&mFilterType);
@@ -108,11 +824,11 @@ Directory::setupToolBar ()
 
   auto expand_all = mToolBar.addAction (tr ("Expand All"));
   expand_all->setIcon (QIcon::fromTheme (QIcon::ThemeIcon::ListAdd));
-  QObject::connect (expand_all, SIGNAL (triggered (bool)), &mTreeWidget,
+  QObject::connect (expand_all, SIGNAL (triggered (bool)), &mTreeView,
                     SLOT (expandAll ()));
   auto collapse_all = mToolBar.addAction (tr ("Collapse All"));
   collapse_all->setIcon (QIcon::fromTheme (QIcon::ThemeIcon::ListRemove));
-  QObject::connect (collapse_all, SIGNAL (triggered (bool)), &mTreeWidget,
+  QObject::connect (collapse_all, SIGNAL (triggered (bool)), &mTreeView,
                     SLOT (collapseAll ()));
   mToolBar.addSeparator ();
 
@@ -128,298 +844,280 @@ Directory::setupToolBar ()
 void
 Directory::setupTree ()
 {
-  mTreeWidget.setColumnCount (3);
-  mTreeWidget.setColumnWidth (static_cast<int> (Column::Title), 400);
-  mTreeWidget.setColumnWidth (static_cast<int> (Column::MTime), 150);
-  mTreeWidget.setColumnWidth (static_cast<int> (Column::FileSize), 150);
-  mTreeWidget.setSortingEnabled (false);
-  mTreeWidget.setHeaderHidden (false);
   QStringList labels;
   for (auto const &str : ColumnString)
     {
       labels.append (tr (str));
     }
-  mTreeWidget.setHeaderLabels (labels);
-
-  auto headerview = mTreeWidget.header ();
+  mModel.setHeaderLabels (labels);
+
+  map<FileIndexType, QIcon> icons;
+  icons[FileIndexType::DIR] = QIcon (IconDir.c_str ());
+  icons[FileIndexType::FILE] = QIcon (IconFile.c_str ());
+  icons[FileIndexType::PAGE] = QIcon (IconPage.c_str ());
+  mModel.setTypeIcons (icons);
+
+  mTreeView.setModel (&mModel);
+  mTreeView.setUniformRowHeights (true);
+  mTreeView.setColumnWidth (static_cast<int> (Column::Title), 400);
+  mTreeView.setColumnWidth (static_cast<int> (Column::MTime), 150);
+  mTreeView.setColumnWidth (static_cast<int> (Column::FileSize), 150);
+  mTreeView.setColumnWidth (static_cast<int> (Column::Pages), 60);
+  mTreeView.setColumnWidth (static_cast<int> (Column::Author), 150);
+  mTreeView.setColumnWidth (static_cast<int> (Column::DocTitle), 250);
+  mTreeView.setSortingEnabled (false);
+  mTreeView.setHeaderHidden (false);
+
+  auto headerview = mTreeView.header ();
   headerview->setSectionsClickable (true);
   QObject::connect (headerview, SIGNAL (sectionClicked (int)), this,
                     SLOT (sortBy (int)));
 
-  mTreeWidget.setVerticalScrollMode (
+  mTreeView.setVerticalScrollMode (
       QAbstractItemView::ScrollMode::ScrollPerItem);
-  mTreeWidget.setSelectionBehavior (
+  mTreeView.setSelectionBehavior (
       QAbstractItemView::SelectionBehavior::SelectRows);
-  mTreeWidget.setSelectionMode (
+  mTreeView.setSelectionMode (
       QAbstractItemView::SelectionMode::ExtendedSelection);
 
-  mTypeIcons[FileIndexType::DIR] = QIcon (IconDir.c_str ());
-  mTypeIcons[FileIndexType::FILE] = QIcon (IconFile.c_str ());
-  mTypeIcons[FileIndexType::PAGE] = QIcon (IconPage.c_str ());
-
-  QObject::connect (&mTreeWidget,
-                    SIGNAL (itemActivated (QTreeWidgetItem *, int)), this,
-                    SLOT (onRowActivated (QTreeWidgetItem *, int)));
-  QObject::connect (&mTreeWidget,
-                    SIGNAL (itemDoubleClicked (QTreeWidgetItem *, int)), this,
-                    SLOT (onRowDoubleClicked ()));
-  mTreeWidget.setContextMenuPolicy (Qt::ContextMenuPolicy::CustomContextMenu);
-  QObject::connect (&mTreeWidget,
+  QObject::connect (&mTreeView, SIGNAL (activated (const QModelIndex &)),
+                    this, SLOT (onRowActivated (const QModelIndex &)));
+  QObject::connect (&mTreeView, SIGNAL (doubleClicked (const QModelIndex &)),
+                    this, SLOT (onRowDoubleClicked ()));
+  mTreeView.setContextMenuPolicy (Qt::ContextMenuPolicy::CustomContextMenu);
+  QObject::connect (&mTreeView,
                     SIGNAL (customContextMenuRequested (const QPoint &)), this,
                     SLOT (onContextMenuRequest (const QPoint &)));
 }
 
+void
+Directory::showEvent (QShowEvent *event)
+{
+  QFrame::showEvent (event);
+  mMetadataTimer.start ();
+}
+
+void
+Directory::resizeEvent (QResizeEvent *event)
+{
+  QFrame::resizeEvent (event);
+  mMetadataTimer.start ();
+}
+
 bool
 Directory::isReady ()
 {
-  return (mTreeWidget.topLevelItemCount () > 0);
+  return (mModel.hasChildren ({}) || mDirIndex.isActive ());
+}
+
+void
+Directory::loadDirectory (const string &path)
+{
+  mIndex = { "", 0, path, FileIndexType::DIR };
+  resetModel ();
+  mDirIndex.load (path);
+  mDirIndexTimer.start (100);
 }
 
 void
 Directory::setIndex (const FileIndex &index)
 {
   using enum FileIndexType;
-  if (mTreeWidget.topLevelItemCount () == 0 || index.type == DIR)
+  if (index.type == DIR
+      || (!mModel.hasChildren ({}) && !mDirIndex.isActive ()))
     {
+      mDirIndex.clear ();
+      mDirIndexTimer.stop ();
       refreshIndex (index);
       return;
     }
 
-  auto cur_index = currentItemFileIndex ();
-  if (mIndex.type == DIR && cur_index->type == FILE && index.type == FILE)
+  auto id = selectedId ();
+  if (id == FileIndexTree::INVALID_ID)
+    return;
+
+  auto const &node = mModel.tree ().node (id);
+  if (mIndex.type == DIR && node.type == FILE && index.type == FILE
+      && node.count == 0)
     {
-      if (cur_index->mChildrenIndex.empty ())
+      for (auto const &child : index.mChildrenIndex)
         {
-          auto cur_item = selectedTreeItem ();
-          cur_index->moveChildChildren (index);
-          for (auto &child : cur_index->mChildrenIndex)
-            {
-              setIndex (child, cur_item);
-            }
+          mModel.append (id, child);
         }
     }
 }
 
-void
-Directory::setItemSelected (QTreeWidgetItem *item)
+Directory::Id
+Directory::selectedId () const
 {
-  auto selitems = mTreeWidget.selectedItems ();
-  for (auto selitem : selitems)
-    {
-      selitem->setSelected (false);
-    }
+  auto rows = mTreeView.selectionModel ()->selectedRows ();
+  if (rows.isEmpty ())
+    return FileIndexTree::INVALID_ID;
+  return mModel.idOf (rows[0]);
+}
 
-  auto parent = item->parent ();
-  while (parent)
+vector<Directory::Id>
+Directory::selectedIds () const
+{
+  vector<Id> ids;
+  for (auto const &row : mTreeView.selectionModel ()->selectedRows ())
     {
-      mTreeWidget.expandItem (parent);
-      parent = parent->parent ();
+      ids.push_back (mModel.idOf (row));
     }
-
-  item->setSelected (true);
-  if (item->isExpanded ())
-    mTreeWidget.collapseItem (item);
-  mTreeWidget.scrollToItem (item);
+  return ids;
 }
 
 void
-Directory::setIndex (FileIndex &index, QTreeWidgetItem *root_itr)
+Directory::setItemSelected (Id id)
 {
-  auto itr = new QTreeWidgetItem ();
-  setFileIndexToTreeItem (itr, &index);
-
-  root_itr->addChild (itr);
+  auto index = mModel.indexOf (id);
+  if (!index.isValid ())
+    return;
 
-  for (auto &child : index.mChildrenIndex)
+  for (auto parent = index.parent (); parent.isValid ();
+       parent = parent.parent ())
     {
-      setIndex (child, itr);
+      mTreeView.expand (parent);
     }
+
+  auto selection = mTreeView.selectionModel ();
+  selection->select (index, QItemSelectionModel::ClearAndSelect
+                                | QItemSelectionModel::Rows);
+  selection->setCurrentIndex (index, QItemSelectionModel::NoUpdate);
+  if (mTreeView.isExpanded (index))
+    mTreeView.collapse (index);
+  mTreeView.scrollTo (index);
 }
 
 void
 Directory::refreshIndex (const FileIndex &index)
 {
-  mTreeWidget.clear ();
-
   mIndex = index;
-
-  for (auto &child : mIndex.mChildrenIndex)
-    {
-      setIndex (child, mTreeWidget.invisibleRootItem ());
-    }
-
-  sortItems (mTreeWidget.invisibleRootItem ());
+  sortItems ();
+  resetModel ();
 
   QTimer::singleShot (50, this, SLOT (selectFirstItem ()));
 }
 
 void
-Directory::setFileIndexToTreeItem (QTreeWidgetItem *item, FileIndex *index)
+Directory::resetModel ()
 {
-  using enum Column;
-  auto variant = QVariant::fromValue<FileIndex *> (index);
-  item->setData (static_cast<int> (Title), Qt::UserRole, variant);
-  item->setText (static_cast<int> (Title),
-                 QString::fromLocal8Bit (index->title.c_str ()));
-  item->setIcon (static_cast<int> (Title), mTypeIcons[index->type]);
-  item->setToolTip (static_cast<int> (Title),
-                    QString::fromLocal8Bit (index->path));
-
-  using enum FileIndexType;
-  if (index->type == FILE)
-    {
-      auto date = QDateTime::fromSecsSinceEpoch (index->mtime,
-                                                 QTimeZone::systemTimeZone ());
-      item->setText (static_cast<int> (Column::MTime),
-                     date.toString ("yyyy-MM-dd HH:mm:ss"));
-      auto size
-          = QLocale ().formattedDataSize (static_cast<qint64> (index->size));
-      item->setText (static_cast<int> (Column::FileSize), size);
-    }
+  mModel.reset (mIndex);
+  if (!mFilterText.text ().trimmed ().isEmpty ())
+    onFilter ();
 }
 
-FileIndex *
-Directory::getFileIndexFromTreeItem (QTreeWidgetItem *item)
+void
+Directory::applyUpdates ()
 {
-  if (item == nullptr)
-    return nullptr;
-
-  auto varaint = item->data (static_cast<int> (Column::Title), Qt::UserRole);
-  auto index = varaint.value<FileIndex *> ();
-  return index;
-}
+  auto updates = mDirIndex.takeUpdates ();
+  if (updates.empty ())
+    return;
 
-FileIndex *
-Directory::treeItemToFileIndex (QTreeWidgetItem *item)
-{
-  while (item != nullptr)
+  auto was_empty = !mModel.hasChildren ({});
+  mTreeView.setUpdatesEnabled (false);
+  for (auto &update : updates)
     {
-      auto index = getFileIndexFromTreeItem (item);
-      if (index->type == FileIndexType::FILE)
-        return index;
-      else
-        item = item->parent ();
+      applyUpdate (update);
     }
+  mTreeView.setUpdatesEnabled (true);
 
-  return nullptr;
+  if (was_empty && mModel.hasChildren ({}))
+    selectFirstItem ();
 }
 
 void
-Directory::filterItemBy (QTreeWidgetItem *root, const filterFunc &filter_func)
+Directory::applyUpdate (DirectoryUpdate &update)
 {
-  std::stack<QTreeWidgetItem *> item_stack;
-  for (auto i = 0; i < root->childCount (); ++i)
+  using enum DirectoryUpdate::Kind;
+  if (update.kind == RESET)
     {
-      auto item = root->child (i);
-      item_stack.push (item);
+      mIndex = std::move (update.index);
+      resetModel ();
+      return;
     }
 
-  while (!item_stack.empty ())
-    {
-      auto item = item_stack.top ();
-      item_stack.pop ();
-
-      auto index = getFileIndexFromTreeItem (item);
-      auto [is_filter, same_as_file] = filter_func (index);
-      if (is_filter)
-        {
-          item->setHidden (false);
+  auto const &tree = mModel.tree ();
+  auto parent = mModel.findPath (update.dir);
+  if (parent == FileIndexTree::INVALID_ID
+      || tree.node (parent).type != FileIndexType::DIR)
+    return;
 
-          auto parent = item->parent ();
-          while (parent)
-            {
-              parent->setHidden (false);
-              parent = parent->parent ();
-            }
-        }
-      else
-        {
-          item->setHidden (true);
-        }
+  auto id = mModel.child (parent, update.index.title);
+  auto is_file = id != FileIndexTree::INVALID_ID
+                 && tree.node (id).type == FileIndexType::FILE;
 
-      if (index->type == FileIndexType::FILE && same_as_file)
-        {
-          setItemChildrenFilter (item, is_filter);
-        }
-      else
-        {
-          for (int i = 0; i < item->childCount (); ++i)
-            {
-              auto child_item = item->child (i);
-              item_stack.push (child_item);
-            }
-        }
+  if (update.kind == CHANGE
+      || (update.kind == ADD && is_file
+          && update.index.type == FileIndexType::FILE))
+    {
+      // a renamed file is added again by the watcher, just update it
+      if (id != FileIndexTree::INVALID_ID)
+        mModel.update (id, update.index);
+      return;
     }
-}
 
-void
-Directory::setItemChildrenFilter (QTreeWidgetItem *root, bool is_filter)
-{
-  filterItemBy (root, [is_filter] (const FileIndex *a) -> filterFuncReturn {
-    return { is_filter, false };
-  });
+  if (id != FileIndexTree::INVALID_ID)
+    mModel.remove (id);
+
+  if (update.kind == ADD)
+    mModel.append (parent, update.index);
 }
 
-QTreeWidgetItem *
-Directory::findTreeWidgetItem (QTreeWidgetItem *itr, FileIndexType type,
-                               const string &path, int pn,
-                               const string &anchor)
+Directory::Id
+Directory::findItem (Id root, FileIndexType type, const string &path, int pn,
+                     const string &anchor) const
 {
-  if (itr == nullptr)
-    return nullptr;
+  auto const &tree = mModel.tree ();
+  if (tree.empty ())
+    return FileIndexTree::INVALID_ID;
 
-  auto index = getFileIndexFromTreeItem (itr);
-  if (index == nullptr || index->type != type)
+  stack<Id> ids;
+  ids.push (root);
+  while (!ids.empty ())
     {
-      for (auto ind = 0; ind < itr->childCount (); ++ind)
-        {
-          auto child_itr = itr->child (ind);
-          auto citr = findTreeWidgetItem (child_itr, type, path, pn, anchor);
-          if (citr)
-            return citr;
-        }
-
-      return nullptr;
-    }
+      auto id = ids.top ();
+      ids.pop ();
 
-  auto file_index = treeItemToFileIndex (itr);
-  if (file_index == nullptr)
-    {
-      if (index->page == pn && (anchor.empty () || index->anchor == anchor))
+      auto const &node = tree.node (id);
+      if (id == tree.root () || node.type != type)
         {
-          return itr;
+          auto children = tree.children (id);
+          for (auto itr = children.rbegin (); itr != children.rend (); ++itr)
+            ids.push (*itr);
+          continue;
         }
 
-      return nullptr;
-    }
+      if (node.page != pn || (!anchor.empty () && tree.anchor (id) != anchor))
+        continue;
 
-  if (file_index->path == path && index->page == pn
-      && (anchor.empty () || index->anchor == anchor))
-    {
-      return itr;
+      auto file = mModel.fileOf (id);
+      if (file == FileIndexTree::INVALID_ID || tree.path (file) == path)
+        return id;
     }
 
-  return nullptr;
+  return FileIndexTree::INVALID_ID;
 }
 
 bool
 Directory::setCurrentIndex (const string &path, int pn, const string &anchor)
 {
-  auto itr = selectedTreeItem ();
-
-  auto fitr = findTreeWidgetItem (itr, FileIndexType::PAGE, path, pn, anchor);
+  auto id = FileIndexTree::INVALID_ID;
+  auto selected = selectedId ();
+  if (selected != FileIndexTree::INVALID_ID)
+    id = findItem (selected, FileIndexType::PAGE, path, pn, anchor);
 
-  if (fitr == nullptr)
-    fitr = findTreeWidgetItem (mTreeWidget.invisibleRootItem (),
-                               FileIndexType::PAGE, path, pn, anchor);
+  if (id == FileIndexTree::INVALID_ID)
+    id = findItem (mModel.tree ().root (), FileIndexType::PAGE, path, pn,
+                   anchor);
 
-  if (fitr == nullptr)
-    fitr = findTreeWidgetItem (mTreeWidget.invisibleRootItem (),
-                               FileIndexType::FILE, path, pn, anchor);
+  if (id == FileIndexTree::INVALID_ID)
+    id = findItem (mModel.tree ().root (), FileIndexType::FILE, path, pn,
+                   anchor);
 
-  if (fitr)
+  if (id != FileIndexTree::INVALID_ID)
     {
-      setItemSelected (fitr);
+      setItemSelected (id);
       return true;
     }
 
@@ -429,97 +1127,86 @@ Directory::setCurrentIndex (const string &path, int pn, const string &anchor)
 void
 Directory::scrollUp (int times)
 {
-  auto item = selectedTreeItem ();
-  if (item == nullptr)
+  auto index = mModel.indexOf (selectedId ());
+  if (!index.isValid ())
     return;
 
-  auto parent = item->parent ();
-  if (parent == nullptr)
+  auto row = index.row ();
+  if (row > 0)
     {
-      parent = mTreeWidget.invisibleRootItem ();
-    }
-
-  auto index = parent->indexOfChild (item);
-  if (index > 0)
-    {
-      auto new_index = index > times ? index - times : 0;
-      auto itr = parent->child (new_index);
-      setItemSelected (itr);
+      auto new_row = row > times ? row - times : 0;
+      auto itr = mModel.index (new_row, 0, index.parent ());
+      setItemSelected (mModel.idOf (itr));
     }
 }
 
 void
 Directory::scrollDown (int times)
 {
-  auto item = selectedTreeItem ();
-  if (item == nullptr)
+  auto index = mModel.indexOf (selectedId ());
+  if (!index.isValid ())
     return;
 
-  auto parent = item->parent ();
-  if (parent == nullptr)
+  auto parent = index.parent ();
+  auto row = index.row ();
+  while (row + times >= mModel.rowCount (parent)
+         && mModel.canFetchMore (parent))
     {
-      parent = mTreeWidget.invisibleRootItem ();
+      mModel.fetchMore (parent);
     }
 
-  auto index = parent->indexOfChild (item);
-  auto count = parent->childCount ();
-  auto new_index = index + times < count ? index + times : count - 1;
-  auto itr = parent->child (new_index);
-  setItemSelected (itr);
+  auto count = mModel.rowCount (parent);
+  auto new_row = row + times < count ? row + times : count - 1;
+  auto itr = mModel.index (new_row, 0, parent);
+  setItemSelected (mModel.idOf (itr));
 }
 
 void
 Directory::scrollLeft (int times)
 {
-  auto item = selectedTreeItem ();
-  if (item == nullptr)
+  auto index = mModel.indexOf (selectedId ());
+  if (!index.isValid ())
     return;
 
-  if (item->parent () == nullptr)
+  auto parent = index.parent ();
+  if (!parent.isValid ())
     return;
 
-  auto parent = item->parent ();
-
-  while (--times > 0 && parent->parent ())
+  while (--times > 0 && parent.parent ().isValid ())
     {
-      parent = parent->parent ();
+      parent = parent.parent ();
     }
 
-  setItemSelected (parent);
+  setItemSelected (mModel.idOf (parent));
 }
 
 void
 Directory::scrollRight (int times)
 {
-  auto item = selectedTreeItem ();
-  if (item == nullptr)
+  auto index = mModel.indexOf (selectedId ());
+  if (!index.isValid () || !mModel.hasChildren (index))
     return;
 
-  if (item->childCount () == 0)
-    return;
-
-  item = item->child (0);
-
-  while (--times > 0 && item->childCount () > 0)
+  do
     {
-      item = item->child (0);
+      if (mModel.rowCount (index) == 0)
+        mModel.fetchMore (index);
+      index = mModel.index (0, 0, index);
     }
-  setItemSelected (item);
+  while (--times > 0 && mModel.hasChildren (index));
+
+  setItemSelected (mModel.idOf (index));
 }
 
 void
 Directory::onFileRename ()
 {
-  auto items = mTreeWidget.selectedItems ();
-  if (items.isEmpty ())
-    return;
-
-  auto item = items[0];
-  auto index = getFileIndexFromTreeItem (item);
-  if (index->type != FileIndexType::FILE)
+  auto id = selectedId ();
+  if (id == FileIndexTree::INVALID_ID
+      || mModel.tree ().node (id).type != FileIndexType::FILE)
     return;
 
-  auto qpath = QString::fromLocal8Bit (index->path);
+  auto qpath = QString::fromLocal8Bit (mModel.tree ().path (id));
   auto text = QString (tr ("Input new name of %1")).arg (qpath);
   auto user_text = QInputDialog::getText (this, tr ("Rename"), text,
                                           QLineEdit::Normal, qpath);
@@ -529,9 +1216,7 @@ Directory::onFileRename ()
 
   if (QFile (qpath).rename (nname))
     {
-      index->path = nname.toStdString ();
-      index->title = index->path.substr (index->path.rfind ('/') + 1);
-      setFileIndexToTreeItem (item, index);
+      mModel.rename (id, nname.toStdString ());
     }
   else
     {
@@ -543,23 +1228,23 @@ Directory::onFileRename ()
 void
 Directory::onFileDelete ()
 {
-  auto items = mTreeWidget.selectedItems ();
-  if (items.isEmpty ())
+  auto ids = selectedIds ();
+  if (ids.empty ())
     return;
 
   auto msg_res = QMessageBox::No;
-  for (auto item : items)
+  for (auto id : ids)
     {
-      auto index = getFileIndexFromTreeItem (item);
-      if (index->type != FileIndexType::FILE)
+      auto const &tree = mModel.tree ();
+      if (tree.node (id).type != FileIndexType::FILE)
         continue;
 
-      auto qpath = QString::fromLocal8Bit (index->path);
+      auto qpath = QString::fromLocal8Bit (tree.path (id));
       auto text = QString (tr ("Will delete the \n%1, confirm ?")).arg (qpath);
       if (msg_res == QMessageBox::No || msg_res == QMessageBox::Yes)
         {
           auto buttons = QMessageBox::Yes | QMessageBox::No;
-          if (items.size () > 1)
+          if (ids.size () > 1)
             buttons = QMessageBox::Yes | QMessageBox::YesToAll
                       | QMessageBox::No | QMessageBox::NoToAll;
           msg_res = QMessageBox::question (this, tr ("Confirm"), text, buttons,
@@ -572,20 +1257,9 @@ Directory::onFileDelete ()
       else if (msg_res == QMessageBox::No)
         continue;
 
-      auto parent = item->parent ();
-      if (parent == nullptr)
-        {
-          auto offset = mTreeWidget.indexOfTopLevelItem (item);
-          mIndex.removeChild (*index);
-          item = mTreeWidget.takeTopLevelItem (offset);
-          delete item;
-        }
-      else
-        {
-          auto pindex = getFileIndexFromTreeItem (parent);
-          pindex->removeChild (*index);
-          parent->removeChild (item);
-        }
+      if (tree.node (id).parent == tree.root ())
+        mIndex.removeChild (tree.toFileIndex (id, false));
+      mModel.remove (id);
 
       qDebug () << "delete " << qpath;
       QFile::remove (qpath);
@@ -595,195 +1269,218 @@ Directory::onFileDelete ()
 void
 Directory::onRefresh ()
 {
+  if (mDirIndex.isActive ())
+    {
+      mDirIndex.refresh ();
+      return;
+    }
+
   refreshIndex (mIndex);
 }
 
+void
+Directory::onFilterEdited ()
+{
+  mFilterTimer.start (FILTER_DELAY);
+}
+
 void
 Directory::onFilter ()
 {
-  auto root = mTreeWidget.invisibleRootItem ();
+  mFilterTimer.stop ();
+
   auto cur = mFilterType.currentIndex ();
   auto type = static_cast<FilterType> (cur);
   auto text = mFilterText.text ().trimmed ();
   if (text.isEmpty ())
     {
-      setItemChildrenFilter (root, true);
+      mModel.setFilter (nullptr, false);
       return;
     }
 
-  QDateTime datetime;
-  qint64 qsize;
-  decltype (FileIndex::size) size;
+  auto const &tree = mModel.tree ();
+  auto key = text.toStdString ();
+  auto follow_file = true;
+  vector<Id> matches;
+  DirectoryModel::Filter filter;
+  int64_t low = numeric_limits<int64_t>::min ();
+  int64_t high = numeric_limits<int64_t>::max ();
 
   switch (type)
     {
     case FilterType::Title:
-      filterItemBy (root, [text] (const FileIndex *a) -> filterFuncReturn {
-        return { a->title.find (text.toStdString ()) != string::npos, false };
-      });
+      matches = mFilterIndex.matchTitle (tree, key, false);
+      filter = [&tree, key] (Id id) {
+        return tree.title (id).find (key) != string_view::npos;
+      };
+      follow_file = false;
       break;
 
     case FilterType::FileName:
-      filterItemBy (root, [text] (const FileIndex *a) -> filterFuncReturn {
-        return { a->type == FileIndexType::FILE
-                     && a->title.find (text.toStdString ()) != string::npos,
-                 true };
-      });
+      matches = mFilterIndex.matchTitle (tree, key, true);
+      filter = [&tree, key] (Id id) {
+        return tree.node (id).type == FileIndexType::FILE
+               && tree.title (id).find (key) != string_view::npos;
+      };
       break;
 
     case FilterType::MTimeBe:
-      datetime = QDateTime::fromString (text);
-      filterItemBy (root, [datetime] (const FileIndex *a) -> filterFuncReturn {
-        return { a->type == FileIndexType::FILE
-                     && a->mtime >= datetime.toMSecsSinceEpoch (),
-                 true };
-      });
-      break;
-
     case FilterType::MTimeLe:
-      datetime = QDateTime::fromString (text);
-      filterItemBy (root, [datetime] (const FileIndex *a) -> filterFuncReturn {
-        return { a->type == FileIndexType::FILE
-                     && a->mtime <= datetime.toMSecsSinceEpoch (),
-                 true };
-      });
+      if (type == FilterType::MTimeBe)
+        low = QDateTime::fromString (text).toSecsSinceEpoch ();
+      else
+        high = QDateTime::fromString (text).toSecsSinceEpoch ();
+      matches = mFilterIndex.matchMTime (tree, low, high);
+      filter = [&tree, low, high] (Id id) {
+        auto const &node = tree.node (id);
+        return node.type == FileIndexType::FILE && node.mtime >= low
+               && node.mtime <= high;
+      };
       break;
 
     case FilterType::FileSizeBe:
-      qsize = parseFormattedDataSize (text);
-      size = static_cast<decltype (size)> (qsize);
-      filterItemBy (root, [size] (const FileIndex *a) -> filterFuncReturn {
-        return { a->type == FileIndexType::FILE && a->size >= size, true };
-      });
-      break;
-
     case FilterType::FileSizeLe:
-      qsize = parseFormattedDataSize (text);
-      size = static_cast<decltype (size)> (qsize);
-      filterItemBy (root, [size] (const FileIndex *a) -> filterFuncReturn {
-        return { a->type == FileIndexType::FILE && a->size <= size, true };
-      });
+      if (type == FilterType::FileSizeBe)
+        low = parseFormattedDataSize (text);
+      else
+        high = parseFormattedDataSize (text);
+      matches = mFilterIndex.matchSize (tree, low, high);
+      filter = [&tree, low, high] (Id id) {
+        auto const &node = tree.node (id);
+        return node.type == FileIndexType::FILE && node.size >= low
+               && node.size <= high;
+      };
       break;
+
     default:
       qWarning () << tr ("Filter Type is invalid");
-      break;
+      return;
+    }
+
+  // the matches are looked up by id, the nodes appended later are checked
+  // by the filter itself
+  vector<uint8_t> matched (tree.capacity (), 0);
+  for (auto id : matches)
+    {
+      matched[id] = 1;
     }
+  mModel.setFilter (
+      [matched = std::move (matched), filter] (Id id) {
+        return id < matched.size () ? matched[id] != 0 : filter (id);
+      },
+      follow_file);
 
-  mTreeWidget.expandAll ();
+  expandFiltered ();
 }
 
 void
-Directory::sortItems (QTreeWidgetItem *tree_iter)
+Directory::expandFiltered ()
 {
-  stack<QTreeWidgetItem *> needSort;
-  needSort.push (tree_iter);
+  // expand the shown items which have shown children, the first ones only
+  // as there may be very many
+  auto const &tree = mModel.tree ();
+  if (tree.empty ())
+    return;
 
-  using itemState = pair<QTreeWidgetItem *, bool>;
-  while (!needSort.empty ())
+  auto expanded = 0;
+  stack<Id> ids;
+  ids.push (tree.root ());
+  while (!ids.empty () && expanded < FILTER_EXPAND_LIMIT)
     {
-      auto root = needSort.top ();
-      needSort.pop ();
+      auto id = ids.top ();
+      ids.pop ();
 
-      vector<itemState> item_list;
-      for (auto i = 0; i < root->childCount (); ++i)
+      if (id != tree.root ())
         {
-          auto item = root->child (i);
-          auto index = getFileIndexFromTreeItem (item);
-          if (index->type != FileIndexType::PAGE)
-            item_list.emplace_back (item, item->isExpanded ());
+          auto index = mModel.indexOf (id);
+          if (!index.isValid () || !mModel.hasChildren (index))
+            continue;
+          mTreeView.expand (index);
+          expanded++;
         }
 
-      std::ranges::for_each (item_list, [this, &needSort] (itemState &p) {
-        if (p.first->childCount () > 1)
-          {
-            auto index = getFileIndexFromTreeItem (p.first);
-            if (index && index->type == FileIndexType::DIR)
-              {
-                needSort.push (p.first);
-              }
-          }
-      });
-
-      if (mSortAscending)
-        {
-          switch (mSortColumn)
-            {
-              using enum Column;
-            case Title:
-              std::ranges::sort (
-                  item_list, std::ranges::greater (), [this] (itemState &p) {
-                    auto index = getFileIndexFromTreeItem (p.first);
-                    return index->title;
-                  });
-              break;
-            case MTime:
-              std::ranges::sort (
-                  item_list, std::ranges::greater (), [this] (itemState &p) {
-                    auto index = getFileIndexFromTreeItem (p.first);
-                    return index->mtime;
-                  });
-              break;
-            case FileSize:
-              std::ranges::sort (
-                  item_list, std::ranges::greater (), [this] (itemState &p) {
-                    auto index = getFileIndexFromTreeItem (p.first);
-                    return index->size;
-                  });
-              break;
-            }
-        }
-      else
-        {
-          switch (mSortColumn)
-            {
-              using enum Column;
-            case Title:
-              std::ranges::sort (
-                  item_list, std::ranges::less (), [this] (itemState &p) {
-                    auto index = getFileIndexFromTreeItem (p.first);
-                    return index->title;
-                  });
-              break;
-            case MTime:
-              std::ranges::sort (
-                  item_list, std::ranges::less (), [this] (itemState &p) {
-                    auto index = getFileIndexFromTreeItem (p.first);
-                    return index->mtime;
-                  });
-              break;
-            case FileSize:
-              std::ranges::sort (
-                  item_list, std::ranges::less (), [this] (itemState &p) {
-                    auto index = getFileIndexFromTreeItem (p.first);
-                    return index->size;
-                  });
-              break;
-            }
-        }
+      auto children = tree.children (id);
+      for (auto itr = children.rbegin (); itr != children.rend (); ++itr)
+        ids.push (*itr);
+    }
+}
 
-      mTreeWidget.setUpdatesEnabled (false);
-      for (auto i = 0;
-           static_cast<decltype (item_list.size ())> (i) < item_list.size ();
-           ++i)
-        {
-          auto p = item_list[i];
-          auto oi = root->indexOfChild (p.first);
-          if (oi != i)
-            {
-              root->takeChild (oi);
-              root->insertChild (i, p.first);
-              p.first->setExpanded (p.second);
-            }
-        }
-      mTreeWidget.setUpdatesEnabled (true);
+void
+Directory::sortItems ()
+{
+  if (isMetadataColumn (mSortColumn))
+    requestMetadata ();
+
+  auto order = mSortAscending ? Qt::DescendingOrder : Qt::AscendingOrder;
+  mModel.sort (static_cast<int> (mSortColumn), order);
+}
+
+bool
+Directory::isMetadataColumn (Column column) const
+{
+  return column == Column::Pages || column == Column::Author
+         || column == Column::DocTitle;
+}
+
+void
+Directory::requestMetadata ()
+{
+  // sorting by the metadata needs all the files, not only the visible
+  auto const &tree = mModel.tree ();
+  if (tree.empty ())
+    return;
+
+  vector<string> paths;
+  for (Id id = 0; id < tree.capacity (); ++id)
+    {
+      if (tree.node (id).type == FileIndexType::FILE && !tree.isRemoved (id)
+          && mModel.metadata (id) == nullptr)
+        paths.emplace_back (tree.path (id));
     }
+  MetadataCache::instance ()->request (paths, false);
+}
 
-  mTreeWidget.update ();
+void
+Directory::requestVisibleMetadata ()
+{
+  if (!isVisible ())
+    return;
+
+  vector<string> paths;
+  auto const &tree = mModel.tree ();
+  auto height = mTreeView.viewport ()->height ();
+  for (auto index = mTreeView.indexAt (QPoint (0, 0));
+       index.isValid () && mTreeView.visualRect (index).top () < height;
+       index = mTreeView.indexBelow (index))
+    {
+      auto id = mModel.idOf (index);
+      if (tree.node (id).type == FileIndexType::FILE
+          && mModel.metadata (id) == nullptr)
+        paths.emplace_back (tree.path (id));
+    }
+
+  // the request replaces the last visible rows, send it when they change
+  if (paths == mVisibleFiles)
+    return;
+  mVisibleFiles = std::move (paths);
+  MetadataCache::instance ()->request (mVisibleFiles, true);
+}
+
+void
+Directory::onMetadataExtracted (const QString &path)
+{
+  auto id = mModel.findPath (path.toLocal8Bit ().toStdString ());
+  if (id == FileIndexTree::INVALID_ID
+      || mModel.tree ().node (id).type != FileIndexType::FILE)
+    return;
+
+  mModel.updateMetadata (id);
+  if (isMetadataColumn (mSortColumn))
+    mResortTimer.start (RESORT_DELAY);
 }
 
 void
-Directory::onRowActivated ([[maybe_unused]] QTreeWidgetItem *item,
-                           [[maybe_unused]] int column)
+Directory::onRowActivated ([[maybe_unused]] const QModelIndex &index)
 {
   mFrame->directoryShowPage (currentItemFileIndex (), true);
   mFrame->toggledControlDirectory (true);
@@ -798,26 +1495,23 @@ Directory::onRowDoubleClicked ()
 void
 Directory::onContextMenuRequest (const QPoint &point)
 {
-  auto items = mTreeWidget.selectedItems ();
-  if (items.isEmpty ())
+  auto ids = selectedIds ();
+  if (ids.empty ())
     return;
 
-  auto item = items[0];
-  auto index = getFileIndexFromTreeItem (item);
-  if (index->type == FileIndexType::FILE)
+  auto const &tree = mModel.tree ();
+  if (tree.node (ids[0]).type == FileIndexType::FILE)
     {
       mItemMenu.clear ();
-      if (items.size () == 1)
+      if (ids.size () == 1)
         {
           auto rename_action = mItemMenu.addAction (tr ("Rename File"));
           QObject::connect (rename_action, SIGNAL (triggered (bool)), this,
                             SLOT (onFileRename ()));
         }
-      if (std::all_of (items.begin (), items.end (),
-                       [this] (QTreeWidgetItem *a) {
-                         auto i = getFileIndexFromTreeItem (a);
-                         return i && i->type == FileIndexType::FILE;
-                       }))
+      if (std::ranges::all_of (ids, [&tree] (Id id) {
+            return tree.node (id).type == FileIndexType::FILE;
+          }))
         {
           auto del_action = mItemMenu.addAction (tr ("Delete File"));
           del_action->setIcon (
@@ -825,7 +1519,7 @@ Directory::onContextMenuRequest (const QPoint &point)
           QObject::connect (del_action, SIGNAL (triggered (bool)), this,
                             SLOT (onFileDelete ()));
         }
-      mItemMenu.popup (mTreeWidget.mapToGlobal (point));
+      mItemMenu.popup (mTreeView.viewport ()->mapToGlobal (point));
     }
 }
 
@@ -835,27 +1529,32 @@ Directory::selectFirstItem ()
   if (setCurrentIndex (mFrame->filename (), mFrame->pageNumber (), ""))
     return;
 
-  if (mTreeWidget.topLevelItemCount () > 0)
+  if (mModel.rowCount ({}) == 0 && mModel.canFetchMore ({}))
+    mModel.fetchMore ({});
+
+  if (mModel.rowCount ({}) > 0)
     {
-      auto itr = mTreeWidget.topLevelItem (0);
-      setItemSelected (itr);
+      auto index = mModel.index (0, 0, {});
+      setItemSelected (mModel.idOf (index));
     }
 }
 
-FileIndex *
+optional<FileIndex>
 Directory::currentItemFileIndex ()
 {
-  auto item = selectedTreeItem ();
-  auto index = getFileIndexFromTreeItem (item);
-  return index;
+  auto id = selectedId ();
+  if (id == FileIndexTree::INVALID_ID)
+    return nullopt;
+  return mModel.tree ().toFileIndex (id, false);
 }
 
-FileIndex *
+optional<FileIndex>
 Directory::currentFileFileIndex ()
 {
-  auto item = selectedTreeItem ();
-  auto index = treeItemToFileIndex (item);
-  return index;
+  auto id = mModel.fileOf (selectedId ());
+  if (id == FileIndexTree::INVALID_ID)
+    return nullopt;
+  return mModel.tree ().toFileIndex (id, false);
 }
 
 }
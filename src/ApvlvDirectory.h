@@ -28,29 +28,152 @@
 #ifndef _APVLV_CONTENT_H_
 #define _APVLV_CONTENT_H_
 
+#include <QAbstractItemModel>
 #include <QComboBox>
 #include <QMenu>
 #include <QTimer>
 #include <QToolBar>
-#include <QTreeWidgetItem>
+#include <QTreeView>
 #include <QVBoxLayout>
+#include <functional>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <optional>
 #include <string>
+#include <unordered_map>
 
+#include "ApvlvDirectoryFilter.h"
+#include "ApvlvDirectoryIndex.h"
 #include "ApvlvFile.h"
+#include "ApvlvMetadata.h"
 #include "ApvlvUtil.h"
 #include "ApvlvWidget.h"
 
 namespace apvlv
 {
 
-class ContentTree : public QTreeWidget
+class ContentTree : public QTreeView
 {
 protected:
   void keyPressEvent (QKeyEvent *event) override;
 };
 
+//
+// the model of the Directory panel
+//
+// The rows are the nodes of a FileIndexTree, the internal id of a model
+// index is the node id. The rows of a node are built by the first
+// fetchMore, and given to the view in batches.
+//
+class DirectoryModel : public QAbstractItemModel
+{
+  Q_OBJECT
+public:
+  using Id = FileIndexTree::Id;
+  // a filter matches a node, or all the outline of a file when follow_file
+  using Filter = std::function<bool (Id)>;
+
+  explicit DirectoryModel (QObject *parent = nullptr);
+  ~DirectoryModel () override = default;
+
+  // drops the filter, its ids are of the old tree
+  void reset (const FileIndex &index);
+  Id append (Id parent, const FileIndex &index);
+  void remove (Id id);
+  void update (Id id, const FileIndex &index);
+  void rename (Id id, const std::string &path);
+
+  void setFilter (const Filter &filter, bool follow_file);
+
+  void setHeaderLabels (const QStringList &labels);
+  void setTypeIcons (const std::map<FileIndexType, QIcon> &icons);
+
+  // the cached metadata of a file, nullptr until it is extracted
+  [[nodiscard]] const FileMetadata *metadata (Id id) const;
+  void updateMetadata (Id id);
+
+  [[nodiscard]] const FileIndexTree &
+  tree () const
+  {
+    return mTree;
+  }
+
+  [[nodiscard]] Id child (Id parent, std::string_view title) const;
+  [[nodiscard]] Id findPath (const std::string &path) const;
+  [[nodiscard]] Id fileOf (Id id) const;
+
+  [[nodiscard]] Id idOf (const QModelIndex &index) const;
+  QModelIndex indexOf (Id id);
+
+  [[nodiscard]] QModelIndex index (int row, int column,
+                                   const QModelIndex &parent) const override;
+  [[nodiscard]] QModelIndex parent (const QModelIndex &child) const override;
+  [[nodiscard]] int rowCount (const QModelIndex &parent) const override;
+  [[nodiscard]] int columnCount (const QModelIndex &parent) const override;
+  [[nodiscard]] bool hasChildren (const QModelIndex &parent) const override;
+  [[nodiscard]] QVariant data (const QModelIndex &index,
+                               int role) const override;
+  [[nodiscard]] QVariant headerData (int section, Qt::Orientation orientation,
+                                     int role) const override;
+  [[nodiscard]] bool canFetchMore (const QModelIndex &parent) const override;
+  void fetchMore (const QModelIndex &parent) override;
+  void sort (int column, Qt::SortOrder order) override;
+
+public slots:
+  // sort again by the same column, the metadata may have changed
+  void resort ();
+
+private:
+  struct Rows
+  {
+    std::vector<Id> ids;
+    int fetched{ 0 };
+  };
+
+  struct SortKey
+  {
+    int group;
+    std::int64_t value;
+    std::string_view text;
+    std::string_view title;
+  };
+
+  // nullptr until the rows are built
+  [[nodiscard]] const Rows *builtRows (Id parent) const;
+  Rows &rows (Id parent);
+  void setRow (const Rows &rows, size_t first);
+  // signals the change of a row the view has been given
+  void rowChanged (Id id);
+  [[nodiscard]] bool isVisible (Id id) const;
+  void sortRows (std::vector<Id> &ids) const;
+  [[nodiscard]] SortKey sortKey (Id id) const;
+  [[nodiscard]] bool sortBefore (const SortKey &a, const SortKey &b) const;
+  [[nodiscard]] QModelIndex modelIndex (Id id, int column) const;
+
+  FileIndexTree mTree;
+
+  // the rows of the nodes, and the row of every node in its parent rows
+  std::unordered_map<Id, Rows> mRows;
+  std::vector<std::uint32_t> mRowOf;
+
+  // empty when not filtering
+  std::vector<std::uint8_t> mVisible;
+  Filter mFilter;
+  bool mFollowFile{ false };
+
+  int mSortColumn{ 0 };
+  Qt::SortOrder mSortOrder{ Qt::DescendingOrder };
+
+  QStringList mHeaderLabels;
+  std::map<FileIndexType, QIcon> mTypeIcons;
+
+  // nullptr for the files not extracted yet
+  mutable std::unordered_map<Id, std::shared_ptr<const FileMetadata>>
+      mMetadata;
+  mutable std::unordered_map<Id, QIcon> mCovers;
+};
+
 class ApvlvFrame;
 class Directory final : public QFrame
 {
@@ -67,6 +190,9 @@ public:
     Title = 0,
     MTime,
     FileSize,
+    Pages,
+    Author,
+    DocTitle,
   };
   static std::vector<const char *> ColumnString;
   static std::vector<const char *> SortByColumnString;
@@ -82,14 +208,11 @@ public:
   };
   static std::vector<const char *> FilterTypeString;
 
-  FileIndex *currentItemFileIndex ();
+  void loadDirectory (const std::string &path);
 
-  FileIndex *currentFileFileIndex ();
+  std::optional<FileIndex> currentItemFileIndex ();
 
-  QTreeWidgetItem *findTreeWidgetItem (QTreeWidgetItem *itr,
-                                       FileIndexType type,
-                                       const std::string &path, int pn,
-                                       const std::string &anchor);
+  std::optional<FileIndex> currentFileFileIndex ();
 
   bool setCurrentIndex (const std::string &path, int pn,
                         const std::string &anchor);
@@ -119,35 +242,51 @@ public:
   {
     if (active)
       {
-        QTimer::singleShot (50, &mTreeWidget, SLOT (setFocus ()));
+        QTimer::singleShot (50, &mTreeView, SLOT (setFocus ()));
       }
     else
       {
-        mTreeWidget.clearFocus ();
+        mTreeView.clearFocus ();
       }
   }
 
   bool
   isActive ()
   {
-    return mTreeWidget.hasFocus ();
+    return mTreeView.hasFocus ();
   }
 
+protected:
+  // the rows shown now are checked for missing metadata
+  void showEvent (QShowEvent *event) override;
+  void resizeEvent (QResizeEvent *event) override;
+
 private:
+  using Id = FileIndexTree::Id;
+
   QVBoxLayout mLayout;
   QToolBar mToolBar;
   ApvlvLineEdit mFilterText;
   QComboBox mFilterType;
   QComboBox mSortType;
-  ContentTree mTreeWidget;
+  ContentTree mTreeView;
+  DirectoryModel mModel;
 
   QMenu mItemMenu;
 
-  std::map<FileIndexType, QIcon> mTypeIcons;
-
   FileIndex mIndex;
   Column mSortColumn{ Column::Title };
 
+  DirectoryIndex mDirIndex;
+  QTimer mDirIndexTimer;
+
+  DirectoryFilter mFilterIndex;
+  QTimer mFilterTimer;
+
+  QTimer mMetadataTimer;
+  QTimer mResortTimer;
+  std::vector<std::string> mVisibleFiles;
+
   ApvlvFrame *mFrame{ nullptr };
 
   bool mSortAscending{ true };
@@ -155,43 +294,44 @@ private:
   void setupToolBar ();
   void setupTree ();
 
-  QTreeWidgetItem *
-  selectedTreeItem ()
-  {
-    auto selitems = mTreeWidget.selectedItems ();
-    return selitems.isEmpty () ? nullptr : selitems[0];
-  }
-  void setItemSelected (QTreeWidgetItem *item);
+  [[nodiscard]] Id selectedId () const;
+  std::vector<Id> selectedIds () const;
+  void setItemSelected (Id id);
 
-  void setIndex (FileIndex &index, QTreeWidgetItem *root_itr);
   void refreshIndex (const FileIndex &index);
+  // resets the model to mIndex, the filter of the box is applied again
+  void resetModel ();
+
+  void applyUpdate (DirectoryUpdate &update);
 
-  void setFileIndexToTreeItem (QTreeWidgetItem *item, FileIndex *index);
-  FileIndex *getFileIndexFromTreeItem (QTreeWidgetItem *item);
+  Id findItem (Id root, FileIndexType type, const std::string &path, int pn,
+               const std::string &anchor) const;
 
-  FileIndex *treeItemToFileIndex (QTreeWidgetItem *item);
+  void expandFiltered ();
 
-  using filterFuncReturn = std::tuple<bool, bool>;
-  using filterFunc = std::function<filterFuncReturn (const FileIndex *)>;
-  void filterItemBy (QTreeWidgetItem *root, const filterFunc &filter_func);
-  void setItemChildrenFilter (QTreeWidgetItem *root, bool is_filter);
+  [[nodiscard]] bool isMetadataColumn (Column column) const;
+  void requestMetadata ();
 
 private slots:
   void onFileRename ();
   void onFileDelete ();
   void onRefresh ();
+  void onFilterEdited ();
   void onFilter ();
+  void applyUpdates ();
+  void requestVisibleMetadata ();
+  void onMetadataExtracted (const QString &path);
   void
   sortBy (int method)
   {
     mSortAscending = !mSortAscending;
     mSortColumn = static_cast<Column> (method);
-    sortItems (mTreeWidget.invisibleRootItem ());
+    sortItems ();
   }
 
-  void sortItems (QTreeWidgetItem *root);
+  void sortItems ();
 
-  void onRowActivated (QTreeWidgetItem *item, int column);
+  void onRowActivated (const QModelIndex &index);
   void onRowDoubleClicked ();
   void onContextMenuRequest (const QPoint &point);
   void selectFirstItem ();
@@ -0,0 +1,274 @@
+/*
+ * This file is part of the apvlv package
+ *
+ * Copyright (C) 2008 Alf.
+ *
+ * Contact: Alf <naihe2010@126.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2.0 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+/* @CPPFILE ApvlvDirectoryFilter.cc
+ *
+ *  Author: Alf <naihe2010@126.com>
+ */
+
+#include <algorithm>
+#include <unordered_set>
+
+#include "ApvlvDirectoryFilter.h"
+
+namespace apvlv
+{
+
+using namespace std;
+
+static bool
+removed (const FileIndexTree &tree, FileIndexTree::Id id)
+{
+  return id != tree.root ()
+         && tree.node (id).parent == FileIndexTree::INVALID_ID;
+}
+
+static uint32_t
+trigram (string_view str, size_t pos)
+{
+  return static_cast<uint8_t> (str[pos]) << 16
+         | static_cast<uint8_t> (str[pos + 1]) << 8
+         | static_cast<uint8_t> (str[pos + 2]);
+}
+
+void
+DirectoryFilter::clear ()
+{
+  mIndexed = 0;
+  mModified = 0;
+  mTrigrams.clear ();
+  mColumnsSorted = false;
+  mByMTime.clear ();
+  mBySize.clear ();
+  mLastValid = false;
+  mLastMatches.clear ();
+}
+
+const vector<DirectoryFilter::Id> &
+DirectoryFilter::matchTitle (const FileIndexTree &tree, const string &key,
+                             bool files_only)
+{
+  update (tree);
+
+  // a longer query only matches the matches of the shorter one
+  const vector<Id> *candidates = nullptr;
+  if (mLastValid && mLastFilesOnly == files_only
+      && key.find (mLastKey) != string::npos)
+    candidates = &mLastMatches;
+
+  vector<Id> matches;
+  auto no_match = false;
+  for (size_t pos = 0; pos + 3 <= key.size (); ++pos)
+    {
+      auto itr = mTrigrams.find (trigram (key, pos));
+      if (itr == mTrigrams.end ())
+        {
+          no_match = true;
+          break;
+        }
+      if (candidates == nullptr || itr->second.size () < candidates->size ())
+        candidates = &itr->second;
+    }
+
+  auto check = [&] (Id id) {
+    if (removed (tree, id))
+      return;
+    if (files_only && tree.node (id).type != FileIndexType::FILE)
+      return;
+    if (tree.title (id).find (key) != string_view::npos)
+      matches.push_back (id);
+  };
+
+  if (candidates && !no_match)
+    {
+      std::ranges::for_each (*candidates, check);
+    }
+  else if (!no_match)
+    {
+      for (Id id = 1; id < tree.capacity (); ++id)
+        check (id);
+    }
+
+  mLastKey = key;
+  mLastFilesOnly = files_only;
+  mLastValid = true;
+  mLastMatches = std::move (matches);
+  return mLastMatches;
+}
+
+vector<DirectoryFilter::Id>
+DirectoryFilter::matchMTime (const FileIndexTree &tree, int64_t low,
+                             int64_t high)
+{
+  update (tree);
+  sortColumns (tree);
+
+  auto value = [&tree] (Id id) { return tree.node (id).mtime; };
+  auto first = std::ranges::lower_bound (mByMTime, low, {}, value);
+  auto last = std::ranges::upper_bound (mByMTime, high, {}, value);
+  vector<Id> matches (first, std::max (first, last));
+  std::ranges::sort (matches);
+  return matches;
+}
+
+vector<DirectoryFilter::Id>
+DirectoryFilter::matchSize (const FileIndexTree &tree, int64_t low,
+                            int64_t high)
+{
+  update (tree);
+  sortColumns (tree);
+
+  auto value = [&tree] (Id id) { return tree.node (id).size; };
+  auto first = std::ranges::lower_bound (mBySize, low, {}, value);
+  auto last = std::ranges::upper_bound (mBySize, high, {}, value);
+  vector<Id> matches (first, std::max (first, last));
+  std::ranges::sort (matches);
+  return matches;
+}
+
+void
+DirectoryFilter::update (const FileIndexTree &tree)
+{
+  if (tree.revision () != mRevision || tree.capacity () < mIndexed)
+    {
+      clear ();
+      mRevision = tree.revision ();
+      mModified = tree.modified ().size ();
+    }
+
+  // a modified file keeps its title, only its place in the columns moves,
+  // a removed node leaves the index
+  if (mModified < tree.modified ().size ())
+    {
+      dropRemoved (tree, mModified);
+      if (mColumnsSorted)
+        resortColumns (tree, mModified);
+      mModified = tree.modified ().size ();
+    }
+
+  if (mIndexed == tree.capacity ())
+    return;
+
+  // the new nodes may match the last query too
+  mLastValid = false;
+  mColumnsSorted = false;
+  for (auto id = static_cast<Id> (mIndexed); id < tree.capacity (); ++id)
+    {
+      if (removed (tree, id))
+        continue;
+
+      auto title = tree.title (id);
+      for (size_t pos = 0; pos + 3 <= title.size (); ++pos)
+        {
+          auto &ids = mTrigrams[trigram (title, pos)];
+          if (ids.empty () || ids.back () != id)
+            ids.push_back (id);
+        }
+    }
+  mIndexed = tree.capacity ();
+}
+
+void
+DirectoryFilter::dropRemoved (const FileIndexTree &tree, size_t first)
+{
+  auto erase = [] (vector<Id> &ids, Id id) {
+    auto itr = std::ranges::lower_bound (ids, id);
+    if (itr != ids.end () && *itr == id)
+      ids.erase (itr);
+  };
+
+  auto const &modified = tree.modified ();
+  for (auto i = first; i < modified.size (); ++i)
+    {
+      auto id = modified[i];
+      if (id >= mIndexed || !removed (tree, id))
+        continue;
+
+      auto title = tree.title (id);
+      for (size_t pos = 0; pos + 3 <= title.size (); ++pos)
+        {
+          auto itr = mTrigrams.find (trigram (title, pos));
+          if (itr == mTrigrams.end ())
+            continue;
+          erase (itr->second, id);
+          if (itr->second.empty ())
+            mTrigrams.erase (itr);
+        }
+      erase (mLastMatches, id);
+    }
+}
+
+void
+DirectoryFilter::sortColumns (const FileIndexTree &tree)
+{
+  if (mColumnsSorted)
+    return;
+
+  mByMTime.clear ();
+  for (Id id = 1; id < tree.capacity (); ++id)
+    {
+      if (tree.node (id).type == FileIndexType::FILE && !removed (tree, id))
+        mByMTime.push_back (id);
+    }
+  mBySize = mByMTime;
+
+  std::ranges::sort (mByMTime, {},
+                     [&tree] (Id id) { return tree.node (id).mtime; });
+  std::ranges::sort (mBySize, {},
+                     [&tree] (Id id) { return tree.node (id).size; });
+  mColumnsSorted = true;
+}
+
+void
+DirectoryFilter::resortColumns (const FileIndexTree &tree, size_t first)
+{
+  auto const &modified = tree.modified ();
+  unordered_set<Id> moved (modified.begin () + static_cast<ptrdiff_t> (first),
+                           modified.end ());
+  std::erase_if (moved, [&tree] (Id id) {
+    return id >= tree.capacity ()
+           || tree.node (id).type != FileIndexType::FILE;
+  });
+  if (moved.empty ())
+    return;
+
+  // the moved files are taken out, the others are still sorted, the
+  // removed ones are not put back
+  auto reinsert = [&tree, &moved] (vector<Id> &column, auto value) {
+    std::erase_if (column, [&moved] (Id id) { return moved.contains (id); });
+    for (auto id : moved)
+      {
+        if (removed (tree, id))
+          continue;
+        auto pos = std::ranges::upper_bound (column, value (id), {}, value);
+        column.insert (pos, id);
+      }
+  };
+  reinsert (mByMTime, [&tree] (Id id) { return tree.node (id).mtime; });
+  reinsert (mBySize, [&tree] (Id id) { return tree.node (id).size; });
+}
+
+}
+
+// Local Variables:
+// mode: c++
+// End:
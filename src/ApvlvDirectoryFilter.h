@@ -0,0 +1,100 @@
+/*
+ * This file is part of the apvlv package
+ *
+ * Copyright (C) 2008 Alf.
+ *
+ * Contact: Alf <naihe2010@126.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2.0 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+/* @CPPFILE ApvlvDirectoryFilter.h
+ *
+ *  Author: Alf <naihe2010@126.com>
+ */
+
+#ifndef _APVLV_DIRECTORY_FILTER_H_
+#define _APVLV_DIRECTORY_FILTER_H_
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "ApvlvFileIndex.h"
+
+namespace apvlv
+{
+
+//
+// the search index of the Directory filter
+//
+// Titles are indexed by their trigrams, a query is checked against the
+// nodes of its rarest trigram only. When the query grows, only the
+// matches of the previous query are checked again. The files are also
+// kept sorted by mtime and size for the range filters.
+//
+// The index follows the appended and removed nodes and the modified
+// files of the tree, and is built again when the tree revision changes.
+// The removed nodes are not indexed.
+//
+class DirectoryFilter
+{
+public:
+  using Id = FileIndexTree::Id;
+
+  void clear ();
+
+  // the nodes whose title has key, sorted by id
+  const std::vector<Id> &matchTitle (const FileIndexTree &tree,
+                                     const std::string &key,
+                                     bool files_only);
+
+  // the files whose mtime or size is in [low, high]
+  std::vector<Id> matchMTime (const FileIndexTree &tree, std::int64_t low,
+                              std::int64_t high);
+  std::vector<Id> matchSize (const FileIndexTree &tree, std::int64_t low,
+                             std::int64_t high);
+
+private:
+  void update (const FileIndexTree &tree);
+  void dropRemoved (const FileIndexTree &tree, size_t first);
+  void sortColumns (const FileIndexTree &tree);
+  void resortColumns (const FileIndexTree &tree, size_t first);
+
+  std::uint32_t mRevision{ 0 };
+  size_t mIndexed{ 0 };
+  // the entries of FileIndexTree::modified () in the sorted columns
+  size_t mModified{ 0 };
+  std::unordered_map<std::uint32_t, std::vector<Id>> mTrigrams;
+
+  bool mColumnsSorted{ false };
+  std::vector<Id> mByMTime;
+  std::vector<Id> mBySize;
+
+  std::string mLastKey;
+  bool mLastFilesOnly{ false };
+  bool mLastValid{ false };
+  std::vector<Id> mLastMatches;
+};
+
+}
+
+#endif
+
+/* Local Variables: */
+/* mode: c++ */
+/* End: */
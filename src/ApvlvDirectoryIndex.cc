@@ -0,0 +1,585 @@
+/*
+ * This file is part of the apvlv package
+ *
+ * Copyright (C) 2008 Alf.
+ *
+ * Contact: Alf <naihe2010@126.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2.0 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+/* @CPPFILE ApvlvDirectoryIndex.cc
+ *
+ *  Author: Alf <naihe2010@126.com>
+ */
+
+#include <QDebug>
+#include <QFile>
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <stack>
+
+#include "ApvlvDirectoryIndex.h"
+#include "ApvlvFile.h"
+#include "ApvlvUtil.h"
+
+namespace apvlv
+{
+
+using namespace std;
+
+// the listing is bound by the file system, more threads do not help
+const unsigned int SCAN_THREADS_MAX = 8;
+
+// top level directories sent to the panel at once
+const size_t SCAN_BATCH = 32;
+
+DirectoryIndex::DirectoryIndex ()
+{
+  mChangedTimer.setSingleShot (true);
+  QObject::connect (&mChangedTimer, SIGNAL (timeout ()), this,
+                    SLOT (rescanChanged ()));
+  QObject::connect (&mWatcher, SIGNAL (directoryChanged (const QString &)),
+                    this, SLOT (onDirectoryChanged (const QString &)));
+  mTask = thread ([this] () { workerLoop (); });
+}
+
+DirectoryIndex::~DirectoryIndex ()
+{
+  mQuit.store (true);
+  mTask.join ();
+}
+
+void
+DirectoryIndex::load (const string &root)
+{
+  clear ();
+  mRoot = root;
+  mTasks.push ({ Task::Kind::LOAD, mGeneration.load (), root });
+}
+
+void
+DirectoryIndex::clear ()
+{
+  mGeneration++;
+  mRoot.clear ();
+  mTasks.clear ();
+  mUpdates.clear ();
+  mChangedDirs.clear ();
+  mChangedTimer.stop ();
+
+  auto dirs = mWatcher.directories ();
+  if (!dirs.isEmpty ())
+    mWatcher.removePaths (dirs);
+}
+
+void
+DirectoryIndex::refresh ()
+{
+  if (mRoot.empty ())
+    return;
+
+  mTasks.push ({ Task::Kind::RECONCILE, mGeneration.load (), mRoot });
+}
+
+vector<DirectoryUpdate>
+DirectoryIndex::takeUpdates ()
+{
+  vector<DirectoryUpdate> updates;
+  QStringList watches;
+  DirectoryUpdate update;
+  while (mUpdates.pop (update))
+    {
+      if (update.generation != mGeneration.load ())
+        continue;
+
+      if (update.kind == DirectoryUpdate::Kind::WATCH)
+        {
+          watches.append (QString::fromLocal8Bit (update.index.path));
+          continue;
+        }
+
+      updates.emplace_back (std::move (update));
+    }
+
+  if (!watches.isEmpty ())
+    {
+      auto failed = mWatcher.addPaths (watches);
+      if (!failed.isEmpty ())
+        qWarning () << "can't watch " << failed.size () << " directories";
+    }
+
+  return updates;
+}
+
+void
+DirectoryIndex::onDirectoryChanged (const QString &path)
+{
+  // changes come in bursts, rescan them together
+  mChangedDirs.insert (path.toLocal8Bit ().toStdString ());
+  mChangedTimer.start (500);
+}
+
+void
+DirectoryIndex::rescanChanged ()
+{
+  for (auto const &dir : mChangedDirs)
+    {
+      mTasks.push ({ Task::Kind::RESCAN, mGeneration.load (), dir });
+    }
+  mChangedDirs.clear ();
+}
+
+void
+DirectoryIndex::workerLoop ()
+{
+  while (mQuit.load () == false)
+    {
+      Task task;
+      if (mTasks.pop (task))
+        {
+          if (aborted (task.generation))
+            continue;
+
+          mChanged = false;
+          try
+            {
+              switch (task.kind)
+                {
+                case Task::Kind::LOAD:
+                  load (task);
+                  break;
+                case Task::Kind::RESCAN:
+                  rescan (task);
+                  break;
+                case Task::Kind::RECONCILE:
+                  reconcile (task);
+                  break;
+                }
+            }
+          catch (const filesystem::filesystem_error &err)
+            {
+              qWarning () << "file system error: " << err.what ();
+            }
+
+          // an aborted task leaves a partial tree, never save it
+          if (aborted (task.generation))
+            mDirty = false;
+          else if (mChanged)
+            mDirty = true;
+        }
+      else if (mDirty)
+        {
+          saveSnapshot ();
+        }
+      else
+        {
+          this_thread::sleep_for (100ms);
+        }
+    }
+}
+
+void
+DirectoryIndex::load (const Task &task)
+{
+  auto exts = FileFactory::supportFileExts ();
+  std::ranges::sort (exts);
+  if (!mScanner || mScanner->extensions () != exts)
+    {
+      auto threads = std::clamp (thread::hardware_concurrency (), 1u,
+                                 SCAN_THREADS_MAX);
+      mScanner = make_unique<DirectoryScanner> (exts, threads);
+    }
+
+  if (loadSnapshot (task))
+    {
+      qDebug () << "directory " << QString::fromLocal8Bit (task.path)
+                << " loaded from snapshot, " << mTree.capacity ()
+                << " nodes";
+      reconcile (task);
+      return;
+    }
+
+  FileIndex root ("", 0, task.path, FileIndexType::DIR);
+  DirectoryScanner::Entry status;
+  if (DirectoryScanner::status (task.path, status))
+    root.mtime = status.mtime;
+  mTree.assign (root);
+
+  post (DirectoryUpdate::Kind::RESET, task.generation, "", root);
+  post (DirectoryUpdate::Kind::WATCH, task.generation, "", root);
+
+  vector<DirectoryScanner::Entry> entries;
+  mScanner->list (task.path, entries);
+  mTree.reserveChildren (mTree.root (), entries.size ());
+  vector<Id> dirs;
+  for (auto const &entry : entries)
+    {
+      auto child = mTree.append (mTree.root (), entry.type, entry.name,
+                                 entry.size, entry.mtime);
+      if (entry.type == FileIndexType::DIR)
+        dirs.push_back (child);
+      else
+        post (DirectoryUpdate::Kind::ADD, task.generation, task.path,
+              mTree.toFileIndex (child, false));
+    }
+
+  // the panel gets the top level directories in batches, every batch is
+  // scanned in parallel
+  for (size_t begin = 0; begin < dirs.size (); begin += SCAN_BATCH)
+    {
+      auto end = std::min (begin + SCAN_BATCH, dirs.size ());
+      vector<Id> batch (dirs.begin () + begin, dirs.begin () + end);
+      if (!scanTrees (batch, task.generation))
+        return;
+
+      for (auto dir : batch)
+        {
+          if (mTree.hasFiles (dir))
+            post (DirectoryUpdate::Kind::ADD, task.generation, task.path,
+                  mTree.visibleCopy (dir));
+        }
+    }
+
+  mChanged = true;
+  qDebug () << "directory " << QString::fromLocal8Bit (task.path)
+            << " scanned, " << mTree.capacity () << " nodes";
+}
+
+bool
+DirectoryIndex::loadSnapshot (const Task &task)
+{
+  QFile file (QString::fromLocal8Bit (snapshotPath (task.path)));
+  if (!file.open (QIODevice::ReadOnly))
+    return false;
+
+  // the tree copies the nodes and the strings, the image is read once
+  auto data = file.readAll ();
+  auto loaded
+      = mTree.load (data.constData (), static_cast<size_t> (data.size ()));
+  if (!loaded || mTree.path (mTree.root ()) != task.path
+      || mTree.node (mTree.root ()).type != FileIndexType::DIR)
+    {
+      qWarning () << "directory snapshot " << file.fileName ()
+                  << " is invalid";
+      return false;
+    }
+
+  auto root = mTree.toFileIndex (mTree.root (), false);
+  post (DirectoryUpdate::Kind::RESET, task.generation, "", root);
+
+  stack<Id> dirs;
+  dirs.push (mTree.root ());
+  while (!dirs.empty ())
+    {
+      auto dir = dirs.top ();
+      dirs.pop ();
+      post (DirectoryUpdate::Kind::WATCH, task.generation, "",
+            mTree.toFileIndex (dir, false));
+      for (auto child : mTree.children (dir))
+        {
+          if (mTree.node (child).type == FileIndexType::DIR)
+            dirs.push (child);
+        }
+    }
+
+  for (auto child : mTree.children (mTree.root ()))
+    {
+      if (mTree.node (child).type == FileIndexType::FILE)
+        post (DirectoryUpdate::Kind::ADD, task.generation, task.path,
+              mTree.toFileIndex (child, false));
+      else if (mTree.hasFiles (child))
+        post (DirectoryUpdate::Kind::ADD, task.generation, task.path,
+              mTree.visibleCopy (child));
+    }
+
+  return true;
+}
+
+void
+DirectoryIndex::saveSnapshot ()
+{
+  mDirty = false;
+  if (mTree.empty ())
+    return;
+
+  mTree.compact ();
+  auto filename = snapshotPath (mTree.path (mTree.root ()));
+  auto temp = filename + ".tmp";
+  error_code code;
+  filesystem::create_directories (filesystem::path (filename).parent_path (),
+                                  code);
+
+  ofstream ofs (temp, ios::binary | ios::trunc);
+  if (!ofs.is_open () || !mTree.save (ofs))
+    {
+      qWarning () << "can't write directory snapshot "
+                  << QString::fromLocal8Bit (temp);
+      return;
+    }
+  ofs.close ();
+
+  // replace the old snapshot at once, a reader never sees half of it
+  filesystem::rename (temp, filename, code);
+  if (code)
+    qWarning () << "can't write directory snapshot "
+                << QString::fromLocal8Bit (filename);
+}
+
+string
+DirectoryIndex::snapshotPath (const string &root) const
+{
+  // a new extension list needs a new scan
+  auto key = root;
+  for (auto const &ext : mScanner->extensions ())
+    key += "\n" + ext;
+
+  stringstream ss;
+  ss << hex << std::hash<string>{}(key);
+  return CacheDir + PATH_SEP_S + "dirindex" + PATH_SEP_S + ss.str ();
+}
+
+void
+DirectoryIndex::rescan (const Task &task)
+{
+  auto chain = findDirectory (task.path);
+  if (chain.empty ())
+    return;
+
+  error_code code;
+  if (!filesystem::is_directory (task.path, code))
+    return;
+
+  // the panel only has the directories which have files, find the
+  // highest directory of the chain which is not in the panel yet
+  auto dir = chain.back ();
+  auto top = chain.size ();
+  for (auto i = chain.size () - 1; i > 0 && !mTree.hasFiles (chain[i]);
+       --i)
+    {
+      top = i;
+    }
+
+  auto visible = top == chain.size ();
+  if (!rescanDirectory (dir, task.generation, visible))
+    return;
+
+  if (!visible)
+    {
+      if (mTree.hasFiles (chain[top]))
+        post (DirectoryUpdate::Kind::ADD, task.generation,
+              mTree.path (chain[top - 1]), mTree.visibleCopy (chain[top]));
+      return;
+    }
+
+  if (chain.size () == 1 || mTree.hasFiles (dir))
+    return;
+
+  // the directory has no file any more, remove its highest empty ancestor
+  auto bottom = chain.size () - 1;
+  while (bottom > 1 && !mTree.hasFiles (chain[bottom - 1]))
+    {
+      --bottom;
+    }
+  post (DirectoryUpdate::Kind::REMOVE, task.generation,
+        mTree.path (chain[bottom - 1]),
+        mTree.toFileIndex (chain[bottom], false));
+}
+
+void
+DirectoryIndex::reconcile (const Task &task)
+{
+  // a directory mtime changes when its entries are added, removed or
+  // renamed, the unchanged directories are not listed again
+  vector<string> changed;
+  stack<Id> dirs;
+  dirs.push (mTree.root ());
+  while (!dirs.empty ())
+    {
+      if (aborted (task.generation))
+        return;
+
+      auto dir = dirs.top ();
+      dirs.pop ();
+
+      auto path = mTree.path (dir);
+      DirectoryScanner::Entry status;
+      if (!DirectoryScanner::status (path, status)
+          || status.mtime != mTree.node (dir).mtime)
+        changed.emplace_back (std::move (path));
+
+      for (auto child : mTree.children (dir))
+        {
+          if (mTree.node (child).type == FileIndexType::DIR)
+            dirs.push (child);
+        }
+    }
+
+  qDebug () << "reconcile " << QString::fromLocal8Bit (task.path) << ", "
+            << changed.size () << " directories changed";
+  for (auto const &path : changed)
+    {
+      if (aborted (task.generation))
+        return;
+      rescan ({ Task::Kind::RESCAN, task.generation, path });
+    }
+}
+
+bool
+DirectoryIndex::rescanDirectory (Id dir, unsigned int generation,
+                                 bool is_post)
+{
+  auto path = mTree.path (dir);
+  vector<DirectoryScanner::Entry> listed;
+  if (!mScanner->list (path, listed))
+    return false;
+
+  map<string, DirectoryScanner::Entry> entries;
+  for (auto &entry : listed)
+    {
+      auto name = entry.name;
+      entries.emplace (std::move (name), std::move (entry));
+    }
+
+  DirectoryScanner::Entry status;
+  if (DirectoryScanner::status (path, status)
+      && status.mtime != mTree.node (dir).mtime)
+    {
+      mTree.setFile (dir, 0, status.mtime);
+      mChanged = true;
+    }
+
+  auto changed = false;
+  for (size_t row = 0; row < mTree.node (dir).count;)
+    {
+      auto child = mTree.child (dir, row);
+      auto const &node = mTree.node (child);
+      auto entry = entries.find (string (mTree.title (child)));
+      if (entry == entries.end () || entry->second.type != node.type)
+        {
+          if (is_post
+              && (node.type == FileIndexType::FILE || mTree.hasFiles (child)))
+            post (DirectoryUpdate::Kind::REMOVE, generation, path,
+                  mTree.toFileIndex (child, false));
+          mTree.remove (child);
+          changed = true;
+          continue;
+        }
+
+      auto const &index = entry->second;
+      if (index.type == FileIndexType::FILE
+          && (index.mtime != node.mtime || index.size != node.size))
+        {
+          mTree.setFile (child, index.size, index.mtime);
+          if (is_post)
+            post (DirectoryUpdate::Kind::CHANGE, generation, path,
+                  mTree.toFileIndex (child, false));
+          changed = true;
+        }
+
+      entries.erase (entry);
+      ++row;
+    }
+
+  vector<Id> dirs;
+  for (auto const &[name, entry] : entries)
+    {
+      auto child = mTree.append (dir, entry.type, entry.name, entry.size,
+                                 entry.mtime);
+      if (entry.type == FileIndexType::DIR)
+        dirs.push_back (child);
+      else if (is_post)
+        post (DirectoryUpdate::Kind::ADD, generation, path,
+              mTree.toFileIndex (child, false));
+      changed = true;
+    }
+
+  if (!dirs.empty () && scanTrees (dirs, generation) && is_post)
+    {
+      for (auto child : dirs)
+        {
+          if (mTree.hasFiles (child))
+            post (DirectoryUpdate::Kind::ADD, generation, path,
+                  mTree.visibleCopy (child));
+        }
+    }
+
+  if (changed)
+    mChanged = true;
+  return changed;
+}
+
+bool
+DirectoryIndex::scanTrees (const vector<Id> &dirs, unsigned int generation)
+{
+  return mScanner->scan (mTree, dirs, [this, generation] (Id dir) {
+    if (aborted (generation))
+      return false;
+    post (DirectoryUpdate::Kind::WATCH, generation, "",
+          FileIndex ("", 0, mTree.path (dir), FileIndexType::DIR));
+    return true;
+  });
+}
+
+vector<FileIndexTree::Id>
+DirectoryIndex::findDirectory (const string &path)
+{
+  if (mTree.empty ())
+    return {};
+
+  vector<Id> chain{ mTree.root () };
+  auto relative
+      = filesystem::path (path).lexically_relative (mTree.path (mTree.root ()));
+  if (relative.empty () || *relative.begin () == "..")
+    return {};
+
+  for (auto const &name : relative)
+    {
+      if (name == ".")
+        continue;
+
+      auto children = mTree.children (chain.back ());
+      auto child = std::ranges::find_if (children, [&] (auto id) {
+        return mTree.node (id).type == FileIndexType::DIR
+               && mTree.title (id) == name.string ();
+      });
+      if (child == children.end ())
+        return {};
+      chain.push_back (*child);
+    }
+
+  return chain;
+}
+
+bool
+DirectoryIndex::aborted (unsigned int generation)
+{
+  return mQuit.load () || generation != mGeneration.load ();
+}
+
+void
+DirectoryIndex::post (DirectoryUpdate::Kind kind, unsigned int generation,
+                      const string &dir, FileIndex index)
+{
+  mUpdates.push ({ kind, generation, dir, std::move (index) });
+}
+
+}
+
+// Local Variables:
+// mode: c++
+// End:
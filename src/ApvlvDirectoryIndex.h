@@ -0,0 +1,173 @@
+/*
+ * This file is part of the apvlv package
+ *
+ * Copyright (C) 2008 Alf.
+ *
+ * Contact: Alf <naihe2010@126.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2.0 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+/* @CPPFILE ApvlvDirectoryIndex.h
+ *
+ *  Author: Alf <naihe2010@126.com>
+ */
+
+#ifndef _APVLV_DIRECTORY_INDEX_H_
+#define _APVLV_DIRECTORY_INDEX_H_
+
+#include <QFileSystemWatcher>
+#include <QObject>
+#include <QTimer>
+#include <atomic>
+#include <filesystem>
+#include <memory>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ApvlvFileIndex.h"
+#include "ApvlvQueue.h"
+
+namespace apvlv
+{
+
+//
+// a change of the directory index, made by the scanner thread and
+// applied by the Directory panel
+//
+struct DirectoryUpdate
+{
+  enum class Kind
+  {
+    RESET,
+    ADD,
+    REMOVE,
+    CHANGE,
+    WATCH,
+  };
+
+  Kind kind;
+  unsigned int generation;
+  // path of the parent directory
+  std::string dir;
+  FileIndex index;
+};
+
+//
+// the index of a directory tree, it is scanned in background and kept up
+// to date by a file system watcher
+//
+// The scanner thread owns the full tree, including directories without
+// any supported file. The Directory panel gets the visible part as a
+// stream of updates: the root first, then every top level subtree when
+// its scan completes, then the patches of the changed directories.
+//
+// The tree is saved to a snapshot in the cache directory when the scanner
+// is idle. The next load of the same root sends the snapshot at once, and
+// then reconciles it with the file system.
+//
+class DirectoryIndex final : public QObject
+{
+  Q_OBJECT
+public:
+  DirectoryIndex ();
+  ~DirectoryIndex () override;
+
+  void load (const std::string &root);
+  void clear ();
+
+  // reconcile with the file system, only the directories whose mtime
+  // changed are listed again
+  void refresh ();
+
+  std::vector<DirectoryUpdate> takeUpdates ();
+
+  [[nodiscard]] bool
+  isActive () const
+  {
+    return !mRoot.empty ();
+  }
+
+  [[nodiscard]] const std::string &
+  root () const
+  {
+    return mRoot;
+  }
+
+private slots:
+  void onDirectoryChanged (const QString &path);
+  void rescanChanged ();
+
+private:
+  struct Task
+  {
+    enum class Kind
+    {
+      LOAD,
+      RESCAN,
+      RECONCILE,
+    };
+
+    Kind kind;
+    unsigned int generation;
+    std::string path;
+  };
+
+  void workerLoop ();
+  void load (const Task &task);
+  bool loadSnapshot (const Task &task);
+  void saveSnapshot ();
+  std::string snapshotPath (const std::string &root) const;
+  void rescan (const Task &task);
+  void reconcile (const Task &task);
+
+  using Id = FileIndexTree::Id;
+
+  bool rescanDirectory (Id dir, unsigned int generation, bool post);
+  bool scanTrees (const std::vector<Id> &dirs, unsigned int generation);
+  std::vector<Id> findDirectory (const std::string &path);
+  bool aborted (unsigned int generation);
+  void post (DirectoryUpdate::Kind kind, unsigned int generation,
+             const std::string &dir, FileIndex index);
+
+  std::string mRoot;
+  std::atomic<unsigned int> mGeneration{ 0 };
+
+  std::thread mTask;
+  std::atomic<bool> mQuit{ false };
+  LockQueue<Task> mTasks;
+  LockQueue<DirectoryUpdate> mUpdates;
+
+  // only used by the scanner thread
+  FileIndexTree mTree;
+  std::unique_ptr<DirectoryScanner> mScanner;
+  // the tree has changed since the last snapshot
+  bool mChanged{ false };
+  bool mDirty{ false };
+
+  QFileSystemWatcher mWatcher;
+  QTimer mChangedTimer;
+  std::set<std::string> mChangedDirs;
+};
+
+}
+
+#endif
+
+/* Local Variables: */
+/* mode: c++ */
+/* End: */
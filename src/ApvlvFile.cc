@@ -34,8 +34,12 @@
 #include <utility>
 
 #include "ApvlvFile.h"
+#include "ApvlvTrace.h"
 #include "ApvlvUtil.h"
 #include "ApvlvWebViewWidget.h"
+#ifdef APVLV_WITH_OCR
+#include "ApvlvOCR.h"
+#endif
 
 namespace apvlv
 {
@@ -131,8 +135,8 @@ FileFactory::findMatchClass (const std::string &filename)
   if (cls_list.size () == 1)
     return cls_list[0];
 
-  auto cls_name
-      = ApvlvParams::instance ()->getGroupStringOrDefault (ext, "engine", "");
+  // the search workers open files too
+  auto cls_name = ApvlvParams::instance ()->snapshot ()->engine (ext);
   if (cls_name.empty ())
     return cls_list[0];
 
@@ -148,6 +152,7 @@ FileFactory::findMatchClass (const std::string &filename)
 unique_ptr<File>
 FileFactory::loadFile (const string &filename)
 {
+  APVLV_TRACE ("loadFile");
   auto cls = findMatchClass (filename);
   if (!cls.has_value ())
     {
@@ -174,9 +179,11 @@ File::~File ()
 
 unique_ptr<SearchFileMatch>
 File::grepFile (const string &seq, bool is_case, bool is_regex,
-                atomic<bool> &is_abort)
+                atomic<bool> &is_abort, SearchCorpus *corpus)
 {
+  APVLV_TRACE ("grepFile");
   vector<SearchPageMatch> page_matches;
+  size_t file_terms = 0;
   auto pageSum = sum ();
   for (auto pn = 0; pn < pageSum; ++pn)
     {
@@ -189,8 +196,29 @@ File::grepFile (const string &seq, bool is_case, bool is_regex,
 
       auto size = pageSizeF (pn, 0);
       string content;
-      if (pageText (pn, { 0, 0, size.width, size.height }, content) == false)
-        continue;
+      if (pageText (pn, { 0, 0, size.width, size.height }, content) == false
+          || content.empty ())
+        {
+#ifdef APVLV_WITH_OCR
+          // image-only pages are searched in the OCR text layer
+          auto layer = OCRTextLayer::instance ()->pageText (mFilename, pn);
+          if (!layer && getDisplayType () == DISPLAY_TYPE::IMAGE)
+            OCRPipeline::instance ()->submit (mFilename);
+          if (!layer || layer->empty ())
+            continue;
+          content = std::move (*layer);
+#else
+          continue;
+#endif
+        }
+
+      auto terms = countTerms (content);
+      file_terms += terms;
+      if (corpus)
+        {
+          corpus->pages++;
+          corpus->terms += terms;
+        }
 
       istringstream iss{ content };
       string line;
@@ -214,16 +242,20 @@ File::grepFile (const string &seq, bool is_case, bool is_regex,
         }
       if (!matches.empty ())
         {
-          page_matches.push_back ({ pn, matches });
+          page_matches.push_back ({ pn, matches, terms });
         }
     }
 
+  if (corpus)
+    corpus->files++;
+
   if (page_matches.empty ())
     return nullptr;
 
   auto file_match = make_unique<SearchFileMatch> ();
   file_match->filename = getFilename ();
   file_match->page_matches = std::move (page_matches);
+  file_match->terms = file_terms;
   return file_match;
 }
 
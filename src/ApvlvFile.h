@@ -61,6 +61,12 @@ struct ApvlvCover
   std::string mime_type;
 };
 
+struct ApvlvMetadata
+{
+  std::string title;
+  std::string author;
+};
+
 using ApvlvLinks = std::vector<ApvlvLink>;
 
 struct ApvlvPoint
@@ -136,9 +142,6 @@ public:
     if (load (filename))
       {
         mFilename = filename;
-
-        mNote.load ();
-
         return true;
       }
 
@@ -151,6 +154,12 @@ public:
     return mCover;
   }
 
+  const ApvlvMetadata &
+  getMetadata ()
+  {
+    return mMetadata;
+  }
+
   Note *
   getNote ()
   {
@@ -165,7 +174,7 @@ public:
 
   virtual std::unique_ptr<SearchFileMatch>
   grepFile (const std::string &seq, bool is_case, bool is_regex,
-            std::atomic<bool> &is_abort);
+            std::atomic<bool> &is_abort, SearchCorpus *corpus = nullptr);
 
   virtual int
   sum ()
@@ -190,7 +199,7 @@ public:
   virtual int
   pageNumberWrap (int page)
   {
-    auto scrdoc = ApvlvParams::instance ()->getBoolOrDefault ("autoscrolldoc");
+    auto scrdoc = ApvlvParams::instance ()->get (BoolParam::AUTOSCROLLDOC);
     int c = sum ();
 
     if (page >= 0 && page < c)
@@ -265,6 +274,7 @@ protected:
   std::map<std::string, int> srcPages;
   std::map<std::string, std::string> srcMimeTypes;
   ApvlvCover mCover;
+  ApvlvMetadata mMetadata;
   Note mNote;
 
 private:
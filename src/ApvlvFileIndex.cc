@@ -27,11 +27,14 @@
 #include <QBuffer>
 #include <QDebug>
 #include <algorithm>
+#include <cstring>
 #include <filesystem>
 #include <iostream>
 #include <stack>
+#ifndef WIN32
+#include <sys/stat.h>
+#endif
 
-#include "ApvlvFile.h"
 #include "ApvlvFileIndex.h"
 #include "ApvlvUtil.h"
 
@@ -40,52 +43,6 @@ namespace apvlv
 
 using namespace std;
 
-void
-FileIndex::loadDirectory (const string &path1)
-{
-  auto exts = FileFactory::supportFileExts ();
-
-  try
-    {
-      for (auto &entry : filesystem::directory_iterator (
-               path1, filesystem::directory_options::follow_directory_symlink))
-        {
-          if (entry.is_directory ())
-            {
-              auto index
-                  = FileIndex (entry.path ().filename ().string (), 0,
-                               entry.path ().string (), FileIndexType::DIR);
-              index.loadDirectory (entry.path ().string ());
-              auto last = entry.last_write_time ();
-              index.mtime = filesystemTimeToMSeconds (last);
-              if (!index.mChildrenIndex.empty ())
-                {
-                  mChildrenIndex.emplace_back (index);
-                }
-            }
-          else if (entry.file_size () > 0)
-            {
-              auto file_ext = filenameExtension (entry.path ().string ());
-              if (find (exts.cbegin (), exts.cend (), file_ext)
-                  != exts.cend ())
-                {
-                  auto index = FileIndex (entry.path ().filename ().string (),
-                                          0, entry.path ().string (),
-                                          FileIndexType::FILE);
-                  index.size = static_cast<int64_t> (entry.file_size ());
-                  auto last = entry.last_write_time ();
-                  index.mtime = filesystemTimeToMSeconds (last);
-                  mChildrenIndex.emplace_back (index);
-                }
-            }
-        }
-    }
-  catch (filesystem::filesystem_error &err)
-    {
-      qWarning () << "file system error: " << err.what ();
-    }
-}
-
 void
 FileIndex::moveChildChildren (const FileIndex &other_index)
 {
@@ -110,6 +67,672 @@ FileIndex::FileIndex (const string &title, int page, const string &path,
 }
 
 FileIndex::~FileIndex () = default;
+
+// the path of the node is the parent path and the title
+const uint32_t DERIVED_PATH = 0xffffffff;
+
+// interned strings are packed in blocks of this size
+const size_t STRING_BLOCK_SIZE = 64 * 1024;
+
+// the header of a saved tree, followed by the nodes, the child ids, the
+// string offsets and the string bytes
+const char TREE_IMAGE_MAGIC[] = "apvlvFIT";
+struct TreeImageHeader
+{
+  char magic[8];
+  uint64_t node_size;
+  uint64_t nodes;
+  uint64_t children;
+  uint64_t strings;
+  uint64_t string_bytes;
+};
+
+void
+FileIndexTree::assign (const FileIndex &index)
+{
+  clear ();
+  appendTree (INVALID_ID, index, "");
+}
+
+void
+FileIndexTree::clear ()
+{
+  mNodes.clear ();
+  mChildren.clear ();
+  mStrings.clear ();
+  mStringIds.clear ();
+  mStringBlocks.clear ();
+  mStringBlockUsed = 0;
+  mModified.clear ();
+  mRevision++;
+  mRemoved = 0;
+}
+
+string
+FileIndexTree::path (Id id) const
+{
+  auto const &n = mNodes[id];
+  if (n.path != DERIVED_PATH)
+    return string (mStrings[n.path]);
+
+  auto path = this->path (n.parent);
+  path += PATH_SEP_S;
+  path += mStrings[n.title];
+  return path;
+}
+
+bool
+FileIndexTree::isRemoved (Id id) const
+{
+  for (; id != 0; id = mNodes[id].parent)
+    {
+      if (mNodes[id].parent == INVALID_ID)
+        return true;
+    }
+  return false;
+}
+
+FileIndexTree::Id
+FileIndexTree::append (Id parent, const FileIndex &index)
+{
+  auto parent_path = parent == INVALID_ID ? string () : path (parent);
+  return appendTree (parent, index, parent_path);
+}
+
+FileIndexTree::Id
+FileIndexTree::append (Id parent, FileIndexType type, string_view title,
+                       int64_t size, int64_t mtime)
+{
+  auto id = newNode (parent, type, title);
+  auto &n = mNodes[id];
+  n.path = DERIVED_PATH;
+  n.size = size;
+  n.mtime = mtime;
+  return id;
+}
+
+void
+FileIndexTree::reserveChildren (Id parent, size_t count)
+{
+  auto &n = mNodes[parent];
+  if (n.capacity - n.count >= count)
+    return;
+
+  if (n.first + n.capacity == mChildren.size ())
+    {
+      // the range is the last one, grow it in place
+      mChildren.resize (n.first + n.count + count);
+      n.capacity = static_cast<uint32_t> (n.count + count);
+      return;
+    }
+
+  // move the range to the end of the child array
+  auto first = static_cast<uint32_t> (mChildren.size ());
+  auto capacity = static_cast<uint32_t> (n.count + count);
+  mChildren.resize (mChildren.size () + capacity);
+  std::copy_n (mChildren.begin () + n.first, n.count,
+               mChildren.begin () + first);
+  n.first = first;
+  n.capacity = capacity;
+}
+
+void
+FileIndexTree::remove (Id id)
+{
+  auto &n = mNodes[id];
+  if (n.parent == INVALID_ID)
+    return;
+
+  auto &p = mNodes[n.parent];
+  auto begin = mChildren.begin () + p.first;
+  std::copy (begin + n.row + 1, begin + p.count, begin + n.row);
+  p.count--;
+  for (auto row = n.row; row < p.count; ++row)
+    mNodes[mChildren[p.first + row]].row = row;
+
+  n.parent = INVALID_ID;
+  mRemoved++;
+  logModified (id);
+}
+
+void
+FileIndexTree::setFile (Id id, int64_t size, int64_t mtime)
+{
+  mNodes[id].size = size;
+  mNodes[id].mtime = mtime;
+  logModified (id);
+}
+
+void
+FileIndexTree::logModified (Id id)
+{
+  // following a log longer than the tree costs more than a rebuild
+  if (mModified.size () >= mNodes.size ())
+    {
+      mModified.clear ();
+      mRevision++;
+    }
+  mModified.push_back (id);
+}
+
+void
+FileIndexTree::setPath (Id id, const string &path)
+{
+  auto filename = filesystem::path (path).filename ().string ();
+  mNodes[id].title = intern (filename);
+  mNodes[id].path = intern (path);
+  mRevision++;
+}
+
+FileIndex
+FileIndexTree::toFileIndex (Id id, bool recursive) const
+{
+  auto const &n = mNodes[id];
+  FileIndex index (string{ mStrings[n.title] }, n.page, path (id), n.type);
+  index.anchor = mStrings[n.anchor];
+  index.size = n.size;
+  index.mtime = n.mtime;
+  if (recursive)
+    {
+      for (auto child : children (id))
+        index.mChildrenIndex.emplace_back (toFileIndex (child, true));
+    }
+  return index;
+}
+
+bool
+FileIndexTree::hasFiles (Id id) const
+{
+  return std::ranges::any_of (children (id), [this] (auto child) {
+    return mNodes[child].type == FileIndexType::FILE || hasFiles (child);
+  });
+}
+
+FileIndex
+FileIndexTree::visibleCopy (Id id) const
+{
+  auto copy = toFileIndex (id, false);
+  for (auto child : children (id))
+    {
+      if (mNodes[child].type == FileIndexType::FILE)
+        copy.mChildrenIndex.emplace_back (toFileIndex (child, false));
+      else if (hasFiles (child))
+        copy.mChildrenIndex.emplace_back (visibleCopy (child));
+    }
+  return copy;
+}
+
+void
+FileIndexTree::compact ()
+{
+  if (mRemoved > 0 && !mNodes.empty ())
+    assign (toFileIndex (root (), true));
+}
+
+bool
+FileIndexTree::save (ostream &os) const
+{
+  uint64_t bytes = 0;
+  vector<uint64_t> offsets{ 0 };
+  offsets.reserve (mStrings.size () + 1);
+  for (auto const &str : mStrings)
+    {
+      bytes += str.size ();
+      offsets.push_back (bytes);
+    }
+
+  TreeImageHeader header{};
+  std::copy_n (TREE_IMAGE_MAGIC, sizeof (header.magic), header.magic);
+  header.node_size = sizeof (Node);
+  header.nodes = mNodes.size ();
+  header.children = mChildren.size ();
+  header.strings = mStrings.size ();
+  header.string_bytes = bytes;
+
+  os.write (reinterpret_cast<const char *> (&header), sizeof (header));
+  os.write (reinterpret_cast<const char *> (mNodes.data ()),
+            static_cast<streamsize> (mNodes.size () * sizeof (Node)));
+  os.write (reinterpret_cast<const char *> (mChildren.data ()),
+            static_cast<streamsize> (mChildren.size () * sizeof (Id)));
+  os.write (reinterpret_cast<const char *> (offsets.data ()),
+            static_cast<streamsize> (offsets.size () * sizeof (uint64_t)));
+  for (auto const &str : mStrings)
+    os.write (str.data (), static_cast<streamsize> (str.size ()));
+  return os.good ();
+}
+
+bool
+FileIndexTree::load (const char *data, size_t size)
+{
+  TreeImageHeader header;
+  if (size < sizeof (header))
+    return false;
+
+  memcpy (&header, data, sizeof (header));
+  if (memcmp (header.magic, TREE_IMAGE_MAGIC, sizeof (header.magic)) != 0
+      || header.node_size != sizeof (Node) || header.nodes == 0)
+    return false;
+
+  // the counts are checked before they are multiplied, so a corrupt image
+  // can't wrap the sizes below
+  auto bytes = static_cast<uint64_t> (size);
+  if (header.nodes > bytes / sizeof (Node)
+      || header.children > bytes / sizeof (Id)
+      || header.strings >= bytes / sizeof (uint64_t)
+      || header.string_bytes > bytes)
+    return false;
+
+  auto node_bytes = header.nodes * sizeof (Node);
+  auto child_bytes = header.children * sizeof (Id);
+  auto offset_bytes = (header.strings + 1) * sizeof (uint64_t);
+  if (size != sizeof (header) + node_bytes + child_bytes + offset_bytes
+                  + header.string_bytes)
+    return false;
+
+  clear ();
+  auto pos = data + sizeof (header);
+  mNodes.resize (header.nodes);
+  memcpy (mNodes.data (), pos, node_bytes);
+  pos += node_bytes;
+  mChildren.resize (header.children);
+  memcpy (mChildren.data (), pos, child_bytes);
+  pos += child_bytes;
+  vector<uint64_t> offsets (header.strings + 1);
+  memcpy (offsets.data (), pos, offset_bytes);
+  pos += offset_bytes;
+
+  // the strings are one full block, they are hashed when interning again
+  mStringBlocks.emplace_back (make_unique<char[]> (header.string_bytes));
+  memcpy (mStringBlocks.back ().get (), pos, header.string_bytes);
+  mStringBlockUsed = STRING_BLOCK_SIZE + header.string_bytes;
+  auto block = mStringBlocks.back ().get ();
+  mStrings.reserve (header.strings);
+  for (size_t i = 0; i < header.strings; ++i)
+    {
+      if (offsets[i] > offsets[i + 1] || offsets[i + 1] > header.string_bytes)
+        {
+          clear ();
+          return false;
+        }
+      mStrings.emplace_back (block + offsets[i], offsets[i + 1] - offsets[i]);
+    }
+
+  // check the references, a broken image must not crash the reader
+  auto broken = [this] {
+    clear ();
+    return false;
+  };
+  for (auto id : mChildren)
+    {
+      if (id >= mNodes.size ())
+        return broken ();
+    }
+
+  // the root has its path, a parent comes before its children, so the
+  // parents never make a cycle and every derived path ends at the root
+  auto const &root = mNodes[0];
+  if (root.parent != INVALID_ID || root.path == DERIVED_PATH)
+    return broken ();
+  for (Id id = 0; id < mNodes.size (); ++id)
+    {
+      auto const &n = mNodes[id];
+      if (static_cast<int> (n.type) < static_cast<int> (FileIndexType::PAGE)
+          || static_cast<int> (n.type) > static_cast<int> (FileIndexType::DIR)
+          || n.title >= mStrings.size ()
+          || (n.path != DERIVED_PATH && n.path >= mStrings.size ())
+          || n.anchor >= mStrings.size ()
+          || n.first + static_cast<uint64_t> (n.capacity) > mChildren.size ()
+          || n.count > n.capacity)
+        return broken ();
+
+      // a removed node has no parent, it keeps its id
+      if (id != 0 && n.parent != INVALID_ID
+          && (n.parent >= id || n.row >= mNodes[n.parent].count
+              || mChildren[mNodes[n.parent].first + n.row] != id))
+        return broken ();
+
+      for (uint32_t row = 0; row < n.count; ++row)
+        {
+          auto const &child = mNodes[mChildren[n.first + row]];
+          if (child.parent != id || child.row != row)
+            return broken ();
+        }
+    }
+
+  return true;
+}
+
+uint32_t
+FileIndexTree::intern (string_view str)
+{
+  if (mStringIds.size () < mStrings.size ())
+    {
+      for (uint32_t id = 0; id < mStrings.size (); ++id)
+        mStringIds.emplace (mStrings[id], id);
+    }
+
+  if (auto itr = mStringIds.find (str); itr != mStringIds.end ())
+    return itr->second;
+
+  if (mStringBlocks.empty ()
+      || mStringBlockUsed + str.size () > STRING_BLOCK_SIZE)
+    {
+      mStringBlocks.emplace_back (
+          make_unique<char[]> (std::max (str.size (), STRING_BLOCK_SIZE)));
+      mStringBlockUsed = 0;
+    }
+
+  auto data = mStringBlocks.back ().get () + mStringBlockUsed;
+  std::copy (str.begin (), str.end (), data);
+  mStringBlockUsed += str.size ();
+
+  auto id = static_cast<uint32_t> (mStrings.size ());
+  string_view view (data, str.size ());
+  mStrings.push_back (view);
+  mStringIds.emplace (view, id);
+  return id;
+}
+
+FileIndexTree::Id
+FileIndexTree::newNode (Id parent, FileIndexType type, string_view title)
+{
+  if (mStrings.empty ())
+    intern ("");
+
+  auto id = static_cast<Id> (mNodes.size ());
+  mNodes.push_back ({ type, 0, intern (title), 0, 0, parent, 0,
+                      static_cast<uint32_t> (mChildren.size ()), 0, 0, 0,
+                      0 });
+  if (parent != INVALID_ID)
+    appendChild (parent, id);
+  return id;
+}
+
+void
+FileIndexTree::appendChild (Id parent, Id child)
+{
+  auto &p = mNodes[parent];
+  if (p.count == p.capacity)
+    reserveChildren (parent, std::max<size_t> (p.count, 4));
+  mChildren[p.first + p.count] = child;
+
+  mNodes[child].row = p.count;
+  p.count++;
+}
+
+FileIndexTree::Id
+FileIndexTree::appendTree (Id parent, const FileIndex &index,
+                           const string &parent_path)
+{
+  auto id = newNode (parent, index.type, index.title);
+  auto &n = mNodes[id];
+  n.page = index.page;
+  n.anchor = intern (index.anchor);
+  n.size = index.size;
+  n.mtime = index.mtime;
+
+  auto derived = parent != INVALID_ID && index.type != FileIndexType::PAGE
+                 && index.path.size () == parent_path.size () + 1
+                                              + index.title.size ()
+                 && index.path.starts_with (parent_path)
+                 && index.path[parent_path.size ()] == PATH_SEP_C
+                 && index.path.ends_with (index.title);
+  n.path = derived ? DERIVED_PATH : intern (index.path);
+
+  if (!index.mChildrenIndex.empty ())
+    {
+      reserveChildren (id, index.mChildrenIndex.size ());
+      for (auto const &child : index.mChildrenIndex)
+        appendTree (id, child, index.path);
+    }
+
+  return id;
+}
+
+const auto DIRECTORY_OPTIONS
+    = filesystem::directory_options::follow_directory_symlink
+      | filesystem::directory_options::skip_permission_denied;
+
+// smaller levels are listed by the calling thread alone
+const size_t PARALLEL_LIST_MIN = 8;
+
+// no supported extension is longer
+const size_t EXTENSION_MAX = 16;
+
+DirectoryScanner::DirectoryScanner (vector<string> exts, unsigned int threads)
+    : mExtensions (std::move (exts))
+{
+  std::ranges::sort (mExtensions);
+  for (auto i = 1u; i < threads; ++i)
+    {
+      mWorkers.emplace_back (&DirectoryScanner::workerLoop, this);
+    }
+}
+
+DirectoryScanner::~DirectoryScanner ()
+{
+  {
+    lock_guard<mutex> lock (mMutex);
+    mQuit = true;
+  }
+  mCondition.notify_all ();
+  std::ranges::for_each (mWorkers, [] (thread &worker) { worker.join (); });
+}
+
+bool
+DirectoryScanner::isSupported (string_view filename) const
+{
+  auto pointp = filename.rfind ('.');
+  if (pointp == string_view::npos || filename.size () - pointp > EXTENSION_MAX)
+    return false;
+
+  char ext[EXTENSION_MAX];
+  auto length = filename.size () - pointp;
+  for (size_t i = 0; i < length; ++i)
+    {
+      ext[i] = static_cast<char> (
+          ::tolower (static_cast<unsigned char> (filename[pointp + i])));
+    }
+  return std::ranges::binary_search (mExtensions, string_view (ext, length));
+}
+
+bool
+DirectoryScanner::list (const string &path, vector<Entry> &entries) const
+{
+  error_code code;
+  auto itr = filesystem::directory_iterator (path, DIRECTORY_OPTIONS, code);
+  for (; !code && itr != filesystem::directory_iterator ();
+       itr.increment (code))
+    {
+      // the type of an entry mostly comes with the listing, the other
+      // files are skipped without a stat call
+      auto name = itr->path ().filename ().string ();
+      auto supported = isSupported (name);
+      error_code ec;
+      if (!supported && !itr->is_directory (ec))
+        continue;
+
+      Entry entry;
+      if (!status (itr->path (), entry))
+        continue;
+      if (entry.type == FileIndexType::FILE
+          && (!supported || entry.size == 0))
+        continue;
+
+      entry.name = std::move (name);
+      entries.emplace_back (std::move (entry));
+    }
+
+  return !code;
+}
+
+bool
+DirectoryScanner::scan (FileIndexTree &tree, vector<Id> dirs,
+                        const function<bool (Id)> &visit)
+{
+  vector<string> paths;
+  vector<vector<Entry>> entries;
+  while (!dirs.empty ())
+    {
+      paths.clear ();
+      for (auto dir : dirs)
+        {
+          if (!visit (dir))
+            return false;
+          paths.emplace_back (tree.path (dir));
+        }
+
+      listAll (paths, entries);
+
+      vector<Id> next;
+      for (size_t i = 0; i < dirs.size (); ++i)
+        {
+          tree.reserveChildren (dirs[i], entries[i].size ());
+          for (auto const &entry : entries[i])
+            {
+              auto child = tree.append (dirs[i], entry.type, entry.name,
+                                        entry.size, entry.mtime);
+              if (entry.type == FileIndexType::DIR)
+                next.push_back (child);
+            }
+        }
+      dirs = std::move (next);
+    }
+
+  return true;
+}
+
+bool
+DirectoryScanner::status (const filesystem::path &path, Entry &entry)
+{
+#ifndef WIN32
+  // one call for all of them, std::filesystem makes one for each
+  struct stat st;
+  if (::stat (path.c_str (), &st) != 0)
+    return false;
+
+  if (S_ISDIR (st.st_mode))
+    entry.type = FileIndexType::DIR;
+  else if (S_ISREG (st.st_mode))
+    entry.type = FileIndexType::FILE;
+  else
+    return false;
+
+  entry.size = entry.type == FileIndexType::FILE ? st.st_size : 0;
+  entry.mtime = st.st_mtime;
+  return true;
+#else
+  error_code code;
+  auto stat = filesystem::status (path, code);
+  if (code)
+    return false;
+
+  if (filesystem::is_directory (stat))
+    {
+      entry.type = FileIndexType::DIR;
+      entry.size = 0;
+    }
+  else if (filesystem::is_regular_file (stat))
+    {
+      entry.type = FileIndexType::FILE;
+      entry.size = static_cast<int64_t> (filesystem::file_size (path, code));
+      if (code)
+        return false;
+    }
+  else
+    {
+      return false;
+    }
+
+  entry.mtime = 0;
+  auto last = filesystem::last_write_time (path, code);
+  if (!code)
+    entry.mtime = filesystemTimeToMSeconds (last);
+  return true;
+#endif
+}
+
+void
+DirectoryScanner::listAll (const vector<string> &paths,
+                           vector<vector<Entry>> &entries)
+{
+  entries.assign (paths.size (), {});
+  if (mWorkers.empty () || paths.size () < PARALLEL_LIST_MIN)
+    {
+      for (size_t i = 0; i < paths.size (); ++i)
+        list (paths[i], entries[i]);
+      return;
+    }
+
+  {
+    lock_guard<mutex> lock (mMutex);
+    mPaths = &paths;
+    mEntries = &entries;
+    mNext = 0;
+    mActive = 0;
+    ++mBatch;
+  }
+  mCondition.notify_all ();
+
+  listBatch ();
+
+  unique_lock<mutex> lock (mMutex);
+  mFinished.wait (lock, [this] () {
+    return mNext >= mPaths->size () && mActive == 0;
+  });
+  mPaths = nullptr;
+  mEntries = nullptr;
+}
+
+void
+DirectoryScanner::listBatch ()
+{
+  while (true)
+    {
+      size_t index;
+      const vector<string> *paths;
+      vector<vector<Entry>> *entries;
+      {
+        lock_guard<mutex> lock (mMutex);
+        if (mPaths == nullptr || mNext >= mPaths->size ())
+          return;
+        index = mNext++;
+        ++mActive;
+        paths = mPaths;
+        entries = mEntries;
+      }
+
+      list ((*paths)[index], (*entries)[index]);
+
+      bool finished;
+      {
+        lock_guard<mutex> lock (mMutex);
+        --mActive;
+        finished = mNext >= mPaths->size () && mActive == 0;
+      }
+      if (finished)
+        mFinished.notify_one ();
+    }
+}
+
+void
+DirectoryScanner::workerLoop ()
+{
+  unsigned int batch = 0;
+  unique_lock<mutex> lock (mMutex);
+  while (true)
+    {
+      mCondition.wait (lock, [&] () { return mQuit || mBatch != batch; });
+      if (mQuit)
+        break;
+
+      batch = mBatch;
+      lock.unlock ();
+      listBatch ();
+      lock.lock ();
+    }
+}
+
 }
 
 // Local Variables:
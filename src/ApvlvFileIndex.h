@@ -28,8 +28,20 @@
 #define _APVLV_FILE_INDEX_H_
 
 #include <QImage>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
 #include <list>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <span>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 #include "ApvlvSearch.h"
 
@@ -58,7 +70,6 @@ public:
            && a.anchor == b.anchor;
   }
 
-  void loadDirectory (const std::string &path1);
   void moveChildChildren (const FileIndex &other_index);
   void removeChild (const FileIndex &child);
 
@@ -75,6 +86,230 @@ public:
   std::int64_t mtime{ 0 };
 };
 
+//
+// a compact tree of file indexes
+//
+// All nodes live in one array and are addressed by their id, the children
+// of a node are a range of one child array, and the strings are interned.
+// The paths of files and directories are not stored, they are built from
+// the parent path and the title. Removed nodes keep their ids until the
+// tree is assigned again.
+//
+class FileIndexTree
+{
+public:
+  using Id = std::uint32_t;
+  static constexpr Id INVALID_ID = 0xffffffff;
+
+  struct Node
+  {
+    FileIndexType type;
+    std::int32_t page;
+    std::uint32_t title;
+    std::uint32_t path;
+    std::uint32_t anchor;
+    Id parent;
+    std::uint32_t row;
+    std::uint32_t first;
+    std::uint32_t count;
+    std::uint32_t capacity;
+    std::int64_t size;
+    std::int64_t mtime;
+  };
+
+  FileIndexTree () = default;
+  explicit FileIndexTree (const FileIndex &index) { assign (index); }
+
+  void assign (const FileIndex &index);
+  void clear ();
+
+  [[nodiscard]] bool
+  empty () const
+  {
+    return mNodes.empty ();
+  }
+
+  [[nodiscard]] Id
+  root () const
+  {
+    return 0;
+  }
+
+  // the count of the nodes, removed ones included
+  [[nodiscard]] size_t
+  capacity () const
+  {
+    return mNodes.size ();
+  }
+
+  // changed when the tree is assigned, a node is renamed or the log of
+  // modified () is dropped, appending, removing and setting the files do
+  // not change it
+  [[nodiscard]] std::uint32_t
+  revision () const
+  {
+    return mRevision;
+  }
+
+  // the nodes given to setFile or removed, in order, since the revision
+  // changed, the log is dropped when it grows past the count of nodes
+  [[nodiscard]] const std::vector<Id> &
+  modified () const
+  {
+    return mModified;
+  }
+
+  [[nodiscard]] const Node &
+  node (Id id) const
+  {
+    return mNodes[id];
+  }
+
+  [[nodiscard]] std::string_view
+  title (Id id) const
+  {
+    return mStrings[mNodes[id].title];
+  }
+
+  [[nodiscard]] std::string_view
+  anchor (Id id) const
+  {
+    return mStrings[mNodes[id].anchor];
+  }
+
+  [[nodiscard]] std::string path (Id id) const;
+
+  [[nodiscard]] std::span<const Id>
+  children (Id id) const
+  {
+    auto const &n = mNodes[id];
+    return { mChildren.data () + n.first, n.count };
+  }
+
+  [[nodiscard]] Id
+  child (Id id, size_t row) const
+  {
+    return mChildren[mNodes[id].first + row];
+  }
+
+  [[nodiscard]] bool isRemoved (Id id) const;
+
+  // append a node with its subtree
+  Id append (Id parent, const FileIndex &index);
+
+  // append a file or directory node, its path is parent path and title
+  Id append (Id parent, FileIndexType type, std::string_view title,
+             std::int64_t size, std::int64_t mtime);
+
+  void reserveChildren (Id parent, size_t count);
+  void remove (Id id);
+
+  void setFile (Id id, std::int64_t size, std::int64_t mtime);
+  void setPath (Id id, const std::string &path);
+
+  [[nodiscard]] FileIndex toFileIndex (Id id, bool recursive) const;
+
+  // a directory is visible when it has a file in its subtree
+  [[nodiscard]] bool hasFiles (Id id) const;
+  [[nodiscard]] FileIndex visibleCopy (Id id) const;
+
+  // drop the removed nodes, the ids change
+  void compact ();
+
+  // a binary image of the tree, load copies it back from the bytes
+  bool save (std::ostream &os) const;
+  bool load (const char *data, size_t size);
+
+private:
+  std::uint32_t intern (std::string_view str);
+  Id newNode (Id parent, FileIndexType type, std::string_view title);
+  void appendChild (Id parent, Id child);
+  Id appendTree (Id parent, const FileIndex &index,
+                 const std::string &parent_path);
+  void logModified (Id id);
+
+  std::vector<Node> mNodes;
+  std::vector<Id> mChildren;
+
+  std::vector<std::string_view> mStrings;
+  std::unordered_map<std::string_view, std::uint32_t> mStringIds;
+  std::vector<std::unique_ptr<char[]>> mStringBlocks;
+  size_t mStringBlockUsed{ 0 };
+
+  std::uint32_t mRevision{ 0 };
+  std::vector<Id> mModified;
+  size_t mRemoved{ 0 };
+};
+
+//
+// lists directories into a FileIndexTree
+//
+// A scan goes level by level, the directories of one level are listed by
+// a pool of threads and appended by the calling thread, so the entries of
+// a directory are one range of the tree. Only the directories and the
+// supported files are stat'ed, once.
+//
+class DirectoryScanner
+{
+public:
+  struct Entry
+  {
+    std::string name;
+    FileIndexType type;
+    std::int64_t size;
+    std::int64_t mtime;
+  };
+
+  using Id = FileIndexTree::Id;
+
+  // threads is the count of the listing threads, the caller is one
+  DirectoryScanner (std::vector<std::string> exts, unsigned int threads);
+  ~DirectoryScanner ();
+
+  DirectoryScanner (const DirectoryScanner &) = delete;
+  DirectoryScanner &operator= (const DirectoryScanner &) = delete;
+
+  [[nodiscard]] const std::vector<std::string> &
+  extensions () const
+  {
+    return mExtensions;
+  }
+
+  [[nodiscard]] bool isSupported (std::string_view filename) const;
+
+  // list the directories and the supported files of a directory
+  bool list (const std::string &path, std::vector<Entry> &entries) const;
+
+  // scan the subtrees of the empty directories, visit is called for every
+  // directory before it is listed and stops the scan by returning false
+  bool scan (FileIndexTree &tree, std::vector<Id> dirs,
+             const std::function<bool (Id)> &visit);
+
+  // the type, size and mtime of a path, mtime is in seconds
+  static bool status (const std::filesystem::path &path, Entry &entry);
+
+private:
+  void listAll (const std::vector<std::string> &paths,
+                std::vector<std::vector<Entry>> &entries);
+  void listBatch ();
+  void workerLoop ();
+
+  std::vector<std::string> mExtensions;
+
+  std::vector<std::thread> mWorkers;
+  std::mutex mMutex;
+  std::condition_variable mCondition;
+  std::condition_variable mFinished;
+  bool mQuit{ false };
+
+  // the batch being listed, guarded by mMutex
+  unsigned int mBatch{ 0 };
+  const std::vector<std::string> *mPaths{ nullptr };
+  std::vector<std::vector<Entry>> *mEntries{ nullptr };
+  size_t mNext{ 0 };
+  size_t mActive{ 0 };
+};
+
 }
 
 #endif
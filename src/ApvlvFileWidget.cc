@@ -90,11 +90,11 @@ FileWidget::scrollUp (int times)
   else
     {
       auto params = ApvlvParams::instance ();
-      if (params->getBoolOrDefault ("autoscrollpage"))
+      if (params->get (BoolParam::AUTOSCROLLPAGE))
         {
           if (mPageNumber == 0)
             {
-              if (params->getBoolOrDefault ("autoscrolldoc"))
+              if (params->get (BoolParam::AUTOSCROLLDOC))
                 {
                   showPage (mFile->sum () - 1, 1.0);
                 }
@@ -125,11 +125,11 @@ FileWidget::scrollDown (int times)
   else
     {
       auto params = ApvlvParams::instance ();
-      if (params->getBoolOrDefault ("autoscrollpage"))
+      if (params->get (BoolParam::AUTOSCROLLPAGE))
         {
           if (mPageNumber == mFile->sum () - 1)
             {
-              if (params->getBoolOrDefault ("autoscrolldoc"))
+              if (params->get (BoolParam::AUTOSCROLLDOC))
                 {
                   showPage (0, 0.0);
                 }
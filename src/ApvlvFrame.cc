@@ -73,8 +73,8 @@ ApvlvFrame::ApvlvFrame (ApvlvView *view) : mToolStatus (this)
   mPaned.setHandleWidth (4);
   mDirectoryWidth = DEFAULT_CONTENT_WIDTH;
 
-  auto f_width = ApvlvParams::instance ()->getIntOrDefault ("fix_width");
-  auto f_height = ApvlvParams::instance ()->getIntOrDefault ("fix_height");
+  auto f_width = ApvlvParams::instance ()->get (IntParam::FIX_WIDTH);
+  auto f_height = ApvlvParams::instance ()->get (IntParam::FIX_HEIGHT);
 
   if (f_width > 0 && f_height > 0)
     {
@@ -99,7 +99,11 @@ ApvlvFrame::ApvlvFrame (ApvlvView *view) : mToolStatus (this)
   mPaned.addWidget (&mTextFrame);
   mTextFrame.setLayout (&mTextLayout);
   mTextLayout.addWidget (&mToolStatus, 0);
-  auto guiopt = ApvlvParams::instance ()->getStringOrDefault ("guioptions");
+  mTextLayout.addWidget (&mThumbnails, 0);
+  mThumbnails.hide ();
+  QObject::connect (&mThumbnails, SIGNAL (pageActivated (int)), this,
+                    SLOT (thumbnailShowPage (int)));
+  auto guiopt = ApvlvParams::instance ()->get (StringParam::GUIOPTIONS);
   if (guiopt.find ('S') == string::npos)
     {
       mToolStatus.hide ();
@@ -187,7 +191,6 @@ ApvlvFrame::toggleDirectory (bool show)
   auto sizes = mPaned.sizes ();
   if (show)
     {
-      mDirIndex = {};
       if (sizes[0] == 0)
         {
           auto psize = mPaned.size ();
@@ -236,9 +239,7 @@ ApvlvFrame::setActive (bool act)
 void
 ApvlvFrame::setDirIndex (const string &path)
 {
-  mDirIndex = { "", 0, path, FileIndexType::DIR };
-  mDirIndex.loadDirectory (path);
-  emit indexGenerited (mDirIndex);
+  mDirectory.loadDirectory (path);
   toggleDirectory (true);
 }
 
@@ -280,6 +281,35 @@ ApvlvFrame::isControlledDirectory ()
   return mDirectory.isActive ();
 }
 
+void
+ApvlvFrame::toggleThumbnails ()
+{
+  if (mThumbnails.isVisible ())
+    {
+      mThumbnails.hide ();
+      return;
+    }
+
+  if (mFile == nullptr || mFile->getDisplayType () != DISPLAY_TYPE::IMAGE)
+    {
+      qWarning () << "file " << mFilestr << " has no thumbnails";
+      return;
+    }
+
+  mThumbnails.show ();
+  mThumbnails.setCurrentPage (pageNumber ());
+}
+
+void
+ApvlvFrame::thumbnailShowPage (int pn)
+{
+  if (pn != pageNumber ())
+    {
+      markposition ('\'');
+      showPage (pn, 0.0);
+    }
+}
+
 ApvlvFrame *
 ApvlvFrame::findByWidget (QWidget *widget)
 {
@@ -541,13 +571,14 @@ ApvlvFrame::ocrCopy ()
     return;
 
   auto image = dynamic_cast<ApvlvImage *> (mWidget->widget ());
-  auto text = image->ocrGetText ();
+  image->ocrText ([this] (const string &text) {
 #ifdef QT_DEBUG
-  QMessageBox::information (this, tr ("text in clipboard"),
-                            QString::fromLocal8Bit (text.get ()));
+    QMessageBox::information (this, tr ("text in clipboard"),
+                              QString::fromUtf8 (text));
 #endif
-  auto clipboard = QGuiApplication::clipboard ();
-  clipboard->setText (text.get ());
+    auto clipboard = QGuiApplication::clipboard ();
+    clipboard->setText (QString::fromUtf8 (text));
+  });
 }
 #endif
 
@@ -757,6 +788,9 @@ ApvlvFrame::process (int has, int ct, uint key)
     case 'c':
       toggleDirectory ();
       break;
+    case 'C':
+      toggleThumbnails ();
+      break;
     default:
       return CmdReturn::NO_MATCH;
       break;
@@ -839,7 +873,7 @@ bool
 ApvlvFrame::saveLastPosition (const string &filename)
 {
   if (filename.empty () || HelpPdf == filename
-      || ApvlvParams::instance ()->getBoolOrDefault ("noinfo", false))
+      || ApvlvParams::instance ()->get (BoolParam::NOINFO))
     {
       return false;
     }
@@ -853,7 +887,7 @@ bool
 ApvlvFrame::loadLastPosition (const string &filename)
 {
   if (filename.empty () || HelpPdf == filename
-      || ApvlvParams::instance ()->getBoolOrDefault ("noinfo"))
+      || ApvlvParams::instance ()->get (BoolParam::NOINFO))
     {
       showPage (0, 0.0);
       return false;
@@ -904,6 +938,8 @@ ApvlvFrame::loadFile (const std::string &file, bool check, bool show_directory)
 
   if (mFile)
     {
+      // the files of the workers only read the note
+      mFile->getNote ()->setWritable ();
       emit indexGenerited (mFile->getIndex ());
 
       mFilestr = file;
@@ -915,6 +951,16 @@ ApvlvFrame::loadFile (const std::string &file, bool check, bool show_directory)
 
       setWidget (mFile->getDisplayType ());
 
+      if (mFile->getDisplayType () == DISPLAY_TYPE::IMAGE)
+        {
+          mThumbnails.setFile (file, mFile->sum ());
+        }
+      else
+        {
+          mThumbnails.setFile ("", 0);
+          mThumbnails.hide ();
+        }
+
       loadLastPosition (file);
 
       setActive (true);
@@ -922,7 +968,12 @@ ApvlvFrame::loadFile (const std::string &file, bool check, bool show_directory)
       mSearchStr = "";
       mSearchResults = nullptr;
 
-      if (ApvlvParams::instance ()->getIntOrDefault ("autoreload") > 0)
+#ifdef APVLV_WITH_OCR
+      if (mFile->getDisplayType () == DISPLAY_TYPE::IMAGE)
+        OCRPipeline::instance ()->submit (file);
+#endif
+
+      if (ApvlvParams::instance ()->get (IntParam::AUTORELOAD) > 0)
         {
           mWatcher = make_unique<QFileSystemWatcher> ();
           QObject::connect (mWatcher.get (), SIGNAL (fileChanged ()), this,
@@ -1149,7 +1200,7 @@ ApvlvFrame::search (const char *str, bool reverse)
   mSearchResults = nullptr;
   unsetHighlight ();
 
-  auto wrap = ApvlvParams::instance ()->getBoolOrDefault ("wrapscan");
+  auto wrap = ApvlvParams::instance ()->get (BoolParam::WRAPSCAN);
 
   auto i = mWidget->pageNumber ();
   auto sum = mFile->sum ();
@@ -1159,8 +1210,13 @@ ApvlvFrame::search (const char *str, bool reverse)
     {
       if (*str != 0 || search)
         {
-          mSearchResults
-              = mFile->pageSearch ((i + sum) % sum, mSearchStr.c_str ());
+          auto pn = (i + sum) % sum;
+          mSearchResults = mFile->pageSearch (pn, mSearchStr.c_str ());
+#ifdef APVLV_WITH_OCR
+          if (mSearchResults == nullptr || mSearchResults->empty ())
+            mSearchResults = OCRTextLayer::instance ()->pageSearch (
+                mFile->getFilename (), pn, mSearchStr);
+#endif
           if (mSearchResults != nullptr && !mSearchResults->empty ())
             {
               if (i != mWidget->pageNumber ())
@@ -1256,9 +1312,9 @@ ApvlvFrame::returnLink ([[maybe_unused]] int ct)
 }
 
 void
-ApvlvFrame::directoryShowPage (const FileIndex *index, bool force)
+ApvlvFrame::directoryShowPage (const optional<FileIndex> &index, bool force)
 {
-  if (index == nullptr)
+  if (!index)
     return;
 
   if (index->type == FileIndexType::FILE)
@@ -1301,7 +1357,9 @@ ApvlvFrame::setWidget (DISPLAY_TYPE type)
     {
       mWidget.reset (mFile->getWidget ());
     }
-  mTextLayout.addWidget (mWidget->widget (), 1);
+  // the page is above the thumbnail strip
+  mTextLayout.insertWidget (mTextLayout.indexOf (&mThumbnails),
+                            mWidget->widget (), 1);
 
   mPaned.setSizes (sizes);
 }
@@ -1371,6 +1429,7 @@ ApvlvFrame::updateStatus ()
 
       mDirectory.setCurrentIndex (mFilestr, mWidget->pageNumber (),
                                   mWidget->anchor ());
+      mThumbnails.setCurrentPage (mWidget->pageNumber ());
     }
 }
 
@@ -40,6 +40,7 @@
 #include "ApvlvDirectory.h"
 #include "ApvlvFile.h"
 #include "ApvlvFileWidget.h"
+#include "ApvlvThumbnail.h"
 #include "ApvlvWidget.h"
 
 namespace apvlv
@@ -186,7 +187,7 @@ public:
   bool loadLastPosition (const std::string &filename);
   bool saveLastPosition (const std::string &filename);
 
-  void directoryShowPage (const FileIndex *index, bool force);
+  void directoryShowPage (const std::optional<FileIndex> &index, bool force);
 
   int getSkip ();
   void setSkip (int ct);
@@ -201,6 +202,8 @@ public:
 
   bool isControlledDirectory ();
 
+  void toggleThumbnails ();
+
   void wheelEvent (QWheelEvent *event) override;
 
   CmdReturn process (int has, int times, uint keyval);
@@ -218,8 +221,6 @@ public:
 private:
   std::unique_ptr<File> mFile;
 
-  FileIndex mDirIndex{};
-
   bool mInuse;
 
   std::unique_ptr<QFileSystemWatcher> mWatcher;
@@ -264,6 +265,7 @@ private:
   QVBoxLayout mTextLayout;
   ApvlvToolStatus mToolStatus;
   std::unique_ptr<FileWidget> mWidget;
+  ThumbnailStrip mThumbnails;
 
   // status bar
   ApvlvStatus mStatus;
@@ -287,6 +289,7 @@ private slots:
   void setZoomMode (int mode);
   void zoomIn ();
   void zoomOut ();
+  void thumbnailShowPage (int pn);
 #ifdef APVLV_WITH_OCR
   void ocrParse ();
   void ocrCopy ();
@@ -29,14 +29,36 @@
 #include <QClipboard>
 #include <QInputDialog>
 #include <QMouseEvent>
+#include <algorithm>
+#include <chrono>
 #include <iostream>
 
 #include "ApvlvImageWidget.h"
+#include "ApvlvParams.h"
+#include "ApvlvThumbnail.h"
+#include "ApvlvTrace.h"
 
 namespace apvlv
 {
 using namespace std;
 
+// the space between the pages in the continuous mode
+const int PAGE_GAP = 8;
+// the containers kept hidden for the next pages
+const size_t SPARE_CONTAINERS = 2;
+// the zoom of the preview of a slow page, relative to the page
+const double PREVIEW_RATE = 0.25;
+// the quiet time after a zoom step before the pages are rendered again
+const int ZOOM_DELAY = 200;
+
+// what the renderer draws of the page
+static vector<Comment>
+pageComments (File *file, int pn)
+{
+  auto comments = file->getNote ()->getCommentsInPage (pn);
+  return { comments.begin (), comments.end () };
+}
+
 #ifdef APVLV_WITH_OCR
 TextContainer::TextContainer (QWidget *parent) : Editor (parent)
 {
@@ -66,6 +88,12 @@ ImageContainer::ImageContainer (QWidget *parent) : QLabel (parent)
   setContextMenuPolicy (Qt::ContextMenuPolicy::ActionsContextMenu);
 }
 
+ImageContainer::~ImageContainer ()
+{
+  if (mRenderer)
+    mRenderer->cancel (this);
+}
+
 void
 ImageContainer::mousePressEvent (QMouseEvent *event)
 {
@@ -87,7 +115,7 @@ ImageContainer::mouseMoveEvent (QMouseEvent *event)
 
   auto range = selectionRange ();
   auto rect_list = mImageWidget->file ()->pageHighlight (
-      mImageWidget->pageNumber (), range.first, range.second);
+      mPageNumber, range.first, range.second);
   if (!rect_list)
     return;
 
@@ -105,23 +133,122 @@ ImageContainer::mouseReleaseEvent (QMouseEvent *event)
 bool
 ImageContainer::renderImage (int pn, double zm, int rot)
 {
-  return mImageWidget->file ()->pageRenderToImage (pn, zm, rot, &mImage);
+  auto file = mImageWidget->file ();
+  mSerial++;
+  if (mRenderer == nullptr || !mRenderer->isSlow ())
+    {
+      auto begin = chrono::steady_clock::now ();
+#ifdef APVLV_WITH_OCR
+      OCRPipeline::Throttle throttle;
+#endif
+      if (!file->pageRenderToImage (pn, zm, rot, &mImage))
+        return false;
+      if (mRenderer)
+        {
+          auto elapsed = chrono::steady_clock::now () - begin;
+          mRenderer->setRenderTime (static_cast<int> (
+              chrono::duration_cast<chrono::milliseconds> (elapsed).count ()));
+        }
+      mPageNumber = pn;
+      mImageZoom = zm;
+      return true;
+    }
+
+  // a slow page shows a preview at once, the full render replaces it
+  if (!renderPreview (pn, zm, rot))
+    return false;
+  mPageNumber = pn;
+  mImageZoom = zm;
+  mRequestZoom = zm;
+  mRenderer->render (this, mSerial, file->getFilename (), pn, zm, rot,
+                     pageComments (file, pn));
+  return true;
+}
+
+bool
+ImageContainer::renderPreview (int pn, double zm, int rot)
+{
+  auto file = mImageWidget->file ();
+  QImage preview;
+  // the thumbnails are not rotated
+  if (rot == 0)
+    preview = ThumbnailCache::instance ()->find (file->getFilename (), pn);
+  if (preview.isNull ()
+      && !file->pageRenderToImage (pn, zm * PREVIEW_RATE, rot, &preview))
+    return false;
+
+  auto size = file->pageSizeF (pn, rot);
+  QSize target (static_cast<int> (size.width * zm),
+                static_cast<int> (size.height * zm));
+  if (target.isEmpty ())
+    mImage = preview;
+  else
+    mImage = preview.scaled (target, Qt::IgnoreAspectRatio,
+                             Qt::FastTransformation);
+  return true;
+}
+
+void
+ImageContainer::rendered (unsigned int serial, const QImage &image)
+{
+  if (serial != mSerial)
+    return;
+
+  mImage = image;
+  mImageZoom = mRequestZoom;
+  redraw ();
+}
+
+void
+ImageContainer::rerender ()
+{
+  auto zm = mImageWidget->zoomrate ();
+  if (mPageNumber == INVALID_PAGENUM || mImageZoom == zm)
+    return;
+
+  if (mRenderer == nullptr)
+    {
+      if (renderImage (mPageNumber, zm, mImageWidget->rotate ()))
+        redraw ();
+      return;
+    }
+
+  auto file = mImageWidget->file ();
+  mSerial++;
+  mRequestZoom = zm;
+  mRenderer->render (this, mSerial, file->getFilename (), mPageNumber, zm,
+                     mImageWidget->rotate (),
+                     pageComments (file, mPageNumber));
 }
 
 void
 ImageContainer::redraw ()
 {
+  APVLV_TRACE ("redraw");
+  // scaled from the last rendered image, until it is rendered again
   QImage img = mImage;
-  if (!mImageWidget->searchResults ().empty ())
+  auto zm = mImageWidget->zoomrate ();
+  if (mImageZoom > 0.0 && mImageZoom != zm && !mImage.isNull ())
+    img = mImage.scaled (mImage.size () * (zm / mImageZoom),
+                         Qt::IgnoreAspectRatio, Qt::FastTransformation);
+
+  // the search results are of the current page, the selection is of the
+  // page under the mouse
+  if (!mImageWidget->searchResults ().empty ()
+      && mPageNumber == mImageWidget->pageNumber ())
     {
+      APVLV_TRACE ("redraw.overlay");
       imageSelectSearch (&img, mImageWidget->zoomrate (),
                          mImageWidget->searchSelect (),
                          mImageWidget->searchResults ());
     }
-  else if (!mImageWidget->selects ().empty ())
+  else if (!mImageWidget->selects ().empty () && mIsSelected)
     {
+      APVLV_TRACE ("redraw.overlay");
       imageSelect (&img, mImageWidget->zoomrate (), mImageWidget->selects ());
     }
+
+  APVLV_TRACE ("redraw.pixmap");
   setPixmap (QPixmap::fromImage (img));
   resize (img.size ());
 }
@@ -141,7 +268,7 @@ ImageContainer::selectionArea ()
 {
   auto range = selectionRange ();
   auto rect_list = mImageWidget->file ()->pageHighlight (
-      mImageWidget->pageNumber (), range.first, range.second);
+      mPageNumber, range.first, range.second);
   if (!rect_list)
     return {};
   return rect_list.value ();
@@ -153,7 +280,7 @@ ImageContainer::selectionText ()
   auto range = selectionRange ();
   string text;
   mImageWidget->file ()->pageText (
-      mImageWidget->pageNumber (),
+      mPageNumber,
       { range.first.x, range.first.y, range.second.x, range.second.y }, text);
   return text;
 }
@@ -173,7 +300,7 @@ void
 ImageContainer::underline ()
 {
   qDebug () << "underline text";
-  auto page = mImageWidget->pageNumber ();
+  auto page = mPageNumber;
   auto range = selectionRange ();
   auto text = selectionText ();
   if (!text.empty ())
@@ -206,7 +333,7 @@ ImageContainer::comment ()
       if (commentText.isEmpty ())
         break;
 
-      auto page = mImageWidget->pageNumber ();
+      auto page = mPageNumber;
       auto range = selectionRange ();
       auto note = mImageWidget->file ()->getNote ();
       Comment comment;
@@ -228,11 +355,22 @@ ApvlvImage::ApvlvImage ()
   setHorizontalScrollBarPolicy (Qt::ScrollBarPolicy::ScrollBarAsNeeded);
   setVerticalScrollBarPolicy (Qt::ScrollBarPolicy::ScrollBarAsNeeded);
 
-  setWidget (&mImageContainer);
+  mImageContainer.setRenderer (&mRenderer);
+  mZoomTimer.setSingleShot (true);
+  QObject::connect (&mZoomTimer, SIGNAL (timeout ()), this,
+                    SLOT (renderZoomed ()));
+  if (ApvlvParams::instance ()->get (BoolParam::CONTINUOUS))
+    mPageWidget = &mImageStrip;
+  else
+    mPageWidget = &mImageContainer;
+  setWidget (mPageWidget);
 }
 
 ApvlvImage::~ApvlvImage ()
 {
+#ifdef APVLV_WITH_OCR
+  ocrCancel ();
+#endif
   qDebug () << "ApvlvImage: " << this << " be freed";
 }
 
@@ -242,45 +380,529 @@ ApvlvImage::ocrDisplay (bool is_ocr)
 {
   if (is_ocr)
     {
-      auto image = mImageContainer.pixmap ();
-      auto text = mOCR.getTextFromPixmap (image);
-      mTextContainer.setText (text.get ());
-      if (widget () != &mTextContainer)
+      ocrText ([this] (const string &text) {
+        mTextContainer.setText (QString::fromUtf8 (text));
+        if (widget () != &mTextContainer)
+          {
+            takeWidget ();
+            setWidget (&mTextContainer);
+          }
+      });
+    }
+  else
+    {
+      ocrCancel ();
+      if (widget () != mPageWidget)
         {
           takeWidget ();
-          setWidget (&mTextContainer);
+          setWidget (mPageWidget);
         }
     }
+}
+
+void
+ApvlvImage::ocrText (const function<void (const string &)> &callback)
+{
+  auto image_widget = mImageContainer.mImageWidget;
+  auto file = image_widget->file ();
+  auto pn = image_widget->pageNumber ();
+  if (file == nullptr || pn == INVALID_PAGENUM)
+    return;
+
+  // the recognized pages are cached for every zoom rate, the text pages
+  // are stored empty by the pipeline and recognized here
+  auto path = file->getFilename ();
+  auto text = OCRTextLayer::instance ()->pageText (path, pn);
+  if (text && !text->empty ())
+    {
+      callback (*text);
+      return;
+    }
+
+  ocrCancel ();
+
+  auto task = make_shared<OCRTask> ();
+  task->owner = this;
+  mOcrTask = task;
+  auto serial = mOcrSerial;
+  auto engine = mOCR;
+  thread ([task, engine, path, pn, serial, callback] () {
+    lock_guard<mutex> lock (engine->mutex);
+    if (task->cancel.load ())
+      return;
+
+    // the page is rendered at the OCR zoom rate by a File of the thread
+    auto zm = OCR::zoomrate ();
+    auto file = FileFactory::loadFile (path);
+    QImage image;
+    if (!file || !file->pageRenderToImage (pn, zm, 0, &image))
+      return;
+
+    auto page = engine->ocr.recognize (image, zm, &task->cancel);
+    if (!page)
+      return;
+
+    OCRTextLayer::instance ()->store (path, pn, *page);
+    lock_guard<mutex> owner_lock (task->mutex);
+    auto owner = task->owner;
+    if (owner == nullptr)
+      return;
+    QMetaObject::invokeMethod (
+        owner,
+        [owner, text = page->text, pn, serial, callback] () {
+          if (serial != owner->mOcrSerial
+              || owner->mImageContainer.mImageWidget->pageNumber () != pn)
+            return;
+          callback (text);
+        },
+        Qt::QueuedConnection);
+  }).detach ();
+}
+
+void
+ApvlvImage::ocrCancel ()
+{
+  mOcrSerial++;
+  if (mOcrTask == nullptr)
+    return;
+
+  // the thread stops by itself, it no longer reaches this image
+  mOcrTask->cancel.store (true);
+  {
+    lock_guard<mutex> lock (mOcrTask->mutex);
+    mOcrTask->owner = nullptr;
+  }
+  mOcrTask.reset ();
+}
+#endif
+
+PageRenderer::~PageRenderer ()
+{
+  {
+    lock_guard<mutex> lock (mMutex);
+    mQuit = true;
+  }
+  mCondition.notify_all ();
+  if (mTask.joinable ())
+    mTask.join ();
+}
+
+void
+PageRenderer::render (ImageContainer *container, unsigned int serial,
+                      const string &path, int pn, double zm, int rot,
+                      vector<Comment> comments)
+{
+  lock_guard<mutex> lock (mMutex);
+  Task task{ container, serial, path, pn, zm, rot, std::move (comments) };
+  auto itr = find_if (mTasks.begin (), mTasks.end (), [container] (auto &t) {
+    return t.container == container;
+  });
+  if (itr != mTasks.end ())
+    *itr = std::move (task);
   else
+    mTasks.push_back (std::move (task));
+
+  if (!mTask.joinable ())
+    mTask = thread (&PageRenderer::workerLoop, this);
+  mCondition.notify_one ();
+}
+
+void
+PageRenderer::cancel (ImageContainer *container)
+{
+  lock_guard<mutex> lock (mMutex);
+  std::erase_if (mTasks,
+                 [container] (auto &t) { return t.container == container; });
+  if (mRendering == container)
+    mRendering = nullptr;
+}
+
+void
+PageRenderer::workerLoop ()
+{
+  string path;
+  DirectoryScanner::Entry status{};
+  unique_ptr<File> file;
+  unique_lock<mutex> lock (mMutex);
+  while (!mQuit)
     {
-      if (widget () != &mImageContainer)
+      if (mTasks.empty ())
         {
-          takeWidget ();
-          setWidget (&mImageContainer);
+          mCondition.wait (lock);
+          continue;
+        }
+
+      auto task = std::move (mTasks.front ());
+      mTasks.pop_front ();
+      mRendering = task.container;
+      lock.unlock ();
+
+      // a changed document is loaded again
+      DirectoryScanner::Entry current{};
+      DirectoryScanner::status (task.path, current);
+      if (file == nullptr || path != task.path
+          || current.mtime != status.mtime || current.size != status.size)
+        {
+          path = task.path;
+          status = current;
+          file = FileFactory::loadFile (path);
+        }
+
+      QImage image;
+      auto rendered = false;
+      if (file)
+        {
+          file->getNote ()->setCommentsInPage (task.pn, task.comments);
+          auto begin = chrono::steady_clock::now ();
+#ifdef APVLV_WITH_OCR
+          OCRPipeline::Throttle throttle;
+#endif
+          rendered = file->pageRenderToImage (task.pn, task.zm, task.rot,
+                                              &image);
+          auto elapsed = chrono::steady_clock::now () - begin;
+          setRenderTime (static_cast<int> (
+              chrono::duration_cast<chrono::milliseconds> (elapsed).count ()));
+        }
+
+      lock.lock ();
+      // a cancelled container may be deleted, it is not touched
+      if (rendered && mRendering == task.container)
+        {
+          auto container = task.container;
+          QMetaObject::invokeMethod (
+              container,
+              [container, serial = task.serial, image] () {
+                container->rendered (serial, image);
+              },
+              Qt::QueuedConnection);
         }
+      mRendering = nullptr;
     }
 }
 
-std::unique_ptr<char>
-ApvlvImage::ocrGetText ()
+void
+ApvlvImage::renderZoomed ()
 {
-  auto image = mImageContainer.pixmap ();
-  auto text = mOCR.getTextFromPixmap (image);
-  return text;
+  if (isContinuous ())
+    mImageStrip.rerender ();
+  else
+    mImageContainer.rerender ();
+}
+
+void
+ApvlvImage::resizeEvent (QResizeEvent *event)
+{
+  QScrollArea::resizeEvent (event);
+  if (isContinuous ())
+    mImageStrip.updateContainers ();
+}
+
+ImageStrip::ImageStrip (ApvlvImage *image) : mImage (image)
+{
+  QObject::connect (mImage->verticalScrollBar (), SIGNAL (valueChanged (int)),
+                    this, SLOT (scrolled (int)));
+}
+
+void
+ImageStrip::relayout ()
+{
+  auto file = mImageWidget->file ();
+  auto rotate = mImageWidget->rotate ();
+  auto changed = file != mFile || rotate != mRotate;
+  if (changed)
+    {
+      mFile = file;
+      mRotate = rotate;
+      auto sum = mFile ? mFile->sum () : 0;
+      mSizes.assign (sum, sum > 0 ? mFile->pageSizeF (0, mRotate) : SizeF{});
+      mMeasured.assign (sum, false);
+      if (sum > 0)
+        mMeasured[0] = true;
+    }
+
+  layoutTops ();
+  for (auto &container : mContainers)
+    {
+      // every page is rendered again by the next scroll
+      if (changed)
+        {
+          container->mPageNumber = INVALID_PAGENUM;
+        }
+      // a new zoom rate scales the rendered pages for now
+      else if (container->mPageNumber != INVALID_PAGENUM)
+        {
+          container->redraw ();
+          container->move (pageRect (container->mPageNumber).topLeft ());
+        }
+    }
+}
+
+bool
+ImageStrip::measure (int first, int last)
+{
+  auto changed = false;
+  last = std::min (last, static_cast<int> (mSizes.size ()) - 1);
+  for (auto pn = std::max (first, 0); pn <= last; ++pn)
+    {
+      if (mMeasured[pn])
+        continue;
+
+      mMeasured[pn] = true;
+      auto size = mFile->pageSizeF (pn, mRotate);
+      if (size.width != mSizes[pn].width || size.height != mSizes[pn].height)
+        {
+          mSizes[pn] = size;
+          changed = true;
+        }
+    }
+  return changed;
+}
+
+void
+ImageStrip::layoutTops ()
+{
+  auto zm = mImageWidget->zoomrate ();
+  mTops.resize (mSizes.size () + 1);
+  mWidth = 0;
+  auto top = 0;
+  for (size_t pn = 0; pn < mSizes.size (); ++pn)
+    {
+      mTops[pn] = top;
+      top += static_cast<int> (mSizes[pn].height * zm) + PAGE_GAP;
+      mWidth = std::max (mWidth, static_cast<int> (mSizes[pn].width * zm));
+    }
+  mTops.back () = top;
+  setFixedSize (mWidth, top);
+}
+
+void
+ImageStrip::redraw ()
+{
+  for (auto &container : mContainers)
+    {
+      if (container->mPageNumber != INVALID_PAGENUM)
+        container->redraw ();
+    }
+}
+
+void
+ImageStrip::rerender ()
+{
+  for (auto &container : mContainers)
+    {
+      container->rerender ();
+    }
+}
+
+void
+ImageStrip::scrollTo (int pn, double rate)
+{
+  if (pn < 0 || pn + 1 >= static_cast<int> (mTops.size ()))
+    return;
+
+  if (measure (pn, pn))
+    layoutTops ();
+  auto bar = mImage->verticalScrollBar ();
+  auto rect = pageRect (pn);
+  auto scroll = std::max (rect.height () - mImage->viewport ()->height (), 0);
+  auto value = rect.top () + static_cast<int> (rate * scroll);
+
+  // the scroll bar gets the new range when the strip is resized
+  mPendingPage = value > bar->maximum () ? pn : INVALID_PAGENUM;
+  mPendingRate = rate;
+
+  mScrolling = true;
+  bar->setValue (value);
+  mScrolling = false;
+  updateContainers ();
+}
+
+double
+ImageStrip::scrollRate (int pn)
+{
+  if (pn < 0 || pn + 1 >= static_cast<int> (mTops.size ()))
+    return 0.0;
+
+  auto rect = pageRect (pn);
+  auto scroll = rect.height () - mImage->viewport ()->height ();
+  if (scroll <= 0)
+    return 0.0;
+
+  auto value = mImage->verticalScrollBar ()->value () - rect.top ();
+  return std::clamp (static_cast<double> (value) / scroll, 0.0, 1.0);
+}
+
+int
+ImageStrip::pageAt (int y) const
+{
+  if (mTops.size () < 2)
+    return INVALID_PAGENUM;
+
+  auto itr = upper_bound (mTops.begin (), mTops.end () - 1, y);
+  return std::max (static_cast<int> (itr - mTops.begin ()) - 1, 0);
+}
+
+QRect
+ImageStrip::pageRect (int pn) const
+{
+  if (pn < 0 || pn + 1 >= static_cast<int> (mTops.size ()))
+    return {};
+
+  auto zm = mImageWidget->zoomrate ();
+  auto width = static_cast<int> (mSizes[pn].width * zm);
+  auto height = mTops[pn + 1] - mTops[pn] - PAGE_GAP;
+  return { (mWidth - width) / 2, mTops[pn], width, height };
+}
+
+void
+ImageStrip::resizeEvent (QResizeEvent *event)
+{
+  QWidget::resizeEvent (event);
+  if (mPendingPage != INVALID_PAGENUM)
+    scrollTo (mPendingPage, mPendingRate);
+}
+
+void
+ImageStrip::updateContainers ()
+{
+  auto first = INVALID_PAGENUM;
+  auto last = INVALID_PAGENUM - 1;
+  auto bar = mImage->verticalScrollBar ();
+  auto height = mImage->viewport ()->height ();
+  auto range = [&] {
+    // the pages in the viewport and half a viewport around it
+    auto value = bar->value ();
+    first = pageAt (value - height / 2);
+    last = pageAt (value + height + height / 2);
+  };
+
+  // the real sizes move the pages, a few passes read the pages shown
+  for (auto pass = 0; pass < 3 && mTops.size () > 1; ++pass)
+    {
+      range ();
+      auto value = bar->value ();
+      auto top = pageAt (value);
+      auto offset = value - mTops[top];
+      if (!measure (first, last))
+        break;
+
+      // the page at the top of the viewport stays in place
+      layoutTops ();
+      mScrolling = true;
+      bar->setValue (mTops[top] + offset);
+      mScrolling = false;
+      range ();
+    }
+
+  vector<ImageContainer *> spare;
+  vector<bool> shown (std::max (last - first + 1, 0), false);
+  for (auto &container : mContainers)
+    {
+      auto pn = container->mPageNumber;
+      if (pn != INVALID_PAGENUM && pn >= first && pn <= last)
+        {
+          shown[pn - first] = true;
+          container->move (pageRect (pn).topLeft ());
+        }
+      else
+        {
+          spare.push_back (container.get ());
+        }
+    }
+
+  auto zm = mImageWidget->zoomrate ();
+  for (auto pn = first; pn <= last; ++pn)
+    {
+      if (shown[pn - first])
+        continue;
+
+      ImageContainer *container;
+      if (!spare.empty ())
+        {
+          container = spare.back ();
+          spare.pop_back ();
+        }
+      else
+        {
+          auto created = make_unique<ImageContainer> (this);
+          created->setImageWidget (mImageWidget);
+          created->setRenderer (&mImage->mRenderer);
+          container = created.get ();
+          mContainers.push_back (std::move (created));
+        }
+
+      if (!container->renderImage (pn, zm, mRotate))
+        {
+          container->mPageNumber = INVALID_PAGENUM;
+          container->hide ();
+          continue;
+        }
+      container->redraw ();
+      container->move (pageRect (pn).topLeft ());
+      container->show ();
+    }
+
+  for (auto container : spare)
+    {
+      container->mPageNumber = INVALID_PAGENUM;
+      container->hide ();
+    }
+
+  // a long jump must not keep a container for every page it passed
+  if (spare.size () > SPARE_CONTAINERS)
+    {
+      spare.resize (spare.size () - SPARE_CONTAINERS);
+      std::erase_if (mContainers, [&spare] (auto const &container) {
+        return find (spare.begin (), spare.end (), container.get ())
+               != spare.end ();
+      });
+    }
+}
+
+void
+ImageStrip::scrolled (int value)
+{
+  if (mScrolling)
+    return;
+
+  mPendingPage = INVALID_PAGENUM;
+  auto pn = pageAt (value);
+  if (pn != INVALID_PAGENUM)
+    mImageWidget->mPageNumber = pn;
+  updateContainers ();
+}
+
+void
+ImageWidget::setFile (File *file)
+{
+  mFile = file;
+  mImage.mImageStrip.reset ();
+  if (mImage.isContinuous ())
+    mImage.mImageStrip.relayout ();
 }
-#endif
 
 void
 ImageWidget::showPage (int p, double s)
 {
-  if (p != mPageNumber)
+  if (!mImage.isContinuous ())
     {
-      if (!mImage.mImageContainer.renderImage (p, mZoomrate, mRotate))
-        return;
+      if (p != mPageNumber)
+        {
+          if (!mImage.mImageContainer.renderImage (p, mZoomrate, mRotate))
+            return;
+        }
+      mImage.mImageContainer.redraw ();
     }
-  mImage.mImageContainer.redraw ();
+  mPageNumber = p;
 #ifdef APVLV_WITH_OCR
-  mImage.mTextContainer.resize (mImage.mImageContainer.size ());
+  if (mImage.isContinuous ())
+    {
+      auto rect = mImage.mImageStrip.pageRect (p);
+      if (rect.isValid ())
+        mImage.mTextContainer.resize (rect.size ());
+    }
+  else
+    mImage.mTextContainer.resize (mImage.mImageContainer.size ());
   if (mImage.widget () == &mImage.mTextContainer)
     {
       mImage.mTextContainer.setZoomrate (mZoomrate);
@@ -288,7 +910,6 @@ ImageWidget::showPage (int p, double s)
     }
 #endif
   scrollTo (0.0, s);
-  mPageNumber = p;
 }
 
 void
@@ -298,26 +919,62 @@ ImageWidget::showPage (int p, const string &anchor)
   mAnchor = anchor;
 }
 
+double
+ImageWidget::scrollRate ()
+{
+  if (!mImage.isContinuous ())
+    return FileWidget::scrollRate ();
+
+  return mImage.mImageStrip.scrollRate (mPageNumber);
+}
+
+void
+ImageWidget::scrollTo (double s, double y)
+{
+  if (!mImage.isContinuous ())
+    {
+      FileWidget::scrollTo (s, y);
+      return;
+    }
+
+  // the rate is in the current page, like the single page mode
+  mImage.mImageStrip.scrollTo (mPageNumber, y);
+}
+
 void
 ImageWidget::setSearchResults (const WordListRectangle &wlr)
 {
   mSearchResults = wlr;
-  mImage.mImageContainer.redraw ();
+  if (mImage.isContinuous ())
+    mImage.mImageStrip.redraw ();
+  else
+    mImage.mImageContainer.redraw ();
 }
 
 void
 ImageWidget::setZoomrate (double zm)
 {
-  if (mPageNumber != INVALID_PAGENUM)
+  if (mImage.isContinuous ())
     {
-      if (mImage.mImageContainer.renderImage (mPageNumber, zm, mRotate))
-        {
-          mImage.mImageContainer.redraw ();
-          mZoomrate = zm;
-        }
+      auto rate = scrollRate ();
+      mZoomrate = zm;
+      mImage.mImageStrip.relayout ();
+      scrollTo (0.0, rate);
 #ifdef APVLV_WITH_OCR
       mImage.mTextContainer.setZoomrate (zm);
 #endif
+      mImage.mZoomTimer.start (ZOOM_DELAY);
+    }
+  else if (mPageNumber != INVALID_PAGENUM)
+    {
+      // the current image is scaled at once, the steps of a fast zoom
+      // are rendered once
+      mZoomrate = zm;
+      mImage.mImageContainer.redraw ();
+#ifdef APVLV_WITH_OCR
+      mImage.mTextContainer.setZoomrate (zm);
+#endif
+      mImage.mZoomTimer.start (ZOOM_DELAY);
     }
   else
     {
@@ -328,7 +985,13 @@ ImageWidget::setZoomrate (double zm)
 void
 ImageWidget::setRotate (int rotate)
 {
-  if (mPageNumber != INVALID_PAGENUM)
+  if (mImage.isContinuous ())
+    {
+      mRotate = rotate;
+      mImage.mImageStrip.relayout ();
+      scrollTo (0.0, 0.0);
+    }
+  else if (mPageNumber != INVALID_PAGENUM)
     {
       if (mImage.mImageContainer.renderImage (mPageNumber, mZoomrate, rotate))
         {
@@ -31,7 +31,16 @@
 #include <QLabel>
 #include <QMainWindow>
 #include <QScrollArea>
+#include <QTimer>
 #include <QVBoxLayout>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 #include "ApvlvFileWidget.h"
 #include "ApvlvUtil.h"
@@ -53,12 +62,76 @@ public:
 };
 #endif
 
+class ImageContainer;
+
+//
+// renders the pages at full quality off the GUI thread, with its own File
+//
+// A new request of a container replaces its pending one, and a result is
+// only delivered if the container has not asked for another page since.
+//
+class PageRenderer final
+{
+public:
+  PageRenderer () = default;
+  ~PageRenderer ();
+
+  // the comments of the page are drawn as the GUI has them, the note of
+  // the renderer's File is not refreshed otherwise
+  void render (ImageContainer *container, unsigned int serial,
+               const std::string &path, int pn, double zm, int rot,
+               std::vector<Comment> comments);
+  // drops the requests of a container, it is being deleted
+  void cancel (ImageContainer *container);
+
+  // a page rendering slower than that is shown progressively
+  [[nodiscard]] bool
+  isSlow () const
+  {
+    return mRenderTime.load () > SLOW_RENDER_MS;
+  }
+
+  void
+  setRenderTime (int ms)
+  {
+    mRenderTime.store (ms);
+  }
+
+  static const int SLOW_RENDER_MS = 50;
+
+private:
+  struct Task
+  {
+    ImageContainer *container;
+    unsigned int serial;
+    std::string path;
+    int pn;
+    double zm;
+    int rot;
+    std::vector<Comment> comments;
+  };
+
+  void workerLoop ();
+
+  std::mutex mMutex;
+  std::condition_variable mCondition;
+  std::deque<Task> mTasks;
+  // the container of the page being rendered, reset by cancel
+  ImageContainer *mRendering{ nullptr };
+  std::thread mTask;
+  bool mQuit{ false };
+
+  // the last full render, in milliseconds
+  std::atomic<int> mRenderTime{ 0 };
+};
+
 class ImageWidget;
 class ImageContainer : public QLabel
 {
   Q_OBJECT
 public:
   explicit ImageContainer (QWidget *parent = nullptr);
+  ~ImageContainer () override;
 
   void mousePressEvent (QMouseEvent *event) override;
   void mouseMoveEvent (QMouseEvent *event) override;
@@ -66,6 +139,8 @@ public:
 
   virtual bool renderImage (int pn, double zm, int rot);
   virtual void redraw ();
+  // render the page again at the zoom rate of the widget, in background
+  void rerender ();
 
   void
   setImageWidget (ImageWidget *image_widget)
@@ -73,7 +148,33 @@ public:
     mImageWidget = image_widget;
   }
 
+  void
+  setRenderer (PageRenderer *renderer)
+  {
+    mRenderer = renderer;
+  }
+
+  [[nodiscard]] int
+  pageNumber () const
+  {
+    return mPageNumber;
+  }
+
+  // the full quality image of a request, from the renderer
+  void rendered (unsigned int serial, const QImage &image);
+
 private:
+  // the rendered page
+  int mPageNumber{ INVALID_PAGENUM };
+  PageRenderer *mRenderer{ nullptr };
+  // the last request to the renderer, older results are stale
+  unsigned int mSerial{ 0 };
+  // the zoom rate of the image, it is scaled to the zoom rate of the
+  // widget until the page is rendered again
+  double mImageZoom{ 0.0 };
+  double mRequestZoom{ 0.0 };
+
+  bool renderPreview (int pn, double zm, int rot);
   bool mIsSelected{ false };
 
   QPointF mPressPosition;
@@ -82,6 +183,8 @@ private:
   ImageWidget *mImageWidget{ nullptr };
 
   friend class ImageWidget;
+  friend class ApvlvImage;
+  friend class ImageStrip;
 
   QImage mImage;
   QAction mCopyAction;
@@ -98,6 +201,84 @@ private slots:
   void comment ();
 };
 
+class ApvlvImage;
+
+//
+// the continuous mode, all the pages laid out from top to bottom
+//
+// The layout comes from a table of the page sizes, only the pages near
+// the viewport have a container. The containers are recycled while
+// scrolling, so the memory does not depend on the document length.
+//
+// A page size is read when the page comes near the viewport, the size of
+// the first page stands for the others until then.
+//
+class ImageStrip : public QWidget
+{
+  Q_OBJECT
+public:
+  explicit ImageStrip (ApvlvImage *image);
+
+  void
+  setImageWidget (ImageWidget *image_widget)
+  {
+    mImageWidget = image_widget;
+  }
+
+  // lay out the pages again, after the file, zoom rate or rotation
+  // changed, the caller scrolls to the page to show
+  void relayout ();
+  // forget the page sizes, a new file may be at the address of the old
+  void
+  reset ()
+  {
+    mFile = nullptr;
+  }
+  void redraw ();
+  void rerender ();
+
+  void scrollTo (int pn, double rate);
+  double scrollRate (int pn);
+
+  [[nodiscard]] int pageAt (int y) const;
+  [[nodiscard]] QRect pageRect (int pn) const;
+
+protected:
+  void resizeEvent (QResizeEvent *event) override;
+
+private:
+  ApvlvImage *mImage;
+  ImageWidget *mImageWidget{ nullptr };
+
+  // the page sizes at zoom 1.0, they are read once per file and rotation
+  File *mFile{ nullptr };
+  int mRotate{ 0 };
+  std::vector<SizeF> mSizes;
+  std::vector<bool> mMeasured;
+  // the top of every page at the current zoom rate, the last one is the
+  // end of the strip
+  std::vector<int> mTops;
+  int mWidth{ 0 };
+
+  std::vector<std::unique_ptr<ImageContainer>> mContainers;
+
+  // set while the strip scrolls itself, the page is not followed
+  bool mScrolling{ false };
+  // a scroll waiting for the new size of the strip
+  int mPendingPage{ INVALID_PAGENUM };
+  double mPendingRate{ 0.0 };
+
+  // reads the sizes of the pages not read yet, true if one has changed
+  bool measure (int first, int last);
+  void layoutTops ();
+
+public slots:
+  void updateContainers ();
+
+private slots:
+  void scrolled (int value);
+};
+
 class ApvlvImage : public QScrollArea
 {
   Q_OBJECT
@@ -106,19 +287,59 @@ public:
 
   ~ApvlvImage () override;
 
+  [[nodiscard]] bool
+  isContinuous () const
+  {
+    return mPageWidget == &mImageStrip;
+  }
+
+protected:
+  void resizeEvent (QResizeEvent *event) override;
+
 #ifdef APVLV_WITH_OCR
   void ocrDisplay (bool replace);
-  std::unique_ptr<char> ocrGetText ();
+  // the recognized text of the current page, delivered on the GUI thread
+  void ocrText (const std::function<void (const std::string &)> &callback);
 #endif
 
 private:
+  // before the containers, they cancel their requests when deleted
+  PageRenderer mRenderer;
   ImageContainer mImageContainer;
+  ImageStrip mImageStrip{ this };
+  // the container or the strip, by the continuous setting
+  QWidget *mPageWidget;
+  // the pages are rendered at a new zoom rate when the zooming stops
+  QTimer mZoomTimer;
 #ifdef APVLV_WITH_OCR
   TextContainer mTextContainer;
-  OCR mOCR;
+
+  // a recognition in background, its thread is detached and reaches the
+  // image only while owner is set
+  struct OCRTask
+  {
+    std::mutex mutex;
+    ApvlvImage *owner{ nullptr };
+    std::atomic<bool> cancel{ false };
+  };
+  // used by one task at a time, a cancelled one ends first
+  struct OCREngine
+  {
+    std::mutex mutex;
+    OCR ocr;
+  };
+  std::shared_ptr<OCREngine> mOCR{ std::make_shared<OCREngine> () };
+  std::shared_ptr<OCRTask> mOcrTask;
+  unsigned int mOcrSerial{ 0 };
+
+  void ocrCancel ();
 #endif
 
   friend class ImageWidget;
+  friend class ImageStrip;
+
+private slots:
+  void renderZoomed ();
 };
 
 class ImageWidget : public FileWidget
@@ -127,6 +348,7 @@ public:
   ImageWidget ()
   {
     mImage.mImageContainer.setImageWidget (this);
+    mImage.mImageStrip.setImageWidget (this);
     mHalScrollBar = mImage.horizontalScrollBar ();
     mValScrollBar = mImage.verticalScrollBar ();
   }
@@ -137,15 +359,22 @@ public:
     return &mImage;
   }
 
+  void setFile (File *file) override;
+
   void showPage (int pn, double s) override;
   void showPage (int pn, const std::string &anchor) override;
 
+  double scrollRate () override;
+  void scrollTo (double s, double y) override;
+
   void setSearchResults (const WordListRectangle &wlr) override;
   void setZoomrate (double zm) override;
   void setRotate (int rotate) override;
 
 private:
   ApvlvImage mImage{};
+
+  friend class ImageStrip;
 };
 
 bool imageSelectSearch (QImage *pix, double zm, int select,
@@ -24,12 +24,12 @@
  *  Author: Alf <naihe2010@126.com>
  */
 
+#include <QDebug>
 #include <algorithm>
 #include <cstdlib>
 #include <cstring>
-#include <fstream>
-#include <ranges>
-#include <sstream>
+#include <istream>
+#include <ostream>
 
 #include "ApvlvInfo.h"
 #include "ApvlvParams.h"
@@ -42,49 +42,44 @@ void
 ApvlvInfo::loadFile (std::string_view file)
 {
   mFileName = file;
+  mStore = AppendLog (mFileName);
 
-  ifstream is (mFileName, ios::in);
-  if (is.is_open ())
-    {
-      string line;
-
-      while (getline (is, line))
-        {
-          auto p = line.c_str ();
-
-          if (*p != '\''              /* the ' */
-              || !isdigit (*(p + 1))) /* the digit */
-            {
-              continue;
-            }
-
-          addPosition (p);
-        }
-
-      is.close ();
-    }
+  mStore.load ([this] (istream &is) {
+    string line;
+    if (!getline (is, line))
+      return false;
+    if (!line.empty () && line.back () == '\r')
+      line.pop_back ();
+
+    auto p = line.c_str ();
+    // a line of another kind is kept and counted as a replaced one
+    if (*p == '\''              /* the ' */
+        && isdigit (*(p + 1))) /* the digit */
+      addPosition (p);
+    return true;
+  });
+
+  // the lines of a document are appended, the last one is its position
+  if (mStore.needsCompaction (mInfoFiles.size ()))
+    update ();
 }
 
 bool
 ApvlvInfo::update ()
 {
-  ofstream os (mFileName, ios::out);
-  if (!os.is_open ())
-    {
-      return false;
-    }
-
-  int i = 0;
-  for (const auto &infofile : mInfoFiles)
-    {
-      os << "'" << i++ << "\t";
-      os << infofile.page << ':' << infofile.skip << "\t";
-      os << infofile.rate << "\t";
-      os << infofile.file << endl;
-    }
-
-  os.close ();
-  return true;
+  // "always" syncs every line, "compact" the compacted file only
+  auto mode = ApvlvParams::instance ()->get (StringParam::INFO_SYNC);
+  auto sync = mode != "never";
+  return mStore.rewrite (
+      mInfoFiles.size (),
+      [this] (ostream &os) {
+        size_t i = 0;
+        for (const auto &infofile : mInfoFiles)
+          {
+            writeLine (os, i++, infofile);
+          }
+      },
+      sync);
 }
 
 std::optional<InfoFile *>
@@ -93,18 +88,16 @@ ApvlvInfo::lastFile ()
   if (mInfoFiles.empty ())
     return nullopt;
   else
-    return &*(mInfoFiles.rbegin ());
+    return &mInfoFiles.back ();
 }
 
 optional<InfoFile *>
 ApvlvInfo::file (const string &filename)
 {
-  auto itr = std::ranges::find_if (
-      std::views::reverse (mInfoFiles),
-      [filename] (auto const &infofile) { return infofile.file == filename; });
-  if (itr != mInfoFiles.rend ())
+  auto itr = mIndex.find (filename);
+  if (itr != mIndex.end ())
     {
-      return &(*itr);
+      return &*itr->second;
     }
 
   return nullopt;
@@ -114,25 +107,57 @@ bool
 ApvlvInfo::updateFile (int page, int skip, double rate, const string &filename)
 {
   InfoFile infofile{ page, skip, rate, filename };
-  auto optinfofile = file (filename);
-  if (optinfofile)
+  insert (infofile);
+  if (!append (infofile))
+    return false;
+
+  if (mStore.needsCompaction (mInfoFiles.size ()))
+    return update ();
+  return true;
+}
+
+ApvlvInfo::ApvlvInfo () = default;
+
+void
+ApvlvInfo::insert (const InfoFile &infofile)
+{
+  auto itr = mIndex.find (infofile.file);
+  if (itr != mIndex.end ())
     {
-      *optinfofile.value () = infofile;
+      *itr->second = infofile;
+      mInfoFiles.splice (mInfoFiles.end (), mInfoFiles, itr->second);
+      return;
     }
-  else
+
+  mInfoFiles.push_back (infofile);
+  mIndex[infofile.file] = prev (mInfoFiles.end ());
+  auto max_info = ApvlvParams::instance ()->get (IntParam::MAX_INFO);
+  while (mInfoFiles.size () > static_cast<size_t> (std::max (max_info, 1)))
     {
-      mInfoFiles.push_back (infofile);
-      if (mInfoFiles.size () > mMaxInfo)
-        mInfoFiles.pop_front ();
+      mIndex.erase (mInfoFiles.front ().file);
+      mInfoFiles.pop_front ();
     }
+}
 
-  return update ();
+bool
+ApvlvInfo::append (const InfoFile &infofile)
+{
+  auto mode = ApvlvParams::instance ()->get (StringParam::INFO_SYNC);
+  auto sync = mode == "always";
+  return mStore.append (
+      [this, &infofile] (ostream &os) {
+        writeLine (os, mStore.records (), infofile);
+      },
+      sync);
 }
 
-ApvlvInfo::ApvlvInfo ()
+void
+ApvlvInfo::writeLine (ostream &os, size_t index, const InfoFile &infofile)
 {
-  mMaxInfo = ApvlvParams::instance ()->getIntOrDefault ("max_info",
-                                                        DEFAULT_MAX_INFO);
+  os << "'" << index << "\t";
+  os << infofile.page << ':' << infofile.skip << "\t";
+  os << infofile.rate << "\t";
+  os << infofile.file << "\n";
 }
 
 bool
@@ -199,8 +224,7 @@ ApvlvInfo::addPosition (const char *str)
       return false;
     }
 
-  auto fp = InfoFile{ page, skip, rate, p };
-  mInfoFiles.emplace_back (fp);
+  insert (InfoFile{ page, skip, rate, p });
   return true;
 }
 };
@@ -27,9 +27,13 @@
 #ifndef _APVLV_INFO_H_
 #define _APVLV_INFO_H_
 
-#include <deque>
+#include <iosfwd>
+#include <list>
 #include <optional>
 #include <string>
+#include <unordered_map>
+
+#include "ApvlvAppendLog.h"
 
 namespace apvlv
 {
@@ -42,14 +46,20 @@ struct InfoFile
   std::string file;
 };
 
-const int DEFAULT_MAX_INFO = 100;
-
+//
+// the last positions of the documents
+//
+// Every update is appended to the session file as a line, the file is
+// written again with one line of every document when the old lines are
+// the most of it.
+//
 class ApvlvInfo final
 {
 public:
   ApvlvInfo (const ApvlvInfo &) = delete;
   ApvlvInfo &operator= (const ApvlvInfo &) = delete;
   void loadFile (std::string_view file);
+  // writes the file again, a line of every document
   bool update ();
 
   std::optional<InfoFile *> lastFile ();
@@ -70,10 +80,17 @@ private:
 
   std::string mFileName{};
 
-  std::deque<InfoFile> mInfoFiles{};
-  std::deque<InfoFile>::size_type mMaxInfo{ DEFAULT_MAX_INFO };
+  // the most recently updated last
+  std::list<InfoFile> mInfoFiles{};
+  std::unordered_map<std::string, std::list<InfoFile>::iterator> mIndex{};
+
+  AppendLog mStore{};
 
   bool addPosition (const char *str);
+  void insert (const InfoFile &infofile);
+  bool append (const InfoFile &infofile);
+  static void writeLine (std::ostream &os, size_t index,
+                         const InfoFile &infofile);
 };
 };
 
@@ -24,17 +24,54 @@
  *  Author: Alf <naihe2010@126.com>
  */
 
+#include <QDateTime>
 #include <QFile>
 #include <QFileInfo>
-#include <QLoggingCategory>
-#include <QTime>
 #include <iostream>
 #include <string>
 
 #include "ApvlvLog.h"
+#include "ApvlvParams.h"
 
 namespace apvlv
 {
+using namespace std;
+
+Q_LOGGING_CATEGORY (lcSearch, "apvlv.search", QtInfoMsg)
+Q_LOGGING_CATEGORY (lcRender, "apvlv.render", QtInfoMsg)
+Q_LOGGING_CATEGORY (lcCompletion, "apvlv.completion", QtInfoMsg)
+
+// the idle writer looks at the queue that often
+const auto WRITE_INTERVAL = chrono::milliseconds (20);
+
+// the filter rules of a category at a level
+static QString
+levelRules (const string &name, const string &level)
+{
+  const char *const levels[] = { "debug", "info", "warning", "critical" };
+  auto index = 0;
+  while (index < 4 && level != levels[index])
+    index++;
+  if (index == 4)
+    return {};
+
+  QString rules;
+  for (auto i = 0; i < 4; ++i)
+    {
+      rules += QString::asprintf ("apvlv.%s.%s=%s\n", name.c_str (),
+                                  levels[i], i >= index ? "true" : "false");
+    }
+  return rules;
+}
+
+ApvlvLog::ApvlvLog ()
+{
+  for (size_t i = 0; i < QUEUE_SIZE; ++i)
+    {
+      mRecords[i].sequence.store (i, memory_order_relaxed);
+    }
+}
+
 void
 ApvlvLog::setLogFile (const std::string &path)
 {
@@ -54,16 +91,30 @@ ApvlvLog::setLogFile (const std::string &path)
       mTextStream.setDevice (&mFile);
     }
 
-  QLoggingCategory::setFilterRules ("qt.*=false\n"
-                                    "default.debug=true\n"
-                                    "default.*=true");
+  setFilterRules ();
+  if (!mWriter.joinable ())
+    mWriter = thread (&ApvlvLog::writerLoop, this);
   qInstallMessageHandler (ApvlvLog::logMessage);
 }
 
+void
+ApvlvLog::setFilterRules ()
+{
+  QString rules = "qt.*=false\n"
+                  "default.debug=true\n"
+                  "default.*=true\n";
+  auto params = ApvlvParams::instance ();
+  for (auto name : { "search", "render", "completion" })
+    {
+      auto level = params->getStringOrDefault (string ("log:") + name);
+      rules += levelRules (name, level);
+    }
+  QLoggingCategory::setFilterRules (rules);
+}
+
 void
 ApvlvLog::writeMessage (const QString &msg)
 {
-  std::lock_guard<std::mutex> lock (mMutex);
 #ifdef _DEBUG
   std::cout << msg.toStdString () << std::endl;
 #endif
@@ -80,6 +131,11 @@ ApvlvLog::writeMessage (const QString &msg)
 
 ApvlvLog::~ApvlvLog ()
 {
+  qInstallMessageHandler (nullptr);
+  mQuit.store (true);
+  if (mWriter.joinable ())
+    mWriter.join ();
+
   if (mFile.isOpen ())
     {
       mFile.close ();
@@ -94,22 +150,130 @@ ApvlvLog::instance ()
 }
 
 void
-ApvlvLog::logMessage (QtMsgType type, const QMessageLogContext &context,
-                      const QString &msg)
+ApvlvLog::flush ()
 {
-  auto now = QTime::currentTime ();
-  auto nowstr = now.toString ("hh:mm:ss.zzz");
-  QString log = nowstr + " ";
+  if (!mWriter.joinable ())
+    return;
 
-  if (context.file)
+  auto head = mHead.load (memory_order_acquire);
+  while (mTail.load (memory_order_acquire) < head && !mQuit.load ())
     {
-      auto filename = QFileInfo (context.file).fileName ().toStdString ();
-      log += QString::asprintf ("%s:%d ", filename.c_str (), context.line);
-      log += QString::asprintf ("%s ", context.function);
+      this_thread::sleep_for (1ms);
     }
-  log += msg;
+}
+
+bool
+ApvlvLog::push (QtMsgType type, const QMessageLogContext &context,
+                const QString &msg)
+{
+  // a bounded queue of many producers and one consumer
+  auto pos = mHead.load (memory_order_relaxed);
+  Record *record;
+  while (true)
+    {
+      record = &mRecords[pos % QUEUE_SIZE];
+      auto seq = record->sequence.load (memory_order_acquire);
+      auto diff = static_cast<intptr_t> (seq) - static_cast<intptr_t> (pos);
+      if (diff == 0)
+        {
+          if (mHead.compare_exchange_weak (pos, pos + 1,
+                                           memory_order_relaxed))
+            break;
+        }
+      else if (diff < 0)
+        {
+          mDropped.fetch_add (1, memory_order_relaxed);
+          return false;
+        }
+      else
+        {
+          pos = mHead.load (memory_order_relaxed);
+        }
+    }
+
+  record->time = QDateTime::currentMSecsSinceEpoch ();
+  record->type = type;
+  record->file = context.file;
+  record->line = context.line;
+  record->function = context.function;
+  record->msg = msg;
+  record->sequence.store (pos + 1, memory_order_release);
+  return true;
+}
+
+bool
+ApvlvLog::pop (Record &out)
+{
+  auto pos = mTail.load (memory_order_relaxed);
+  auto &record = mRecords[pos % QUEUE_SIZE];
+  if (record.sequence.load (memory_order_acquire) != pos + 1)
+    return false;
+
+  out.time = record.time;
+  out.type = record.type;
+  out.file = std::move (record.file);
+  out.line = record.line;
+  out.function = std::move (record.function);
+  out.msg = std::move (record.msg);
+  record.sequence.store (pos + QUEUE_SIZE, memory_order_release);
+  mTail.store (pos + 1, memory_order_release);
+  return true;
+}
+
+void
+ApvlvLog::writerLoop ()
+{
+  while (mQuit.load () == false)
+    {
+      if (!writeQueued ())
+        this_thread::sleep_for (WRITE_INTERVAL);
+    }
+
+  writeQueued ();
+}
+
+bool
+ApvlvLog::writeQueued ()
+{
+  auto written = false;
+  Record record;
+  while (pop (record))
+    {
+      auto time = QDateTime::fromMSecsSinceEpoch (record.time);
+      QString log = time.toString ("hh:mm:ss.zzz") + " ";
+      if (!record.file.isEmpty ())
+        {
+          auto filename = QFileInfo (record.file).fileName ().toStdString ();
+          log += QString::asprintf ("%s:%d ", filename.c_str (), record.line);
+          log += QString::asprintf ("%s ", record.function.constData ());
+        }
+      log += record.msg;
+      writeMessage (log);
+      written = true;
+    }
+
+  auto dropped = mDropped.exchange (0);
+  if (dropped > 0)
+    {
+      writeMessage (QString::asprintf ("%zu log messages dropped", dropped));
+      written = true;
+    }
+
+  if (written)
+    mTextStream.flush ();
+  return written;
+}
+
+void
+ApvlvLog::logMessage (QtMsgType type, const QMessageLogContext &context,
+                      const QString &msg)
+{
+  auto log = ApvlvLog::instance ();
+  log->push (type, context, msg);
 
-  ApvlvLog::instance ()->writeMessage (log);
+  // the application aborts after a fatal message
+  if (type == QtFatalMsg)
+    log->flush ();
 }
 }
 
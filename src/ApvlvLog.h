@@ -27,14 +27,30 @@
 #define _APVLV_LOG_H_
 
 #include <QFile>
+#include <QLoggingCategory>
 #include <QTextStream>
 #include <QtMessageHandler>
-#include <memory>
-#include <mutex>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <thread>
 
 namespace apvlv
 {
 
+// the messages of the hot loops, disabled below info unless the settings
+// log:search, log:render or log:completion lower them
+Q_DECLARE_LOGGING_CATEGORY (lcSearch)
+Q_DECLARE_LOGGING_CATEGORY (lcRender)
+Q_DECLARE_LOGGING_CATEGORY (lcCompletion)
+
+//
+// the log of apvlv
+//
+// A logging thread only queues the message, a writer thread formats and
+// writes it. The queue is bounded, a message is dropped when it is full
+// and the count of the dropped ones is written later.
+//
 class ApvlvLog final
 {
 public:
@@ -47,13 +63,47 @@ public:
   static void logMessage (QtMsgType type, const QMessageLogContext &context,
                           const QString &msg);
 
+  // the levels of the categories from the log:* settings
+  static void setFilterRules ();
+
+  // waits until the queued messages are written
+  void flush ();
+
+  static const size_t QUEUE_SIZE = 4096;
+
 private:
-  ApvlvLog () = default;
+  ApvlvLog ();
+
+  struct Record
+  {
+    // the position it is free for, or filled at plus 1
+    std::atomic<size_t> sequence;
+    qint64 time;
+    QtMsgType type;
+    // copied, the context of the JavaScript messages is temporary
+    QByteArray file;
+    int line;
+    QByteArray function;
+    QString msg;
+  };
+
+  bool push (QtMsgType type, const QMessageLogContext &context,
+             const QString &msg);
+  bool pop (Record &record);
+  void writerLoop ();
+  bool writeQueued ();
   void writeMessage (const QString &log);
 
   QFile mFile;
   QTextStream mTextStream;
-  std::mutex mMutex;
+
+  std::array<Record, QUEUE_SIZE> mRecords;
+  alignas (64) std::atomic<size_t> mHead{ 0 };
+  alignas (64) std::atomic<size_t> mTail{ 0 };
+  std::atomic<size_t> mDropped{ 0 };
+
+  std::thread mWriter;
+  std::atomic<bool> mQuit{ false };
 };
 
 };
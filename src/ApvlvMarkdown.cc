@@ -27,211 +27,106 @@
 
 #include <algorithm>
 #include <array>
+#include <cstring>
 #include <fstream>
 
 #include "ApvlvMarkdown.h"
 
-#include <qassert.h>
-
 namespace apvlv
 {
 using namespace std;
 
-MarkdownNode::MarkdownNode (const MarkdownNode &other)
-{
-  node_type = other.node_type;
-  list_type = other.list_type;
-  heading_level = other.heading_level;
-  literal = other.literal;
-  title = other.title;
-  url = other.url;
-  for (auto &child : other.children)
-    {
-      auto nchild = new MarkdownNode (*child);
-      children.push_back (unique_ptr<MarkdownNode> (nchild));
-    }
-}
-
-MarkdownNode::MarkdownNode (MarkdownNode &&other) noexcept
+void *
+MarkdownArena::allocate (size_t size, size_t align)
 {
-  node_type = other.node_type;
-  list_type = other.list_type;
-  heading_level = other.heading_level;
-  literal.swap (other.literal);
-  title.swap (other.title);
-  url.swap (other.url);
-  children.swap (other.children);
-}
-
-MarkdownNode &
-MarkdownNode::operator= (const MarkdownNode &other)
-{
-  node_type = other.node_type;
-  list_type = other.list_type;
-  heading_level = other.heading_level;
-  literal = other.literal;
-  title = other.title;
-  url = other.url;
-  for (const auto &child : other.children)
+  auto pad = (align - reinterpret_cast<uintptr_t> (mNext) % align) % align;
+  if (mNext == nullptr || pad + size > mLeft)
     {
-      auto nchild = new MarkdownNode (*child);
-      children.push_back (unique_ptr<MarkdownNode> (nchild));
+      auto length = std::max (BLOCK_SIZE, size + align);
+      mBlocks.emplace_back (make_unique<char[]> (length));
+      mNext = mBlocks.back ().get ();
+      mLeft = length;
+      pad = (align - reinterpret_cast<uintptr_t> (mNext) % align) % align;
     }
-  return *this;
-}
-
-MarkdownNode &
-MarkdownNode::operator= (MarkdownNode &&other) noexcept
-{
-  node_type = other.node_type;
-  list_type = other.list_type;
-  heading_level = other.heading_level;
-  literal.swap (other.literal);
-  title.swap (other.title);
-  url.swap (other.url);
-  children.swap (other.children);
-  return *this;
-}
-
-int
-MarkdownNode::childrenCount ()
-{
-  return static_cast<int> (children.size ());
-}
 
-MarkdownNode *
-MarkdownNode::childAt (int index)
-{
-  return children[index].get ();
+  auto ptr = mNext + pad;
+  mNext += pad + size;
+  mLeft -= pad + size;
+  return ptr;
 }
 
-void
-MarkdownNode::appendChildPtr (std::unique_ptr<MarkdownNode> ptr)
+string_view
+MarkdownArena::copy (string_view text)
 {
-  children.push_back (std::move (ptr));
-}
+  if (text.empty ())
+    return {};
 
-void
-MarkdownNode::appendChild (MarkdownNode *n)
-{
-  children.push_back (unique_ptr<MarkdownNode> (n));
+  auto ptr = static_cast<char *> (allocate (text.size (), 1));
+  memcpy (ptr, text.data (), text.size ());
+  return { ptr, text.size () };
 }
 
-void
-MarkdownNode::removeChild (MarkdownNode *n)
+static void
+appendText (const MarkdownNode *node, string &text)
 {
-  auto iter = std::find_if (children.begin (), children.end (),
-                            [n] (const auto &i) { return i.get () == n; });
-  if (iter != children.end ())
+  switch (node->node_type)
     {
-      children.erase (iter);
+    case CMARK_NODE_TEXT:
+    case CMARK_NODE_CODE:
+    case CMARK_NODE_HTML_INLINE:
+      text += node->literal;
+      break;
+    // a long line is wrapped by the old writer
+    case CMARK_NODE_SOFTBREAK:
+      text += ' ';
+      break;
+    case CMARK_NODE_LINEBREAK:
+      text += '\n';
+      break;
+    default:
+      for (auto i = 0; i < node->children_count; ++i)
+        {
+          appendText (node->children[i], text);
+        }
     }
 }
 
-std::vector<std::string>
-MarkdownNode::getListTexts ()
+string
+MarkdownNode::text () const
 {
-  std::vector<std::string> texts;
-  for (const auto &i : children)
-    {
-      auto p = i->children.front ().get ();
-      auto t = p->children.front ().get ();
-      texts.push_back (t->literal);
-    }
-  return texts;
+  string res;
+  appendText (this, res);
+  return res;
 }
 
-void
-MarkdownNode::setListTexts (cmark_list_type _type,
-                            const std::vector<std::string> &texts)
+vector<string>
+MarkdownNode::getListTexts () const
 {
-  children.clear ();
-  node_type = CMARK_NODE_LIST;
-  list_type = _type;
-  for (const auto &text : texts)
+  vector<string> texts;
+  for (auto i = 0; i < children_count; ++i)
     {
-      auto i = create (this, CMARK_NODE_ITEM);
-      auto p = create (i, CMARK_NODE_PARAGRAPH);
-      auto t = create (p, CMARK_NODE_TEXT);
-      t->literal = text;
+      auto p = children[i]->childAt (0);
+      texts.push_back (p ? p->text () : string{});
     }
+  return texts;
 }
 
-void
-MarkdownNode::setNoListTexts (const std::vector<std::string> &texts)
-{
-  setListTexts (CMARK_NO_LIST, texts);
-}
-
-void
-MarkdownNode::setBulletListTexts (const std::vector<std::string> &texts)
-{
-  setListTexts (CMARK_BULLET_LIST, texts);
-}
-
-void
-MarkdownNode::setOrderedListTexts (const std::vector<std::string> &texts)
-{
-  setListTexts (CMARK_ORDERED_LIST, texts);
-}
-
-std::pair<int, std::string>
-MarkdownNode::headText ()
+pair<int, string>
+MarkdownNode::headText () const
 {
-  if (node_type != CMARK_NODE_HEADING || childrenCount () < 1)
+  if (node_type != CMARK_NODE_HEADING)
     {
       throw std::invalid_argument ("MarkdownNode::headText");
     }
 
-  auto n = childAt (0);
-  std::pair<int, std::string> res;
-  res.first = n->heading_level;
-  res.second = n->literal;
-  return res;
-}
-
-void
-MarkdownNode::appendHeadText (int _level, const std::string &_text)
-{
-  auto h = create (this, CMARK_NODE_HEADING);
-  h->heading_level = _level;
-  auto ht = create (h, CMARK_NODE_TEXT);
-  ht->literal = _text;
-}
-
-void
-MarkdownNode::appendHeadAndList (int _level, cmark_list_type _type,
-                                 const HeadAndList &headAndList)
-{
-  appendHeadText (_level, headAndList.first);
-  auto list = create (this, CMARK_NODE_LIST);
-  list->setListTexts (_type, headAndList.second);
-}
-
-void
-MarkdownNode::appendHeadAndNoList (int _level, const HeadAndList &headAndList)
-{
-  appendHeadAndList (_level, CMARK_NO_LIST, headAndList);
-}
-
-void
-MarkdownNode::appendHeadAndBulletList (int _level,
-                                       const HeadAndList &headAndList)
-{
-  appendHeadAndList (_level, CMARK_BULLET_LIST, headAndList);
-}
-
-void
-MarkdownNode::appendHeadAndOrderedList (int _level,
-                                        const HeadAndList &headAndList)
-{
-  appendHeadAndList (_level, CMARK_ORDERED_LIST, headAndList);
+  return { heading_level, text () };
 }
 
-std::unique_ptr<MarkdownNode>
-MarkdownNode::fromCmarkNode (cmark_node *node)
+MarkdownNode *
+MarkdownNode::fromCmarkNode (cmark_node *node, MarkdownArena &arena)
 {
-  auto mn = make_unique<MarkdownNode> (cmark_node_get_type (node));
+  auto mn = arena.make<MarkdownNode> ();
+  mn->node_type = cmark_node_get_type (node);
   switch (mn->node_type)
     {
     case CMARK_NODE_HEADING:
@@ -242,113 +137,36 @@ MarkdownNode::fromCmarkNode (cmark_node *node)
       break;
     case CMARK_NODE_IMAGE:
     case CMARK_NODE_LINK:
-      mn->title = cmark_node_get_title (node);
-      mn->url = cmark_node_get_url (node);
+      mn->title = arena.copy (cmark_node_get_title (node));
+      mn->url = arena.copy (cmark_node_get_url (node));
       break;
     default:
       auto l = cmark_node_get_literal (node);
       if (l)
-        mn->literal = l;
+        mn->literal = arena.copy (l);
     }
+
   for (auto n = cmark_node_first_child (node); n != nullptr;
        n = cmark_node_next (n))
     {
-      auto cmn = MarkdownNode::fromCmarkNode (n);
-      mn->children.emplace_back (std::move (cmn));
-    }
-  return mn;
-}
-
-MarkdownNode *
-MarkdownNode::create (MarkdownNode *parent, cmark_node_type _type,
-                      string_view literal)
-{
-  Q_ASSERT (parent != nullptr);
-  auto mn = make_unique<MarkdownNode> (_type);
-  mn->literal = literal;
-  auto node = mn.get ();
-  parent->appendChildPtr (std::move (mn));
-  return node;
-}
-
-cmark_node *
-MarkdownNode::toCmarkNode ()
-{
-  auto doc = cmark_node_new (node_type);
-  switch (node_type)
-    {
-    case CMARK_NODE_HEADING:
-      cmark_node_set_heading_level (doc, heading_level);
-      break;
-
-    case CMARK_NODE_LIST:
-      cmark_node_set_list_type (doc, list_type);
-      break;
-
-    case CMARK_NODE_IMAGE:
-    case CMARK_NODE_LINK:
-      cmark_node_set_title (doc, title.c_str ());
-      cmark_node_set_url (doc, url.c_str ());
-      break;
-
-    default:
-      break;
+      mn->children_count++;
     }
-  cmark_node_set_literal (doc, literal.c_str ());
-
-  for (auto const &child : children)
+  mn->children = arena.makeArray<MarkdownNode *> (mn->children_count);
+  auto index = 0;
+  for (auto n = cmark_node_first_child (node); n != nullptr;
+       n = cmark_node_next (n))
     {
-      auto n = child.get ();
-      auto d = n->toCmarkNode ();
-      cmark_node_append_child (doc, d);
+      mn->children[index++] = MarkdownNode::fromCmarkNode (n, arena);
     }
-
-  return doc;
+  return mn;
 }
 
-Markdown::Markdown ()
-    : mRoot{ make_unique<MarkdownNode> (CMARK_NODE_DOCUMENT) }
+Markdown::Markdown () : mArena{ make_unique<MarkdownArena> () }
 {
+  mRoot = mArena->make<MarkdownNode> ();
   mRoot->node_type = CMARK_NODE_DOCUMENT;
 }
 
-Markdown::Markdown (const Markdown &other)
-{
-  if (this != &other)
-    {
-      mRoot = make_unique<MarkdownNode> (MarkdownNode (*other.mRoot));
-    }
-}
-
-Markdown::Markdown (Markdown &&other) noexcept
-{
-  if (this != &other)
-    {
-      mRoot.swap (other.mRoot);
-    }
-}
-
-Markdown &
-Markdown::operator= (const Markdown &other)
-{
-  if (this != &other)
-    {
-      mRoot = make_unique<MarkdownNode> (MarkdownNode (*other.mRoot));
-    }
-
-  return *this;
-}
-
-Markdown &
-Markdown::operator= (Markdown &&other) noexcept
-{
-  if (this != &other)
-    {
-      mRoot.swap (other.mRoot);
-    }
-  return *this;
-}
-
 bool
 Markdown::loadFromFile (const std::string &filename)
 {
@@ -382,7 +200,8 @@ Markdown::loadFromStream (std::istream &is)
 
   if (doc)
     {
-      mRoot = MarkdownNode::fromCmarkNode (doc);
+      mArena = make_unique<MarkdownArena> ();
+      mRoot = MarkdownNode::fromCmarkNode (doc, *mArena);
       cmark_node_free (doc);
       return true;
     }
@@ -392,33 +211,220 @@ Markdown::loadFromStream (std::istream &is)
     }
 }
 
-bool
-Markdown::saveToFile (const std::string &filename)
+MarkdownNode *
+Markdown::root () const
+{
+  return mRoot;
+}
+
+void
+MarkdownWriter::thematicBreak ()
+{
+  beginBlock ();
+  mOs << "-----\n\n";
+}
+
+void
+MarkdownWriter::heading (int level, string_view text)
+{
+  beginBlock ();
+  mOs << string (level, '#') << " ";
+  inlines (text, mIndent);
+  mOs << "\n\n";
+}
+
+void
+MarkdownWriter::paragraph (const vector<string_view> &lines)
 {
-  ofstream ofs (filename, ofstream::binary);
-  if (!ofs.is_open ())
+  beginBlock ();
+  for (size_t i = 0; i < lines.size (); ++i)
     {
-      return false;
+      if (i > 0)
+        mOs << "  \n" << mIndent;
+      inlines (lines[i], mIndent);
     }
+  mOs << "\n\n";
+}
 
-  return saveToStream (ofs);
+void
+MarkdownWriter::blockQuote (string_view text)
+{
+  beginBlock ();
+  mOs << ">";
+  if (!text.empty ())
+    {
+      mOs << " ";
+      inlines (text, mIndent + "> ");
+    }
+  mOs << "\n\n";
 }
 
-bool
-Markdown::saveToStream (std::ostream &os)
+void
+MarkdownWriter::codeBlock (string_view text)
+{
+  // longer than every run of backticks in the text
+  size_t run = 0, longest = 0;
+  for (auto c : text)
+    {
+      run = c == '`' ? run + 1 : 0;
+      longest = std::max (longest, run);
+    }
+  auto fence = string (std::max<size_t> (3, longest + 1), '`');
+
+  // the parsed literal is the text and a newline
+  beginBlock ();
+  mOs << fence << "\n";
+  size_t begin = 0;
+  while (true)
+    {
+      auto end = text.find ('\n', begin);
+      auto line = text.substr (begin, end == string_view::npos
+                                          ? string_view::npos
+                                          : end - begin);
+      if (!line.empty ())
+        mOs << mIndent << line;
+      mOs << "\n";
+      if (end == string_view::npos)
+        break;
+      begin = end + 1;
+    }
+  mOs << mIndent << fence << "\n\n";
+}
+
+void
+MarkdownWriter::bulletItem (string_view text)
 {
-  auto doc = mRoot->toCmarkNode ();
-  auto text = cmark_render_commonmark (doc, CMARK_OPT_DEFAULT, 78);
-  os << text;
-  free (text);
-  cmark_node_free (doc);
-  return false;
+  beginBlock (true);
+  mOs << "-";
+  if (!text.empty ())
+    {
+      mOs << " ";
+      inlines (text, mIndent + "  ");
+    }
+  mOs << "\n";
+  mInList = true;
 }
 
-MarkdownNode *
-Markdown::root () const
+void
+MarkdownWriter::beginItem (int number)
+{
+  if (mInList)
+    endList ();
+
+  auto marker = to_string (number) + ". ";
+  mOs << mIndent << marker;
+  mIndent.append (marker.size (), ' ');
+  mMarkers.push_back (marker.size ());
+  mAtMarker = true;
+}
+
+void
+MarkdownWriter::endItem ()
+{
+  if (mInList)
+    endList ();
+
+  // an empty item
+  if (mAtMarker)
+    {
+      mOs << "\n\n";
+      mAtMarker = false;
+    }
+
+  mIndent.resize (mIndent.size () - mMarkers.back ());
+  mMarkers.pop_back ();
+}
+
+void
+MarkdownWriter::beginBlock (bool bullet)
 {
-  return mRoot.get ();
+  if (mInList && !bullet)
+    endList ();
+
+  if (mAtMarker)
+    mAtMarker = false;
+  else
+    mOs << mIndent;
+}
+
+void
+MarkdownWriter::endList ()
+{
+  mOs << "\n";
+  mInList = false;
+}
+
+// at the start of a line, a character to begin a block
+static bool
+isBlockStart (string_view line)
+{
+  if (line.empty () || line[0] == '\0')
+    return false;
+
+  if (strchr ("#>-+*=`~<", line[0]) != nullptr)
+    return true;
+
+  // an ordered list item
+  auto digits = line.find_first_not_of ("0123456789");
+  return digits > 0 && digits != string_view::npos
+         && (line[digits] == '.' || line[digits] == ')');
+}
+
+void
+MarkdownWriter::inlines (string_view text, string_view indent)
+{
+  // the newlines are hard breaks, or entities where a break would make a
+  // blank line or an empty one
+  auto content = false;
+  size_t begin = 0;
+  while (true)
+    {
+      auto end = text.find ('\n', begin);
+      auto line = text.substr (begin, end == string_view::npos
+                                          ? string_view::npos
+                                          : end - begin);
+      if (begin > 0)
+        {
+          if (content && !line.empty ())
+            {
+              mOs << "\\\n" << indent;
+              content = false;
+            }
+          else
+            {
+              mOs << "&#10;";
+              content = true;
+            }
+        }
+
+      auto escape = string_view::npos;
+      if (!content && isBlockStart (line))
+        escape = line[0] >= '0' && line[0] <= '9'
+                     ? line.find_first_not_of ("0123456789")
+                     : 0;
+
+      for (size_t i = 0; i < line.size (); ++i)
+        {
+          auto c = line[i];
+          // the spaces at both ends of a line are stripped
+          if ((c == ' ' || c == '\t')
+              && ((i == 0 && !content) || i + 1 == line.size ()))
+            mOs << (c == ' ' ? "&#32;" : "&#9;");
+          else if (c == '\r')
+            mOs << "&#13;";
+          else if (i == escape
+                   || (c != '\0' && strchr ("\\`*_[]<&", c) != nullptr))
+            mOs << '\\' << c;
+          else
+            mOs << c;
+        }
+
+      if (!line.empty ())
+        content = true;
+      if (end == string_view::npos)
+        break;
+      begin = end + 1;
+    }
 }
 
 }
@@ -29,56 +29,99 @@
 #define _APVLV_MARKDOWN_H_
 
 #include <cmark.h>
-#include <list>
+#include <istream>
 #include <memory>
-#include <queue>
+#include <new>
+#include <ostream>
 #include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
 
 namespace apvlv
 {
+
+//
+// a bump allocator of the markdown documents, everything is freed with
+// the arena at once
+//
+class MarkdownArena
+{
+public:
+  MarkdownArena () = default;
+  MarkdownArena (const MarkdownArena &other) = delete;
+  MarkdownArena &operator= (const MarkdownArena &other) = delete;
+
+  void *allocate (size_t size, size_t align);
+
+  // the objects are never destroyed
+  template <typename T>
+  T *
+  make ()
+  {
+    static_assert (std::is_trivially_destructible_v<T>);
+    return new (allocate (sizeof (T), alignof (T))) T{};
+  }
+
+  template <typename T>
+  T *
+  makeArray (size_t count)
+  {
+    static_assert (std::is_trivially_destructible_v<T>);
+    auto array = static_cast<T *> (allocate (sizeof (T) * count, alignof (T)));
+    for (size_t i = 0; i < count; ++i)
+      new (array + i) T{};
+    return array;
+  }
+
+  std::string_view copy (std::string_view text);
+
+private:
+  static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+  std::vector<std::unique_ptr<char[]>> mBlocks;
+  char *mNext{ nullptr };
+  size_t mLeft{ 0 };
+};
+
+//
+// a node of a parsed document, it and its texts live in the arena of the
+// document
+//
 struct MarkdownNode
 {
-  cmark_node_type node_type{ CMARK_NODE_TEXT };
+  cmark_node_type node_type{ CMARK_NODE_NONE };
   cmark_list_type list_type{ CMARK_NO_LIST };
   int heading_level{ 1 };
-  std::string literal;
-  std::string title;
-  std::string url;
-  std::vector<std::unique_ptr<MarkdownNode>> children;
-
-  explicit MarkdownNode (cmark_node_type _type) : node_type (_type) {};
-  ~MarkdownNode () = default;
-  MarkdownNode (const MarkdownNode &other);
-  MarkdownNode (MarkdownNode &&other) noexcept;
-  MarkdownNode &operator= (const MarkdownNode &other);
-  MarkdownNode &operator= (MarkdownNode &&other) noexcept;
-
-  int childrenCount ();
-  MarkdownNode *childAt (int index);
-  void appendChildPtr (std::unique_ptr<MarkdownNode> ptr);
-  void appendChild (MarkdownNode *n);
-  void removeChild (MarkdownNode *n);
-
-  std::vector<std::string> getListTexts ();
-  void setListTexts (cmark_list_type _type,
-                     const std::vector<std::string> &texts);
-  void setNoListTexts (const std::vector<std::string> &texts);
-  void setBulletListTexts (const std::vector<std::string> &texts);
-  void setOrderedListTexts (const std::vector<std::string> &texts);
-
-  using HeadAndList = std::pair<std::string, std::vector<std::string>>;
-  std::pair<int, std::string> headText ();
-  void appendHeadText (int _level, const std::string &_text);
-  void appendHeadAndList (int _level, cmark_list_type _type,
-                          const HeadAndList &headAndList);
-  void appendHeadAndNoList (int _level, const HeadAndList &headAndList);
-  void appendHeadAndBulletList (int _level, const HeadAndList &headAndList);
-  void appendHeadAndOrderedList (int _level, const HeadAndList &headAndList);
-
-  static std::unique_ptr<MarkdownNode> fromCmarkNode (cmark_node *node);
-  static MarkdownNode *create (MarkdownNode *parent, cmark_node_type _type,
-                               std::string_view literal = "");
-  cmark_node *toCmarkNode ();
+  std::string_view literal;
+  std::string_view title;
+  std::string_view url;
+  MarkdownNode **children{ nullptr };
+  int children_count{ 0 };
+
+  [[nodiscard]] int
+  childrenCount () const
+  {
+    return children_count;
+  }
+
+  // nullptr when out of range
+  [[nodiscard]] MarkdownNode *
+  childAt (int index) const
+  {
+    if (index < 0 || index >= children_count)
+      return nullptr;
+    return children[index];
+  }
+
+  // the inline texts of a block, the line breaks as newlines
+  [[nodiscard]] std::string text () const;
+
+  [[nodiscard]] std::vector<std::string> getListTexts () const;
+
+  [[nodiscard]] std::pair<int, std::string> headText () const;
+
+  static MarkdownNode *fromCmarkNode (cmark_node *node, MarkdownArena &arena);
 };
 
 class Markdown
@@ -86,15 +129,11 @@ class Markdown
 public:
   Markdown ();
   ~Markdown () = default;
-  Markdown (const Markdown &other);
-  Markdown (Markdown &&other) noexcept;
-  Markdown &operator= (const Markdown &other);
-  Markdown &operator= (Markdown &&other) noexcept;
+  Markdown (const Markdown &other) = delete;
+  Markdown &operator= (const Markdown &other) = delete;
 
   bool loadFromFile (const std::string &filename);
   bool loadFromStream (std::istream &is);
-  bool saveToFile (const std::string &filename);
-  bool saveToStream (std::ostream &os);
   [[nodiscard]] MarkdownNode *root () const;
   static std::unique_ptr<Markdown>
   create ()
@@ -103,7 +142,45 @@ public:
   }
 
 private:
-  std::unique_ptr<MarkdownNode> mRoot;
+  // the nodes are freed with the arena
+  std::unique_ptr<MarkdownArena> mArena;
+  MarkdownNode *mRoot;
+};
+
+//
+// writes a document without building it, the texts are escaped to be
+// parsed back as they are
+//
+// The blocks after beginItem are in the item until endItem, the first
+// of them is written after the marker.
+//
+class MarkdownWriter
+{
+public:
+  explicit MarkdownWriter (std::ostream &os) : mOs (os) {}
+
+  void thematicBreak ();
+  void heading (int level, std::string_view text);
+  // the lines are joined by hard breaks
+  void paragraph (const std::vector<std::string_view> &lines);
+  void blockQuote (std::string_view text);
+  void codeBlock (std::string_view text);
+  // one item of a bullet list of texts
+  void bulletItem (std::string_view text);
+
+  void beginItem (int number);
+  void endItem ();
+
+private:
+  void beginBlock (bool bullet = false);
+  void endList ();
+  void inlines (std::string_view text, std::string_view indent);
+
+  std::ostream &mOs;
+  std::string mIndent;
+  std::vector<size_t> mMarkers;
+  bool mAtMarker{ false };
+  bool mInList{ false };
 };
 
 }
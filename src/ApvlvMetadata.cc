@@ -0,0 +1,315 @@
+/*
+ * This file is part of the apvlv package
+ *
+ * Copyright (C) 2008 Alf.
+ *
+ * Contact: Alf <naihe2010@126.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2.0 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+/* @CPPFILE ApvlvMetadata.cc
+ *
+ *  Author: Alf <naihe2010@126.com>
+ */
+
+#include <QBuffer>
+#include <QDebug>
+#include <QImage>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#include "ApvlvFile.h"
+#include "ApvlvFileIndex.h"
+#include "ApvlvMetadata.h"
+#include "ApvlvParams.h"
+#include "ApvlvUtil.h"
+
+namespace apvlv
+{
+
+using namespace std;
+
+const char *const STORE_HEADER = "apvlv-metadata 1";
+
+// returns the offset of the cover
+static streamoff
+writeRecord (ostream &os, const string &path, const FileMetadata &meta,
+             const string &jpeg)
+{
+  os << "file " << meta.mtime << " " << meta.size << " " << meta.pages << " "
+     << path.size () << " " << meta.title.size () << " "
+     << meta.author.size () << " " << jpeg.size () << "\n"
+     << path << meta.title << meta.author;
+  auto offset = static_cast<streamoff> (os.tellp ());
+  os << jpeg << "\n";
+  return offset;
+}
+
+MetadataCache::MetadataCache () : mStore (storePath (), STORE_HEADER)
+{
+  loadStore ();
+}
+
+MetadataCache::~MetadataCache ()
+{
+  mQuit.store (true);
+  for (auto &task : mTasks)
+    {
+      task.join ();
+    }
+}
+
+shared_ptr<const FileMetadata>
+MetadataCache::find (const string &path, int64_t mtime, int64_t size)
+{
+  lock_guard<mutex> lock (mMutex);
+  auto itr = mEntries.find (path);
+  if (itr == mEntries.end () || itr->second->mtime != mtime
+      || itr->second->size != size)
+    return nullptr;
+  return itr->second;
+}
+
+string
+MetadataCache::cover (const FileMetadata &meta)
+{
+  if (meta.coverSize == 0)
+    return {};
+
+  // the records are only appended, an offset is valid until a compaction
+  ifstream ifs{ mStore.path (), ios::binary };
+  string bytes;
+  if (!ifs.is_open () || !ifs.seekg (meta.coverOffset)
+      || !AppendLog::readField (ifs, meta.coverSize, bytes))
+    return {};
+  return bytes;
+}
+
+void
+MetadataCache::request (const vector<string> &paths, bool visible)
+{
+  auto params = ApvlvParams::instance ();
+  if (!params->get (BoolParam::METADATA_BACKGROUND))
+    return;
+
+  lock_guard<mutex> lock (mMutex);
+  if (visible)
+    {
+      mVisible.assign (paths.begin (), paths.end ());
+    }
+  else
+    {
+      for (auto const &path : paths)
+        {
+          if (mQueued.insert (path).second)
+            mQueue.push_back (path);
+        }
+    }
+
+  auto count = params->get (IntParam::METADATA_THREADS);
+  auto limit = static_cast<int> (thread::hardware_concurrency ());
+  count = std::clamp (count, 1, std::max (limit, 1));
+  mWorkers.store (count);
+  for (auto i = static_cast<int> (mTasks.size ()); i < count; ++i)
+    {
+      mTasks.emplace_back (&MetadataCache::workerLoop, this, i);
+    }
+}
+
+void
+MetadataCache::workerLoop (int index)
+{
+  while (mQuit.load () == false)
+    {
+      string path;
+      if (index < mWorkers.load () && pop (path))
+        {
+          extract (path);
+        }
+      else
+        {
+          this_thread::sleep_for (100ms);
+        }
+    }
+}
+
+bool
+MetadataCache::pop (string &path)
+{
+  lock_guard<mutex> lock (mMutex);
+  auto &queue = mVisible.empty () ? mQueue : mVisible;
+  if (queue.empty ())
+    return false;
+
+  path = std::move (queue.front ());
+  queue.pop_front ();
+  if (&queue == &mQueue)
+    mQueued.erase (path);
+  return true;
+}
+
+void
+MetadataCache::extract (const string &path)
+{
+  DirectoryScanner::Entry status;
+  if (!DirectoryScanner::status (path, status)
+      || status.type != FileIndexType::FILE)
+    return;
+
+  {
+    // a file may be requested twice, by the visible rows and the others
+    lock_guard<mutex> lock (mMutex);
+    auto itr = mEntries.find (path);
+    if (itr != mEntries.end () && itr->second->mtime == status.mtime
+        && itr->second->size == status.size)
+      return;
+    if (!mExtracting.insert (path).second)
+      return;
+  }
+
+  auto meta = make_shared<FileMetadata> ();
+  string jpeg;
+  meta->mtime = status.mtime;
+  meta->size = status.size;
+  auto file = FileFactory::loadFile (path);
+  if (file)
+    {
+      meta->pages = file->sum ();
+      meta->title = file->getMetadata ().title;
+      meta->author = file->getMetadata ().author;
+      jpeg = coverImage (file.get ());
+    }
+  else
+    {
+      qDebug () << "can't load metadata of " << QString::fromLocal8Bit (path);
+    }
+
+  {
+    lock_guard<mutex> lock (mMutex);
+    appendStore (path, *meta, jpeg);
+    mEntries[path] = std::move (meta);
+    mExtracting.erase (path);
+  }
+  emit extracted (QString::fromLocal8Bit (path));
+}
+
+string
+MetadataCache::coverImage (File *file)
+{
+  QImage image;
+  auto const &cover = file->getCover ();
+  if (!cover.content.empty ())
+    {
+      image.loadFromData (QByteArray::fromStdString (cover.content));
+    }
+  else if (file->getDisplayType () == DISPLAY_TYPE::IMAGE && file->sum () > 0)
+    {
+      auto size = file->pageSizeF (0, 0);
+      if (size.height > 0)
+        file->pageRenderToImage (0, COVER_HEIGHT / size.height, 0, &image);
+    }
+
+  if (image.isNull ())
+    return {};
+
+  image = image.scaledToHeight (COVER_HEIGHT, Qt::SmoothTransformation);
+  QByteArray bytes;
+  QBuffer buffer (&bytes);
+  buffer.open (QIODevice::WriteOnly);
+  image.save (&buffer, "JPG", 80);
+  return bytes.toStdString ();
+}
+
+string
+MetadataCache::storePath ()
+{
+  return CacheDir + PATH_SEP_S + "metadata";
+}
+
+void
+MetadataCache::loadStore ()
+{
+  mStore.load ([this] (istream &is) { return readRecord (is); });
+  if (!mStore.needsCompaction (mEntries.size ()))
+    return;
+
+  // the covers are copied from the old store, they move in the new one
+  unordered_map<string, shared_ptr<const FileMetadata>> entries;
+  auto written = mStore.rewrite (mEntries.size (), [&] (ostream &os) {
+    for (auto const &[path, entry] : mEntries)
+      {
+        auto meta = make_shared<FileMetadata> (*entry);
+        auto jpeg = cover (*entry);
+        meta->coverOffset = writeRecord (os, path, *meta, jpeg);
+        entries.emplace (path, std::move (meta));
+      }
+  });
+  if (written)
+    mEntries = std::move (entries);
+}
+
+bool
+MetadataCache::readRecord (istream &is)
+{
+  string line;
+  if (!getline (is, line))
+    return false;
+
+  stringstream ss{ line };
+  string tag;
+  FileMetadata meta;
+  size_t path_length, title_length, author_length, cover_length;
+  ss >> tag >> meta.mtime >> meta.size >> meta.pages >> path_length
+      >> title_length >> author_length >> cover_length;
+  if (ss.fail () || tag != "file")
+    return false;
+
+  string path;
+  if (!AppendLog::readField (is, path_length, path)
+      || !AppendLog::readField (is, title_length, meta.title)
+      || !AppendLog::readField (is, author_length, meta.author)
+      || cover_length > AppendLog::FIELD_MAX)
+    return false;
+
+  // only the offset of the cover is read
+  meta.coverOffset = is.tellg ();
+  meta.coverSize = cover_length;
+  is.seekg (static_cast<streamoff> (cover_length), ios::cur);
+  if (is.get () != '\n')
+    return false;
+
+  mEntries[path] = make_shared<FileMetadata> (std::move (meta));
+  return true;
+}
+
+void
+MetadataCache::appendStore (const string &path, FileMetadata &meta,
+                            const string &jpeg)
+{
+  streamoff offset = 0;
+  auto written = mStore.append ([&] (ostream &os) {
+    offset = writeRecord (os, path, meta, jpeg);
+  });
+  meta.coverOffset = offset;
+  meta.coverSize = written ? jpeg.size () : 0;
+}
+
+}
+
+// Local Variables:
+// mode: c++
+// End:
@@ -0,0 +1,140 @@
+/*
+ * This file is part of the apvlv package
+ *
+ * Copyright (C) 2008 Alf.
+ *
+ * Contact: Alf <naihe2010@126.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2.0 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+/* @CPPFILE ApvlvMetadata.h
+ *
+ *  Author: Alf <naihe2010@126.com>
+ */
+
+#ifndef _APVLV_METADATA_H_
+#define _APVLV_METADATA_H_
+
+#include <QObject>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <ios>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "ApvlvAppendLog.h"
+
+namespace apvlv
+{
+
+class File;
+
+//
+// what the library panel shows of a document without opening it, valid
+// while the file has the same mtime and size
+//
+struct FileMetadata
+{
+  std::int64_t mtime{ 0 };
+  std::int64_t size{ 0 };
+  // 0 when the file can't be loaded
+  int pages{ 0 };
+  std::string title;
+  std::string author;
+  // offset and length of the JPEG of the cover in the store, 0 if none
+  std::streamoff coverOffset{ 0 };
+  std::size_t coverSize{ 0 };
+};
+
+//
+// the metadata of the library files, extracted by a bounded pool and
+// kept in one file in the cache directory
+//
+// The visible rows of the Directory panel are extracted before the other
+// requests, they are replaced on every scroll. Only the offsets of the
+// covers are kept, a cover is read from the store when it is shown.
+//
+class MetadataCache final : public QObject
+{
+  Q_OBJECT
+public:
+  static MetadataCache *
+  instance ()
+  {
+    static MetadataCache inst;
+    return &inst;
+  }
+
+  ~MetadataCache () override;
+
+  // nullptr when the file is unknown or has changed
+  std::shared_ptr<const FileMetadata> find (const std::string &path,
+                                            std::int64_t mtime,
+                                            std::int64_t size);
+  // the JPEG of the cover, empty if none
+  std::string cover (const FileMetadata &meta);
+
+  void request (const std::vector<std::string> &paths, bool visible);
+
+  // the height of the cover thumbnails
+  static const int COVER_HEIGHT = 128;
+
+signals:
+  // emitted by a worker thread
+  void extracted (const QString &path);
+
+private:
+  MetadataCache ();
+
+  // the workers beyond the threads setting idle
+  void workerLoop (int index);
+  bool pop (std::string &path);
+  void extract (const std::string &path);
+  static std::string coverImage (File *file);
+
+  static std::string storePath ();
+  void loadStore ();
+  bool readRecord (std::istream &is);
+  void appendStore (const std::string &path, FileMetadata &meta,
+                    const std::string &jpeg);
+
+  std::mutex mMutex;
+  std::unordered_map<std::string, std::shared_ptr<const FileMetadata>>
+      mEntries;
+  AppendLog mStore;
+  std::deque<std::string> mVisible;
+  std::deque<std::string> mQueue;
+  std::unordered_set<std::string> mQueued;
+  std::unordered_set<std::string> mExtracting;
+
+  std::vector<std::thread> mTasks;
+  std::atomic<int> mWorkers{ 0 };
+  std::atomic<bool> mQuit{ false };
+};
+
+}
+
+#endif
+
+/* Local Variables: */
+/* mode: c++ */
+/* End: */
@@ -27,18 +27,53 @@
 
 #include <QDir>
 #include <cmark.h>
+#include <algorithm>
 #include <filesystem>
 #include <fstream>
+#include <sstream>
 
 #include "ApvlvFile.h"
 #include "ApvlvMarkdown.h"
 #include "ApvlvNote.h"
+#include "ApvlvTrace.h"
 #include "ApvlvUtil.h"
 
 namespace apvlv
 {
 using namespace std;
 
+// the quiet time before a changed note is written
+const auto NOTE_WRITE_DELAY = chrono::seconds (1);
+
+// a longer journal field is a broken journal
+const size_t JOURNAL_FIELD_MAX = 16 * 1024 * 1024;
+
+// the writable note of every markdown file
+static mutex NoteOwnersMutex;
+static unordered_map<string, Note *> NoteOwners;
+
+// a location is 3 fields of the journal, the numbers as the markdown
+// has them, the path and the anchor
+static void
+locationFields (const Location &loc, vector<string> &fields)
+{
+  stringstream ss;
+  ss << loc.page << " " << loc.x << " " << loc.y << " " << loc.offset;
+  fields.push_back (ss.str ());
+  fields.push_back (loc.path);
+  fields.push_back (loc.anchor);
+}
+
+static void
+locationFromFields (const vector<string> &fields, size_t index,
+                    Location &loc)
+{
+  stringstream ss{ fields[index] };
+  ss >> loc.page >> loc.x >> loc.y >> loc.offset;
+  loc.path = fields[index + 1];
+  loc.anchor = fields[index + 2];
+}
+
 void
 Location::set (int page1, const ApvlvPoint *point1, int offset1,
                const std::string &path1, const std::string &anchor1)
@@ -52,22 +87,27 @@ Location::set (int page1, const ApvlvPoint *point1, int offset1,
 }
 
 void
-Location::fromMarkdownNode (MarkdownNode *node)
+Location::fromText (string_view text)
 {
-  stringstream ss{ node->literal };
+  stringstream ss{ string (text) };
   ss >> page >> x >> y >> offset;
   if (!ss.eof ())
     {
-      auto str = ss.str ();
-      auto pos = str.find ("[[");
-      auto end = str.find ("]]");
-      path = str.substr (pos + 2, end - pos - 2);
-      anchor = str.substr (end + 2);
+      auto pos = text.find ("[[");
+      auto end = text.find ("]]");
+      if (pos == string_view::npos || end == string_view::npos || end < pos)
+        return;
+      path = text.substr (pos + 2, end - pos - 2);
+      // written as ]]#anchor
+      auto rest = text.substr (end + 2);
+      if (rest.starts_with ('#'))
+        rest.remove_prefix (1);
+      anchor = rest;
     }
 }
 
-void
-Location::toMarkdownNode (MarkdownNode *node) const
+string
+Location::toText () const
 {
   stringstream ss;
   ss << page << " " << x << " " << y << " " << offset;
@@ -75,72 +115,391 @@ Location::toMarkdownNode (MarkdownNode *node) const
     {
       ss << " [[" << path << "]]#" << anchor;
     }
-  node->node_type = CMARK_NODE_TEXT;
-  node->literal = ss.str ();
+  return ss.str ();
 }
 
 void
 Comment::fromMarkdownNode (MarkdownNode *node)
 {
   auto qn = node->childAt (0);
-  auto qp = qn->childAt (0);
-  auto qt = qp->childAt (0);
-  quoteText = qt->literal;
+  auto qp = qn ? qn->childAt (0) : nullptr;
+  if (qp)
+    quoteText = qp->text ();
 
+  // the parser ends the code with a newline
   auto cn = node->childAt (1);
-  commentText = cn->literal;
+  if (cn)
+    {
+      commentText = cn->literal;
+      if (commentText.ends_with ('\n'))
+        commentText.pop_back ();
+    }
 
   auto list = node->childAt (2);
+  if (list == nullptr)
+    return;
+
+  auto texts = list->getListTexts ();
+  if (texts.size () > 0)
+    begin.fromText (texts[0]);
+  if (texts.size () > 1)
+    end.fromText (texts[1]);
+  if (texts.size () > 2)
+    {
+      struct tm tm{};
+      strptime (texts[2].c_str (), "%a %b %d %H:%M:%S %Y", &tm);
+      time = std::mktime (&tm);
+    }
+}
 
-  auto i = list->childAt (0);
-  auto p = i->childAt (0);
-  auto t = p->childAt (0);
-  begin.fromMarkdownNode (t);
+void
+Comment::write (MarkdownWriter &writer) const
+{
+  writer.blockQuote (quoteText);
+  writer.codeBlock (commentText);
+
+  writer.bulletItem (begin.toText ());
+  writer.bulletItem (end.toText ());
+  string date = std::ctime (&time);
+  if (date.ends_with ('\n'))
+    date.pop_back ();
+  writer.bulletItem (date);
+}
+
+Note::Note (File *file) : mFile (file) {}
+
+Note::~Note ()
+{
+  if (mNotePath.empty ())
+    return;
 
-  i = list->childAt (1);
-  p = i->childAt (0);
-  t = p->childAt (0);
-  end.fromMarkdownNode (t);
+  NoteWriter::instance ()->cancel (this);
+  if (mJournalRecords > 0)
+    write (mNotePath);
 
-  i = list->childAt (2);
-  p = i->childAt (0);
-  t = p->childAt (0);
-  struct tm tm{};
-  strptime (t->literal.c_str (), "%a %b %d %H:%M:%S %Y", &tm);
-  time = std::mktime (&tm);
+  lock_guard<mutex> lock (NoteOwnersMutex);
+  auto itr = NoteOwners.find (mNotePath);
+  if (itr != NoteOwners.end () && itr->second == this)
+    NoteOwners.erase (itr);
 }
 
 void
-Comment::toMarkdownNode (MarkdownNode *node) const
+Note::setWritable ()
 {
-  auto qn = MarkdownNode::create (node, CMARK_NODE_BLOCK_QUOTE);
-  auto qp = MarkdownNode::create (qn, CMARK_NODE_PARAGRAPH);
-  MarkdownNode::create (qp, CMARK_NODE_TEXT, quoteText);
+  mWritable = true;
+}
 
-  MarkdownNode::create (node, CMARK_NODE_CODE_BLOCK, commentText);
+bool
+Note::claim (const string &path)
+{
+  lock_guard<mutex> lock (NoteOwnersMutex);
+  auto [itr, inserted] = NoteOwners.try_emplace (path, this);
+  return inserted || itr->second == this;
+}
 
-  auto list = MarkdownNode::create (node, CMARK_NODE_LIST);
-  list->list_type = CMARK_NO_LIST;
+void
+Note::setScore (float score)
+{
+  ensureLoaded ();
+  lock_guard<mutex> lock (mMutex);
+  mScore = score;
+  journal ("score", { to_string (score) });
+}
 
-  auto i = MarkdownNode::create (list, CMARK_NODE_ITEM);
-  auto p = MarkdownNode::create (i, CMARK_NODE_PARAGRAPH);
-  auto t = MarkdownNode::create (p, CMARK_NODE_TEXT);
-  begin.toMarkdownNode (t);
+void
+Note::addTag (const string &tag)
+{
+  ensureLoaded ();
+  lock_guard<mutex> lock (mMutex);
+  mTagSet.insert (tag);
+  journal ("tag+", { tag });
+}
 
-  i = MarkdownNode::create (list, CMARK_NODE_ITEM);
-  p = MarkdownNode::create (i, CMARK_NODE_PARAGRAPH);
-  t = MarkdownNode::create (p, CMARK_NODE_TEXT);
-  end.toMarkdownNode (t);
+void
+Note::removeTag (const string &tag)
+{
+  ensureLoaded ();
+  lock_guard<mutex> lock (mMutex);
+  mTagSet.erase (tag);
+  journal ("tag-", { tag });
+}
 
-  i = MarkdownNode::create (list, CMARK_NODE_ITEM);
-  p = MarkdownNode::create (i, CMARK_NODE_PARAGRAPH);
-  t = MarkdownNode::create (p, CMARK_NODE_TEXT);
-  t->literal = std::ctime (&time);
+void
+Note::setRemark (const string &remark)
+{
+  ensureLoaded ();
+  lock_guard<mutex> lock (mMutex);
+  mRemark = remark;
+  journal ("remark", { remark });
 }
 
-Note::Note (File *file) : mFile (file) {}
+void
+Note::addReference (const string &ref)
+{
+  ensureLoaded ();
+  lock_guard<mutex> lock (mMutex);
+  mReferences.insert (ref);
+  journal ("reference+", { ref });
+}
+
+void
+Note::removeReference (const string &ref)
+{
+  ensureLoaded ();
+  lock_guard<mutex> lock (mMutex);
+  mReferences.erase (ref);
+  journal ("reference-", { ref });
+}
+
+void
+Note::addLink (const string &link)
+{
+  ensureLoaded ();
+  lock_guard<mutex> lock (mMutex);
+  mLinks.insert (link);
+  journal ("link+", { link });
+}
+
+void
+Note::removeLink (const string &link)
+{
+  ensureLoaded ();
+  lock_guard<mutex> lock (mMutex);
+  mLinks.erase (link);
+  journal ("link-", { link });
+}
+
+void
+Note::addComment (const Comment &comment)
+{
+  ensureLoaded ();
+  lock_guard<mutex> lock (mMutex);
+  insertComment (comment);
+
+  vector<string> fields{ to_string (comment.time) };
+  locationFields (comment.begin, fields);
+  locationFields (comment.end, fields);
+  fields.push_back (comment.quoteText);
+  fields.push_back (comment.commentText);
+  journal ("comment+", fields);
+}
+
+void
+Note::removeComment (const Comment &comment)
+{
+  ensureLoaded ();
+  lock_guard<mutex> lock (mMutex);
+  eraseComment (comment.begin);
 
-Note::~Note () = default;
+  vector<string> fields;
+  locationFields (comment.begin, fields);
+  journal ("comment-", fields);
+}
+
+void
+Note::setCommentsInPage (int page, const vector<Comment> &comments)
+{
+  ensureLoaded ();
+  lock_guard<mutex> lock (mMutex);
+  auto first = mCommentList.lower_bound (Location::pageBegin (page));
+  auto last = mCommentList.lower_bound (Location::pageBegin (page + 1));
+  vector<Location> begins;
+  for (auto itr = first; itr != last; ++itr)
+    begins.push_back (itr->first);
+  for (auto const &begin : begins)
+    eraseComment (begin);
+
+  for (auto const &comment : comments)
+    insertComment (comment);
+}
+
+void
+Note::insertComment (Comment comment)
+{
+  auto [itr, inserted]
+      = mCommentList.try_emplace (comment.begin, std::move (comment));
+  if (!inserted)
+    return;
+
+  auto &comments = mPathIndex[itr->first.path];
+  auto pos = upper_bound (
+      comments.begin (), comments.end (), itr->first,
+      [] (const Location &loc, const Comment *c) { return loc < c->begin; });
+  comments.insert (pos, &itr->second);
+}
+
+void
+Note::eraseComment (const Location &begin)
+{
+  auto itr = mCommentList.find (begin);
+  if (itr == mCommentList.end ())
+    return;
+
+  auto index = mPathIndex.find (begin.path);
+  if (index != mPathIndex.end ())
+    {
+      auto &comments = index->second;
+      auto pos = lower_bound (comments.begin (), comments.end (), begin,
+                              [] (const Comment *c, const Location &loc) {
+                                return c->begin < loc;
+                              });
+      if (pos != comments.end () && *pos == &itr->second)
+        comments.erase (pos);
+      if (comments.empty ())
+        mPathIndex.erase (index);
+    }
+  mCommentList.erase (itr);
+}
+
+void
+Note::journal (const string &op, const vector<string> &fields)
+{
+  if (mNotePath.empty ())
+    {
+      if (mWritable)
+        qWarning () << "note of " << QString::fromLocal8Bit (mPath)
+                    << " is written by another window, the change is lost";
+      return;
+    }
+
+  auto path = mNotePath + ".journal";
+  if (mJournalRecords == 0)
+    {
+      error_code code;
+      filesystem::create_directories (filesystem::path (path).parent_path (),
+                                      code);
+    }
+
+  // a record is the operation and the field lengths, then the fields
+  ofstream ofs{ path, ios::binary | ios::app };
+  if (ofs.is_open ())
+    {
+      ofs << op;
+      for (auto const &field : fields)
+        {
+          ofs << " " << field.size ();
+        }
+      ofs << "\n";
+      for (auto const &field : fields)
+        {
+          ofs << field;
+        }
+      ofs << "\n";
+    }
+  else
+    {
+      qWarning () << "can't write note journal "
+                  << QString::fromLocal8Bit (path);
+    }
+
+  mJournalRecords++;
+  NoteWriter::instance ()->schedule (this);
+}
+
+bool
+Note::replayJournal (const string &path)
+{
+  ifstream ifs{ path, ios::binary };
+  if (!ifs.is_open ())
+    return false;
+
+  size_t records = 0;
+  string line;
+  while (getline (ifs, line))
+    {
+      stringstream ss{ line };
+      string op;
+      ss >> op;
+
+      vector<string> fields;
+      size_t length;
+      auto valid = true;
+      while (ss >> length)
+        {
+          if (length > JOURNAL_FIELD_MAX)
+            {
+              valid = false;
+              break;
+            }
+          fields.emplace_back (length, '\0');
+        }
+
+      for (auto &field : fields)
+        {
+          ifs.read (field.data (), static_cast<streamsize> (field.size ()));
+        }
+
+      // the tail of a crashed session may be truncated
+      if (!valid || ifs.fail () || ifs.get () != '\n')
+        break;
+
+      apply (op, fields);
+      records++;
+    }
+
+  mJournalRecords = records;
+  if (records > 0)
+    qDebug () << "replayed " << records << " changes of note "
+              << QString::fromLocal8Bit (path);
+  return records > 0;
+}
+
+void
+Note::apply (const string &op, const vector<string> &fields)
+{
+  if (op == "score" && fields.size () == 1)
+    {
+      mScore = strtof (fields[0].c_str (), nullptr);
+    }
+  else if (op == "tag+" && fields.size () == 1)
+    {
+      mTagSet.insert (fields[0]);
+    }
+  else if (op == "tag-" && fields.size () == 1)
+    {
+      mTagSet.erase (fields[0]);
+    }
+  else if (op == "remark" && fields.size () == 1)
+    {
+      mRemark = fields[0];
+    }
+  else if (op == "reference+" && fields.size () == 1)
+    {
+      mReferences.insert (fields[0]);
+    }
+  else if (op == "reference-" && fields.size () == 1)
+    {
+      mReferences.erase (fields[0]);
+    }
+  else if (op == "link+" && fields.size () == 1)
+    {
+      mLinks.insert (fields[0]);
+    }
+  else if (op == "link-" && fields.size () == 1)
+    {
+      mLinks.erase (fields[0]);
+    }
+  else if (op == "comment+" && fields.size () == 9)
+    {
+      Comment comment;
+      comment.time = strtoll (fields[0].c_str (), nullptr, 10);
+      locationFromFields (fields, 1, comment.begin);
+      locationFromFields (fields, 4, comment.end);
+      comment.quoteText = fields[7];
+      comment.commentText = fields[8];
+      insertComment (std::move (comment));
+    }
+  else if (op == "comment-" && fields.size () == 3)
+    {
+      Location begin;
+      locationFromFields (fields, 0, begin);
+      eraseComment (begin);
+    }
+  else
+    {
+      qWarning () << "unknown note journal record " << op;
+    }
+}
 
 bool
 Note::loadStreamV1 (std::ifstream &is)
@@ -231,30 +590,51 @@ Note::loadStream (std::ifstream &is)
 bool
 Note::load (std::string_view sv)
 {
+  mLoaded = true;
   string path = string (sv);
   if (path.empty ())
     path = notePathOfFile (mFile);
 
+  auto ret = false;
   ifstream ifs{ path };
-  if (!ifs.is_open ())
-    return false;
+  if (ifs.is_open ())
+    {
+      ret = loadStream (ifs);
+      ifs.close ();
+    }
+
+  if (mFile)
+    mPath = mFile->getFilename ();
+
+  // a read-only copy neither replays nor removes the journal, it would
+  // write a stale snapshot over the changes of the writable note
+  if (!mWritable || !claim (path))
+    return ret;
 
-  auto ret = loadStream (ifs);
-  ifs.close ();
+  // the changes of a crashed session are written again
+  mNotePath = path;
+  if (replayJournal (path + ".journal"))
+    {
+      NoteWriter::instance ()->schedule (this);
+      ret = true;
+    }
   return ret;
 }
 
 void
 Note::loadV1Version (MarkdownNode *node)
 {
-  for (auto i = 0; i < node->childrenCount (); i++)
+  auto lines = QString::fromStdString (node->text ()).split ("\n");
+  for (auto const &line : lines)
     {
-      auto n = node->childAt (i);
-      if (n->node_type == CMARK_NODE_SOFTBREAK)
-        continue;
+      // the path may have colons too
+      if (line.startsWith ("path: "))
+        {
+          mPath = line.mid (6).toStdString ();
+          continue;
+        }
 
-      auto s = QString::fromLocal8Bit (n->literal);
-      auto vs = s.split (":");
+      auto vs = line.split (":");
       if (vs.size () == 2)
         {
           if (vs[0].trimmed () == "version")
@@ -306,7 +686,7 @@ Note::loadV1Comments (MarkdownNode *node)
       auto ni = node->childAt (i);
       auto comment = Comment{};
       comment.fromMarkdownNode (ni);
-      addComment (comment);
+      insertComment (std::move (comment));
     }
 }
 
@@ -336,127 +716,46 @@ Note::loadV1Links (MarkdownNode *node)
     }
 }
 
-void
-Note::appendV1Version (MarkdownNode *doc)
+bool
+Note::dumpStream (std::ostream &os)
 {
-  MarkdownNode::create (doc, CMARK_NODE_THEMATIC_BREAK);
+  // written as they are, no document is built
+  MarkdownWriter writer{ os };
 
-  auto g = MarkdownNode::create (doc, CMARK_NODE_PARAGRAPH);
-  MarkdownNode::create (g, CMARK_NODE_TEXT, "version: 1");
-  MarkdownNode::create (g, CMARK_NODE_LINEBREAK);
-  MarkdownNode::create (g, CMARK_NODE_TEXT, "path: " + mPath);
-
-  MarkdownNode::create (doc, CMARK_NODE_THEMATIC_BREAK);
-}
+  writer.thematicBreak ();
+  auto path = "path: " + mPath;
+  writer.paragraph ({ "version: 1", path });
+  writer.thematicBreak ();
 
-void
-Note::appendV1MetaData (MarkdownNode *doc)
-{
-  MarkdownNode::HeadAndList headAndList;
-  headAndList.first = "Meta Data";
+  writer.heading (1, "Meta Data");
   string tags;
   for (const auto &cp : mTagSet)
     {
       tags += cp + ",";
     }
-  headAndList.second.push_back ("score: "
-                                + QString::number (mScore).toStdString ());
-  headAndList.second.push_back ("tag: " + tags);
-  doc->appendHeadAndBulletList (1, headAndList);
-}
+  writer.bulletItem ("score: " + QString::number (mScore).toStdString ());
+  writer.bulletItem ("tag: " + tags);
 
-void
-Note::appendV1Comments (MarkdownNode *doc)
-{
-  doc->appendHeadText (1, "Comments");
-
-  auto list = MarkdownNode::create (doc, CMARK_NODE_LIST);
-  list->list_type = CMARK_ORDERED_LIST;
+  writer.heading (1, "Comments");
+  auto number = 1;
   for (auto const &loc_comment : mCommentList)
     {
-      auto comment = loc_comment.second;
-      auto n = MarkdownNode::create (list, CMARK_NODE_ITEM);
-      comment.toMarkdownNode (n);
+      writer.beginItem (number++);
+      loc_comment.second.write (writer);
+      writer.endItem ();
     }
-}
 
-void
-Note::appendV1References (MarkdownNode *doc)
-{
-  MarkdownNode::HeadAndList headAndList;
-  headAndList.first = "References";
+  writer.heading (1, "References");
   for (auto const &r : mReferences)
     {
-      headAndList.second.push_back (r);
+      writer.bulletItem (r);
     }
-  doc->appendHeadAndBulletList (1, headAndList);
-}
 
-void
-Note::appendV1Links (MarkdownNode *doc)
-{
-  MarkdownNode::HeadAndList headAndList;
-  headAndList.first = "Links";
+  writer.heading (1, "Links");
   for (auto const &r : mLinks)
     {
-      headAndList.second.push_back (r);
+      writer.bulletItem (r);
     }
-  doc->appendHeadAndBulletList (1, headAndList);
-}
-
-bool
-Note::dumpStream (std::ostream &os)
-{
-  /* handmade version is ugly */
-#if 0
-  os << "---" << endl;
-  os << "version: 1" << endl;
-  os << "path: " << mFile->getFilename () << endl;
-
-  os << "---" << endl;
-  os << "# Meta Data" << endl;
-  os << "- tag: ";
-  std::ranges::for_each (mTagSet,
-                         [&os] (const string &tag) { os << tag << ","; });
-  os << endl;
-  os << "- score: " << mScore << endl;
-  os << endl;
-
-  os << "# Comments" << endl;
-  auto index = 0;
-  std::ranges::for_each (mCommentList,
-                         [&os, &index] (const pair<Location, Comment> &pair1) {
-                           os << " - " << index++ << endl;
-                           os << pair1.second;
-                         });
-  os << endl;
-
-  os << "# References" << endl;
-  std::ranges::for_each (
-      mReferences, [&os] (const string &ref) { os << "- " << ref << endl; });
-  os << endl;
-
-  os << "# Links" << endl;
-  std::ranges::for_each (
-      mLinks, [&os] (const string &link) { os << "- " << link << endl; });
-  os << endl;
-
-#else
-  auto doc = Markdown::create ();
-  auto node = doc->root ();
-
-  appendV1Version (node);
-
-  appendV1MetaData (node);
-
-  appendV1Comments (node);
-
-  appendV1References (node);
-
-  appendV1Links (node);
-
-  doc->saveToStream (os);
-#endif
 
   return true;
 }
@@ -464,24 +763,94 @@ Note::dumpStream (std::ostream &os)
 bool
 Note::dump (std::string_view sv)
 {
-  if (mFile == nullptr)
-    return false;
-
+  APVLV_TRACE ("Note::dump");
+  // an unread note must not be written empty
+  ensureLoaded ();
   string path = string (sv);
   if (path.empty ())
-    path = notePathOfFile (mFile);
+    {
+      if (mNotePath.empty ())
+        return false;
+      path = mNotePath;
+    }
+
+  if (path == mNotePath)
+    NoteWriter::instance ()->cancel (this);
+  return write (path);
+}
+
+bool
+Note::write (const string &path)
+{
+  APVLV_TRACE ("Note::write");
+  ostringstream os;
+  size_t records;
+  NoteSummary catalog;
+  {
+    lock_guard<mutex> lock (mMutex);
+    dumpStream (os);
+    records = mJournalRecords;
+    if (path == mNotePath)
+      catalog = summary ();
+  }
 
   auto fspath = filesystem::path (path).parent_path ();
   std::error_code code;
   filesystem::create_directories (fspath, code);
 
-  ofstream ofs{ path };
+  auto temp = path + ".tmp";
+  ofstream ofs{ temp, ios::binary | ios::trunc };
   if (!ofs.is_open ())
+    {
+      qWarning () << "can't write note " << QString::fromLocal8Bit (temp);
+      return false;
+    }
+  auto content = os.str ();
+  ofs.write (content.data (), static_cast<streamsize> (content.size ()));
+  ofs.close ();
+  if (ofs.fail ())
     return false;
 
-  auto ret = dumpStream (ofs);
-  ofs.close ();
-  return ret;
+  filesystem::rename (temp, path, code);
+  if (code)
+    {
+      qWarning () << "can't write note " << QString::fromLocal8Bit (path);
+      return false;
+    }
+
+  if (path != mNotePath)
+    return true;
+
+  NoteCatalog::instance ()->update (path, std::move (catalog));
+
+  // the changes after the snapshot are still needed
+  lock_guard<mutex> lock (mMutex);
+  if (mJournalRecords == records)
+    {
+      filesystem::remove (path + ".journal", code);
+      mJournalRecords = 0;
+    }
+  return true;
+}
+
+NoteSummary
+Note::summary ()
+{
+  NoteSummary summary;
+  summary.document
+      = mPath.empty () ? NoteCatalog::documentOfNote (mNotePath) : mPath;
+  summary.score = mScore;
+  summary.tags.assign (mTagSet.begin (), mTagSet.end ());
+  summary.references.assign (mReferences.begin (), mReferences.end ());
+  summary.links.assign (mLinks.begin (), mLinks.end ());
+  summary.comments.reserve (mCommentList.size ());
+  for (auto const &[begin, comment] : mCommentList)
+    {
+      summary.comments.push_back ({ begin.page, begin.path,
+                                    comment.quoteText + "\n"
+                                        + comment.commentText });
+    }
+  return summary;
 }
 
 std::string
@@ -498,4 +867,69 @@ Note::notePathOfFile (File *file)
   auto path = NotesDir + filesystem::path::preferred_separator + filename;
   return path + ".md";
 }
+
+NoteWriter::~NoteWriter ()
+{
+  {
+    lock_guard<mutex> lock (mMutex);
+    mQuit = true;
+  }
+  mCondition.notify_all ();
+  if (mTask.joinable ())
+    mTask.join ();
+}
+
+void
+NoteWriter::schedule (Note *note)
+{
+  lock_guard<mutex> lock (mMutex);
+  mPending[note] = chrono::steady_clock::now () + NOTE_WRITE_DELAY;
+  if (!mTask.joinable ())
+    mTask = thread (&NoteWriter::workerLoop, this);
+  mCondition.notify_all ();
+}
+
+void
+NoteWriter::cancel (Note *note)
+{
+  unique_lock<mutex> lock (mMutex);
+  mPending.erase (note);
+  mCondition.wait (lock, [this, note] () { return mWriting != note; });
+}
+
+void
+NoteWriter::workerLoop ()
+{
+  unique_lock<mutex> lock (mMutex);
+  while (!mQuit)
+    {
+      if (mPending.empty ())
+        {
+          mCondition.wait (lock);
+          continue;
+        }
+
+      auto itr = min_element (
+          mPending.begin (), mPending.end (),
+          [] (auto const &a, auto const &b) { return a.second < b.second; });
+      // the entry may be cancelled while waiting
+      auto deadline = itr->second;
+      if (deadline > chrono::steady_clock::now ())
+        {
+          mCondition.wait_until (lock, deadline);
+          continue;
+        }
+
+      auto note = itr->first;
+      mPending.erase (itr);
+      mWriting = note;
+      lock.unlock ();
+
+      note->write (note->mNotePath);
+
+      lock.lock ();
+      mWriting = nullptr;
+      mCondition.notify_all ();
+    }
+}
 }
@@ -28,19 +28,29 @@
 #ifndef _APVLV_NOTE_H_
 #define _APVLV_NOTE_H_
 
+#include <chrono>
+#include <condition_variable>
+#include <limits>
 #include <map>
+#include <mutex>
 #include <ranges>
+#include <span>
 #include <string>
 #include <string_view>
+#include <thread>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
+#include "ApvlvNoteCatalog.h"
+
 namespace apvlv
 {
 constexpr float NoteScoreMin = 0.0f;
 constexpr float NoteScoreMax = 10.0f;
 
 class MarkdownNode;
+class MarkdownWriter;
 struct ApvlvPoint;
 struct Location
 {
@@ -67,11 +77,21 @@ struct Location
     return false;
   }
 
+  // before every location of the page
+  static Location
+  pageBegin (int page)
+  {
+    return { page, -std::numeric_limits<double>::infinity (),
+             -std::numeric_limits<double>::infinity (),
+             std::numeric_limits<int>::min () };
+  }
+
   void set (int page1, const ApvlvPoint *point1, int offset1 = 0,
             const std::string &path1 = "", const std::string &anchor1 = "");
 
-  void fromMarkdownNode (MarkdownNode *node);
-  void toMarkdownNode (MarkdownNode *node) const;
+  // as the markdown has it, the numbers and [[path]]#anchor
+  void fromText (std::string_view text);
+  [[nodiscard]] std::string toText () const;
 };
 
 class File;
@@ -91,144 +111,112 @@ struct Comment
   time_t time;
 
   void fromMarkdownNode (MarkdownNode *node);
-  void toMarkdownNode (MarkdownNode *node) const;
+  void write (MarkdownWriter &writer) const;
 };
 
+// the comments of a page in the order of their locations, a view into
+// the note valid until it changes
+using PageComments = std::ranges::values_view<
+    std::ranges::subrange<std::map<Location, Comment>::const_iterator>>;
+
 class Note
 {
 public:
   explicit Note (File *file);
   ~Note ();
 
+  // the note of a document a frame shows, set before the first access;
+  // only one note of a path replays the journal and writes the markdown,
+  // the others are read-only copies
+  void setWritable ();
+
   bool loadStreamV1 (std::ifstream &is);
   bool loadStream (std::ifstream &is);
+  // the note of the file is loaded by the first access, the documents
+  // opened without reading their notes never parse them
   bool load (std::string_view path = "");
 
   bool dumpStream (std::ostream &os);
   bool dump (std::string_view path = "");
 
-  void
-  setScore (float score)
-  {
-    mScore = score;
-    dump ();
-  }
+  // what the catalog keeps of the note
+  NoteSummary summary ();
+
+  void setScore (float score);
 
   float
   score ()
   {
+    ensureLoaded ();
     return mScore;
   }
 
-  void
-  addTag (const std::string &tag)
-  {
-    mTagSet.insert (tag);
-    dump ();
-  }
-
-  void
-  removeTag (const std::string &tag)
-  {
-    mTagSet.erase (tag);
-    dump ();
-  }
+  void addTag (const std::string &tag);
+  void removeTag (const std::string &tag);
 
   const std::unordered_set<std::string> &
   tag ()
   {
+    ensureLoaded ();
     return mTagSet;
   }
 
-  void
-  setRemark (const std::string &remark)
-  {
-    mRemark = remark;
-    dump ();
-  }
+  void setRemark (const std::string &remark);
 
   const std::string &
   remark ()
   {
+    ensureLoaded ();
     return mRemark;
   }
 
-  void
-  addReference (const std::string &ref)
-  {
-    mReferences.insert (ref);
-    dump ();
-  }
-
-  void
-  removeReference (const std::string &ref)
-  {
-    mReferences.erase (ref);
-    dump ();
-  }
+  void addReference (const std::string &ref);
+  void removeReference (const std::string &ref);
 
   const std::unordered_set<std::string> &
   references ()
   {
+    ensureLoaded ();
     return mReferences;
   }
 
-  void
-  addLink (const std::string &link)
-  {
-    mLinks.insert (link);
-    dump ();
-  }
-
-  void
-  removeLink (const std::string &link)
-  {
-    mLinks.erase (link);
-    dump ();
-  }
+  void addLink (const std::string &link);
+  void removeLink (const std::string &link);
 
   const std::unordered_set<std::string> &
   links ()
   {
+    ensureLoaded ();
     return mLinks;
   }
 
-  void
-  addComment (const Comment &comment)
-  {
-    mCommentList.insert ({ comment.begin, comment });
-    dump ();
-  }
-
-  void
-  removeComment (const Comment &comment)
-  {
-    mCommentList.erase (comment.begin);
-    dump ();
-  }
+  void addComment (const Comment &comment);
+  void removeComment (const Comment &comment);
 
-  std::vector<Comment>
+  [[nodiscard]] PageComments
   getCommentsInPage (int page)
   {
-    std::vector<Comment> comments;
-    for (const auto &pair1 : mCommentList)
-      {
-        if (pair1.first.page == page)
-          comments.push_back (pair1.second);
-      };
-    return comments;
+    ensureLoaded ();
+    auto const &comments = mCommentList;
+    auto first = comments.lower_bound (Location::pageBegin (page));
+    auto last = comments.lower_bound (Location::pageBegin (page + 1));
+    return std::views::values (std::ranges::subrange (first, last));
   }
 
-  std::vector<Comment>
+  // replaces the comments of a page in memory, a read-only copy follows
+  // the writable note by it
+  void setCommentsInPage (int page, const std::vector<Comment> &comments);
+
+  // the comments of a path in the order of their locations, valid until
+  // the note changes
+  [[nodiscard]] std::span<const Comment *const>
   getCommentsInPath (const std::string &path)
   {
-    std::vector<Comment> comments;
-    for (const auto &pair1 : mCommentList)
-      {
-        if (pair1.first.path == path)
-          comments.push_back (pair1.second);
-      }
-    return comments;
+    ensureLoaded ();
+    auto itr = mPathIndex.find (path);
+    if (itr == mPathIndex.end ())
+      return {};
+    return itr->second;
   }
 
 private:
@@ -237,17 +225,43 @@ private:
   void loadV1Comments (MarkdownNode *node);
   void loadV1References (MarkdownNode *node);
   void loadV1Links (MarkdownNode *node);
-  void appendV1Version (MarkdownNode *doc);
-  void appendV1MetaData (MarkdownNode *doc);
-  void appendV1Comments (MarkdownNode *doc);
-  void appendV1References (MarkdownNode *doc);
-  void appendV1Links (MarkdownNode *doc);
 
   std::string notePathOfFile (File *file);
 
+  // the writable note of the path, false if another one is
+  bool claim (const std::string &path);
+
+  void
+  ensureLoaded ()
+  {
+    if (!mLoaded && mFile != nullptr)
+      load ();
+  }
+
+  // a change is appended to the journal at once, the markdown is written
+  // again by the NoteWriter when the changes stop
+  void journal (const std::string &op,
+                const std::vector<std::string> &fields);
+  bool replayJournal (const std::string &path);
+  void apply (const std::string &op, const std::vector<std::string> &fields);
+  void insertComment (Comment comment);
+  void eraseComment (const Location &begin);
+  // writes the markdown to a temporary file and renames it
+  bool write (const std::string &path);
+
   std::string mPath;
   File *mFile{ nullptr };
 
+  // the markdown file, empty while it is unknown or the note is
+  // read-only
+  std::string mNotePath;
+  bool mLoaded{ false };
+  bool mWritable{ false };
+  // guards the note against the NoteWriter, it is changed by one thread
+  std::mutex mMutex;
+  // the records in the journal, not written to the markdown yet
+  size_t mJournalRecords{ 0 };
+
   float mScore{ 0.0f };
 
   std::unordered_set<std::string> mTagSet;
@@ -258,6 +272,44 @@ private:
   std::unordered_set<std::string> mLinks;
 
   std::map<Location, Comment> mCommentList;
+  // the comments of every path, mCommentList is already ordered by page
+  std::unordered_map<std::string, std::vector<const Comment *>> mPathIndex;
+
+  friend class NoteWriter;
+};
+
+//
+// writes the changed notes in background, a note is written once
+// after a quiet time however often it changes
+//
+class NoteWriter
+{
+public:
+  static NoteWriter *
+  instance ()
+  {
+    static NoteWriter inst;
+    return &inst;
+  }
+
+  ~NoteWriter ();
+
+  void schedule (Note *note);
+
+  // waits for the running write of the note
+  void cancel (Note *note);
+
+private:
+  NoteWriter () = default;
+
+  void workerLoop ();
+
+  std::mutex mMutex;
+  std::condition_variable mCondition;
+  std::map<Note *, std::chrono::steady_clock::time_point> mPending;
+  Note *mWriting{ nullptr };
+  bool mQuit{ false };
+  std::thread mTask;
 };
 
 }
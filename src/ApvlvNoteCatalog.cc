@@ -0,0 +1,568 @@
+/*
+ * This file is part of the apvlv package
+ *
+ * Copyright (C) 2008 Alf.
+ *
+ * Contact: Alf <naihe2010@126.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2.0 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+/* @CPPFILE ApvlvNoteCatalog.cc
+ *
+ *  Author: Alf <naihe2010@126.com>
+ */
+
+
+#include <QDebug>
+#include <QDir>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+#include "ApvlvNote.h"
+#include "ApvlvNoteCatalog.h"
+#include "ApvlvUtil.h"
+
+namespace apvlv
+{
+
+using namespace std;
+
+const char *const CATALOG_HEADER = "apvlv-notes 1";
+
+static int64_t
+noteTime (const string &note)
+{
+  error_code code;
+  auto time = filesystem::last_write_time (note, code);
+  if (code)
+    return 0;
+  return static_cast<int64_t> (time.time_since_epoch ().count ());
+}
+
+static string
+lowered (string text)
+{
+  std::ranges::transform (text, text.begin (), ::tolower);
+  return text;
+}
+
+static void
+writeRecord (ostream &os, const string &note, const NoteSummary &summary)
+{
+  vector<const string *> fields{ &note, &summary.document };
+  for (auto const &list : { &summary.tags, &summary.references,
+                            &summary.links })
+    {
+      for (auto const &field : *list)
+        {
+          fields.push_back (&field);
+        }
+    }
+
+  vector<string> pages;
+  pages.reserve (summary.comments.size ());
+  for (auto const &comment : summary.comments)
+    {
+      pages.push_back (to_string (comment.page));
+    }
+  for (size_t i = 0; i < summary.comments.size (); ++i)
+    {
+      fields.push_back (&pages[i]);
+      fields.push_back (&summary.comments[i].path);
+      fields.push_back (&summary.comments[i].text);
+    }
+
+  os << "note " << summary.mtime << " " << summary.score << " "
+     << summary.tags.size () << " " << summary.references.size () << " "
+     << summary.links.size () << " " << summary.comments.size ();
+  for (auto field : fields)
+    {
+      os << " " << field->size ();
+    }
+  os << "\n";
+  for (auto field : fields)
+    {
+      os << *field;
+    }
+  os << "\n";
+}
+
+NoteQuery
+NoteQuery::parse (const string &text)
+{
+  NoteQuery query;
+  stringstream ss{ text };
+  string term;
+  while (ss >> term)
+    {
+      if (term.starts_with ("tag:"))
+        {
+          query.tags.push_back (term.substr (4));
+        }
+      else if (term.starts_with ("ref:"))
+        {
+          query.references.push_back (term.substr (4));
+        }
+      else if (term.starts_with ("link:"))
+        {
+          query.links.push_back (term.substr (5));
+        }
+      else if (term.starts_with ("path:"))
+        {
+          query.paths.push_back (term.substr (5));
+        }
+      else if (term.starts_with ("score")
+               && term.find_first_of ("<>=") == 5)
+        {
+          auto end = term.find_first_not_of ("<>=", 5);
+          auto op = term.substr (5, end - 5);
+          auto value = end == string::npos ? string{} : term.substr (end);
+          query.scores.emplace_back (op, strtof (value.c_str (), nullptr));
+        }
+      else
+        {
+          query.words.push_back (lowered (term));
+        }
+    }
+  return query;
+}
+
+NoteCatalog::NoteCatalog () : mStore (storePath (), CATALOG_HEADER)
+{
+  loadStore ();
+}
+
+NoteCatalog::~NoteCatalog ()
+{
+  mQuit.store (true);
+  if (mScanTask.joinable ())
+    mScanTask.join ();
+}
+
+void
+NoteCatalog::update (const string &note, NoteSummary summary)
+{
+  summary.mtime = noteTime (note);
+
+  lock_guard<mutex> lock (mMutex);
+  auto itr = mNotes.find (note);
+  if (itr != mNotes.end ())
+    index (note, itr->second, false);
+  index (note, summary, true);
+  appendStore (note, &summary);
+  mNotes[note] = std::move (summary);
+}
+
+void
+NoteCatalog::refresh ()
+{
+  lock_guard<mutex> lock (mMutex);
+  if (mScanning.load ())
+    return;
+
+  if (mScanTask.joinable ())
+    mScanTask.join ();
+  mScanning.store (true);
+  mScanTask = thread (&NoteCatalog::scan, this);
+}
+
+void
+NoteCatalog::scan ()
+{
+  scanNotes ();
+  mScanning.store (false);
+}
+
+void
+NoteCatalog::scanNotes ()
+{
+  unordered_set<string> seen;
+  error_code code;
+  auto itr = filesystem::recursive_directory_iterator (
+      NotesDir, filesystem::directory_options::skip_permission_denied, code);
+  for (; !code && itr != filesystem::recursive_directory_iterator ();
+       itr.increment (code))
+    {
+      if (mQuit.load ())
+        return;
+
+      error_code status_code;
+      if (!itr->is_regular_file (status_code)
+          || itr->path ().extension () != ".md")
+        continue;
+
+      auto note = itr->path ().string ();
+      seen.insert (note);
+      {
+        lock_guard<mutex> lock (mMutex);
+        auto entry = mNotes.find (note);
+        if (entry != mNotes.end ()
+            && entry->second.mtime == noteTime (note))
+          continue;
+      }
+
+      Note parsed{ nullptr };
+      if (parsed.load (note))
+        update (note, parsed.summary ());
+    }
+
+  // a failed walk would drop every note
+  if (code)
+    {
+      qDebug () << "can't scan notes in " << QString::fromLocal8Bit (NotesDir);
+      return;
+    }
+
+  lock_guard<mutex> lock (mMutex);
+  for (auto entry = mNotes.begin (); entry != mNotes.end ();)
+    {
+      if (seen.contains (entry->first))
+        {
+          ++entry;
+          continue;
+        }
+
+      index (entry->first, entry->second, false);
+      appendStore (entry->first, nullptr);
+      entry = mNotes.erase (entry);
+    }
+}
+
+void
+NoteCatalog::index (const string &note, NoteSummary &summary, bool add)
+{
+  indexValues (mTags, note, summary.tags, add);
+  indexValues (mReferences, note, summary.references, add);
+  indexValues (mLinks, note, summary.links, add);
+
+  if (add)
+    {
+      mScores.emplace (summary.score, note);
+      for (auto &comment : summary.comments)
+        {
+          comment.lowered = lowered (comment.text);
+        }
+      return;
+    }
+
+  auto [first, last] = mScores.equal_range (summary.score);
+  for (auto itr = first; itr != last; ++itr)
+    {
+      if (itr->second == note)
+        {
+          mScores.erase (itr);
+          break;
+        }
+    }
+}
+
+void
+NoteCatalog::indexValues (Index &index, const string &note,
+                          const vector<string> &values, bool add)
+{
+  for (auto const &value : values)
+    {
+      if (add)
+        {
+          index[value].insert (note);
+          continue;
+        }
+
+      auto itr = index.find (value);
+      if (itr == index.end ())
+        continue;
+      itr->second.erase (note);
+      if (itr->second.empty ())
+        index.erase (itr);
+    }
+}
+
+vector<NoteMatch>
+NoteCatalog::query (const NoteQuery &query)
+{
+  auto contains = [] (const vector<string> &list, const string &value) {
+    return find (list.begin (), list.end (), value) != list.end ();
+  };
+  auto compare = [] (float score, const pair<string, float> &term) {
+    auto const &[op, value] = term;
+    if (op == ">=")
+      return score >= value;
+    if (op == ">")
+      return score > value;
+    if (op == "<=")
+      return score <= value;
+    if (op == "<")
+      return score < value;
+    return score == value;
+  };
+
+  vector<NoteMatch> matches;
+  auto match = [&] (const NoteSummary &summary) {
+    for (auto const &tag : query.tags)
+      {
+        if (!contains (summary.tags, tag))
+          return;
+      }
+    for (auto const &ref : query.references)
+      {
+        if (!contains (summary.references, ref))
+          return;
+      }
+    for (auto const &link : query.links)
+      {
+        if (!contains (summary.links, link))
+          return;
+      }
+    for (auto const &path : query.paths)
+      {
+        if (summary.document.find (path) == string::npos)
+          return;
+      }
+    for (auto const &score : query.scores)
+      {
+        if (!compare (summary.score, score))
+          return;
+      }
+
+    if (query.words.empty ())
+      {
+        stringstream ss;
+        ss << "score: " << summary.score << " tag:";
+        for (auto const &tag : summary.tags)
+          {
+            ss << " " << tag;
+          }
+        auto page = summary.comments.empty () ? 0
+                                              : summary.comments[0].page;
+        matches.push_back ({ summary.document, page, ss.str () });
+        return;
+      }
+
+    for (auto const &comment : summary.comments)
+      {
+        auto const &text = comment.lowered;
+        if (std::ranges::all_of (query.words, [&text] (auto const &word) {
+              return text.find (word) != string::npos;
+            }))
+          {
+            auto line = comment.text;
+            std::ranges::replace (line, '\n', ' ');
+            matches.push_back ({ summary.document, comment.page, line });
+          }
+      }
+  };
+
+  lock_guard<mutex> lock (mMutex);
+  auto matchNote = [&] (const string &note) {
+    auto itr = mNotes.find (note);
+    if (itr != mNotes.end ())
+      match (itr->second);
+  };
+
+  // the notes of the rarest indexed value, match checks the other terms
+  const unordered_set<string> *candidates = nullptr;
+  auto narrow = [&candidates] (const Index &index,
+                               const vector<string> &values) {
+    for (auto const &value : values)
+      {
+        auto itr = index.find (value);
+        if (itr == index.end ())
+          return false;
+        if (candidates == nullptr || itr->second.size () < candidates->size ())
+          candidates = &itr->second;
+      }
+    return true;
+  };
+  if (!narrow (mTags, query.tags) || !narrow (mReferences, query.references)
+      || !narrow (mLinks, query.links))
+    return {};
+
+  if (candidates)
+    {
+      for (auto const &note : *candidates)
+        {
+          matchNote (note);
+        }
+      return matches;
+    }
+
+  if (!query.scores.empty ())
+    {
+      auto const &[op, value] = query.scores[0];
+      auto first = mScores.begin ();
+      auto last = mScores.end ();
+      if (op == ">=")
+        first = mScores.lower_bound (value);
+      else if (op == ">")
+        first = mScores.upper_bound (value);
+      else if (op == "<=")
+        last = mScores.upper_bound (value);
+      else if (op == "<")
+        last = mScores.lower_bound (value);
+      else
+        std::tie (first, last) = mScores.equal_range (value);
+      for (; first != last; ++first)
+        {
+          matchNote (first->second);
+        }
+      return matches;
+    }
+
+  for (auto const &[note, summary] : mNotes)
+    {
+      match (summary);
+    }
+  return matches;
+}
+
+string
+NoteCatalog::documentOfNote (const string &note)
+{
+  auto rel = note;
+  if (rel.starts_with (NotesDir))
+    rel = rel.substr (std::min (NotesDir.size () + 1, rel.size ()));
+  if (rel.ends_with (".md"))
+    rel.resize (rel.size () - 3);
+
+#ifdef WIN32
+  if (rel.size () > 1 && rel[1] == '-')
+    {
+      rel[1] = ':';
+      return rel;
+    }
+#else
+  error_code code;
+  if (filesystem::exists (PATH_SEP_S + rel, code))
+    return PATH_SEP_S + rel;
+#endif
+
+  auto homedir = QDir::home ().filesystemAbsolutePath ().string ();
+  return homedir + PATH_SEP_S + rel;
+}
+
+string
+NoteCatalog::storePath ()
+{
+  return CacheDir + PATH_SEP_S + "notes";
+}
+
+void
+NoteCatalog::loadStore ()
+{
+  mStore.load ([this] (istream &is) { return readRecord (is); });
+  if (!mStore.needsCompaction (mNotes.size ()))
+    return;
+
+  mStore.rewrite (mNotes.size (), [this] (ostream &os) {
+    for (auto const &[note, summary] : mNotes)
+      {
+        writeRecord (os, note, summary);
+      }
+  });
+}
+
+bool
+NoteCatalog::readRecord (istream &is)
+{
+  string line;
+  if (!getline (is, line))
+    return false;
+
+  stringstream ss{ line };
+  string tag;
+  NoteSummary summary;
+  size_t tags = 0, references = 0, links = 0, comments = 0;
+  ss >> tag;
+  if (tag == "note")
+    ss >> summary.mtime >> summary.score >> tags >> references >> links
+        >> comments;
+  if (ss.fail ())
+    return false;
+
+  vector<size_t> lengths;
+  size_t length;
+  while (ss >> length)
+    {
+      lengths.push_back (length);
+    }
+
+  vector<string> fields (lengths.size ());
+  for (size_t i = 0; i < lengths.size (); ++i)
+    {
+      if (!AppendLog::readField (is, lengths[i], fields[i]))
+        return false;
+    }
+  if (is.get () != '\n' || fields.empty ())
+    return false;
+
+  auto note = fields[0];
+  auto itr = mNotes.find (note);
+  if (itr != mNotes.end ())
+    {
+      index (note, itr->second, false);
+      mNotes.erase (itr);
+    }
+  if (tag == "remove")
+    return true;
+
+  if (tag != "note"
+      || fields.size () != 2 + tags + references + links + 3 * comments)
+    return false;
+
+  auto field = fields.begin () + 1;
+  summary.document = std::move (*field++);
+  for (auto [list, count] : { pair{ &summary.tags, tags },
+                              pair{ &summary.references, references },
+                              pair{ &summary.links, links } })
+    {
+      for (size_t i = 0; i < count; ++i)
+        {
+          list->push_back (std::move (*field++));
+        }
+    }
+  for (size_t i = 0; i < comments; ++i)
+    {
+      NoteSummary::Comment comment;
+      comment.page = static_cast<int> (strtol (field->c_str (), nullptr, 10));
+      comment.path = std::move (*++field);
+      comment.text = std::move (*++field);
+      ++field;
+      summary.comments.push_back (std::move (comment));
+    }
+
+  index (note, summary, true);
+  mNotes[note] = std::move (summary);
+  return true;
+}
+
+void
+NoteCatalog::appendStore (const string &note, const NoteSummary *summary)
+{
+  mStore.append ([&note, summary] (ostream &os) {
+    if (summary)
+      writeRecord (os, note, *summary);
+    else
+      os << "remove " << note.size () << "\n" << note << "\n";
+  });
+}
+
+}
+
+// Local Variables:
+// mode: c++
+// End:
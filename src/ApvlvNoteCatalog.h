@@ -0,0 +1,167 @@
+/*
+ * This file is part of the apvlv package
+ *
+ * Copyright (C) 2008 Alf.
+ *
+ * Contact: Alf <naihe2010@126.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2.0 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+/* @CPPFILE ApvlvNoteCatalog.h
+ *
+ *  Author: Alf <naihe2010@126.com>
+ */
+
+
+#ifndef _APVLV_NOTE_CATALOG_H_
+#define _APVLV_NOTE_CATALOG_H_
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "ApvlvAppendLog.h"
+
+namespace apvlv
+{
+
+//
+// what the catalog keeps of a note, the text of the comments is searched
+// without opening the note
+//
+struct NoteSummary
+{
+  struct Comment
+  {
+    int page{ 0 };
+    std::string path;
+    // the quote and the comment
+    std::string text;
+    // the text in lower case, kept by the catalog for the queries
+    std::string lowered;
+  };
+
+  // the document of the note
+  std::string document;
+  // of the markdown file
+  std::int64_t mtime{ 0 };
+  float score{ 0.0f };
+  std::vector<std::string> tags;
+  std::vector<std::string> references;
+  std::vector<std::string> links;
+  std::vector<Comment> comments;
+};
+
+//
+// a query is whitespace separated terms, all of them must match:
+//   tag:X ref:X link:X    the note has the tag, reference or link X
+//   path:X                the document path contains X
+//   score>=N score<N ...  the score compares with N by >=, >, <=, < or =
+//   other words           a comment contains the words, case insensitive
+//
+struct NoteQuery
+{
+  std::vector<std::string> tags;
+  std::vector<std::string> references;
+  std::vector<std::string> links;
+  std::vector<std::string> paths;
+  std::vector<std::pair<std::string, float>> scores;
+  std::vector<std::string> words;
+
+  static NoteQuery parse (const std::string &text);
+};
+
+struct NoteMatch
+{
+  std::string document;
+  int page{ 0 };
+  // the matched comment, or a line of the note without words
+  std::string line;
+};
+
+//
+// the tags, scores, references, links and comments of every note in
+// NotesDir, kept in one file in the cache directory
+//
+// A written note updates its entry at once, refresh () scans NotesDir in
+// background for the notes changed outside of apvlv.
+//
+class NoteCatalog final
+{
+public:
+  static NoteCatalog *
+  instance ()
+  {
+    static NoteCatalog inst;
+    return &inst;
+  }
+
+  ~NoteCatalog ();
+
+  void update (const std::string &note, NoteSummary summary);
+
+  void refresh ();
+
+  std::vector<NoteMatch> query (const NoteQuery &query);
+
+  // the document of a note without a path, by the layout of NotesDir
+  static std::string documentOfNote (const std::string &note);
+
+private:
+  NoteCatalog ();
+
+  using Index
+      = std::unordered_map<std::string, std::unordered_set<std::string>>;
+
+  void scan ();
+  void scanNotes ();
+  void index (const std::string &note, NoteSummary &summary, bool add);
+  static void indexValues (Index &index, const std::string &note,
+                           const std::vector<std::string> &values, bool add);
+
+  static std::string storePath ();
+  void loadStore ();
+  bool readRecord (std::istream &is);
+  void appendStore (const std::string &note, const NoteSummary *summary);
+
+  std::mutex mMutex;
+  std::map<std::string, NoteSummary> mNotes;
+  // the notes of every tag, reference, link and score
+  Index mTags;
+  Index mReferences;
+  Index mLinks;
+  std::multimap<float, std::string> mScores;
+  AppendLog mStore;
+
+  std::thread mScanTask;
+  // the scan task is running, a finished one is joined by refresh ()
+  std::atomic<bool> mScanning{ false };
+  std::atomic<bool> mQuit{ false };
+};
+
+}
+
+#endif
+
+/* Local Variables: */
+/* mode: c++ */
+/* End: */
@@ -25,44 +25,480 @@
  *  Author: Alf <naihe2010@126.com>
  */
 
+#include <QDebug>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <tesseract/ocrclass.h>
+#include <tesseract/resultiterator.h>
+
 #include "ApvlvOCR.h"
 #include "ApvlvParams.h"
+#include "ApvlvUtil.h"
 
 namespace apvlv
 {
 
 using namespace std;
 
+// the text layers of this many documents are kept in memory
+const size_t LAYER_CACHE = 8;
+
+static int64_t
+steadyMSeconds ()
+{
+  auto now = chrono::steady_clock::now ().time_since_epoch ();
+  return chrono::duration_cast<chrono::milliseconds> (now).count ();
+}
+
+static string
+lowerString (const string &str)
+{
+  string lower (str);
+  std::ranges::transform (lower, lower.begin (), [] (unsigned char c) {
+    return static_cast<char> (tolower (c));
+  });
+  return lower;
+}
+
 OCR::OCR ()
 {
-  auto lang = ApvlvParams::instance ()->getGroupStringOrDefault (
-      "ocr", "lang", "eng+chi_sim");
+  auto lang = ApvlvParams::instance ()->get (StringParam::OCR_LANG);
   mTessBaseAPI.Init (nullptr, lang.c_str ());
 }
 
 OCR::~OCR () { mTessBaseAPI.End (); }
 
-std::unique_ptr<TextAreaVector>
-OCR::getTextArea (const QPixmap &pixmap)
+static bool
+recognizeCancelled (void *cancel_this, [[maybe_unused]] int words)
 {
-  return nullptr;
+  auto cancel = static_cast<const atomic<bool> *> (cancel_this);
+  return cancel->load ();
 }
 
-std::unique_ptr<char>
-OCR::getTextFromPixmap (const QPixmap &pixmap, QRect area)
+std::unique_ptr<OCRPage>
+OCR::recognize (const QImage &image, double zm, const atomic<bool> *cancel)
 {
-  auto image = pixmap.toImage ();
-  image = image.convertToFormat (QImage::Format_RGB888);
-  mTessBaseAPI.SetImage (image.bits (), image.width (), image.height (), 3,
-                         static_cast<int> (image.bytesPerLine ()));
+  auto rgb = image.convertToFormat (QImage::Format_RGB888);
+  mTessBaseAPI.SetImage (rgb.bits (), rgb.width (), rgb.height (), 3,
+                         static_cast<int> (rgb.bytesPerLine ()));
+
+  tesseract::ETEXT_DESC monitor;
+  if (cancel)
+    {
+      monitor.cancel = recognizeCancelled;
+      monitor.cancel_this
+          = const_cast<void *> (static_cast<const void *> (cancel));
+    }
+  if (mTessBaseAPI.Recognize (cancel ? &monitor : nullptr) != 0
+      || (cancel && cancel->load ()))
+    {
+      mTessBaseAPI.Clear ();
+      return nullptr;
+    }
+
+  auto page = make_unique<OCRPage> ();
   auto text = mTessBaseAPI.GetUTF8Text ();
-  if (area.isValid ())
+  if (text)
+    {
+      page->text = text;
+      delete[] text;
+    }
+
+  auto iter = mTessBaseAPI.GetIterator ();
+  if (iter)
     {
-      mTessBaseAPI.SetRectangle (area.left (), area.top (), area.width (),
-                                 area.height ());
+      auto level = tesseract::RIL_WORD;
+      do
+        {
+          auto word = iter->GetUTF8Text (level);
+          if (word == nullptr)
+            continue;
+
+          int left, top, right, bottom;
+          if (iter->BoundingBox (level, &left, &top, &right, &bottom))
+            {
+              Rectangle rect{ left / zm, bottom / zm, right / zm, top / zm };
+              page->words.push_back ({ word, rect });
+            }
+          delete[] word;
+        }
+      while (iter->Next (level));
+      delete iter;
     }
+
   mTessBaseAPI.Clear ();
-  return unique_ptr<char> (text);
+  return page;
+}
+
+double
+OCR::zoomrate ()
+{
+  auto dpi = ApvlvParams::instance ()->get (IntParam::OCR_DPI);
+  return std::max (dpi, 72) / 72.0;
+}
+
+bool
+OCRTextLayer::hasPage (const string &path, int pn)
+{
+  refresh (path);
+  lock_guard<mutex> lock (mMutex);
+  auto doc = layer (path);
+  return doc != nullptr && doc->pages.contains (pn);
+}
+
+optional<string>
+OCRTextLayer::pageText (const string &path, int pn)
+{
+  refresh (path);
+  lock_guard<mutex> lock (mMutex);
+  auto doc = layer (path);
+  if (doc == nullptr)
+    return nullopt;
+  auto itr = doc->pages.find (pn);
+  if (itr == doc->pages.end ())
+    return nullopt;
+  return itr->second.text;
+}
+
+void
+OCRTextLayer::store (const string &path, int pn, const OCRPage &page)
+{
+  // the workers write one at a time, without the lock of the readers
+  refresh (path);
+  lock_guard<mutex> write (mWriteMutex);
+  int64_t mtime;
+  uintmax_t size;
+  bool fresh;
+  {
+    lock_guard<mutex> lock (mMutex);
+    auto doc = layer (path);
+    if (doc == nullptr)
+      return;
+    mtime = doc->mtime;
+    size = doc->size;
+    fresh = doc->pages.empty ();
+  }
+
+  auto filename = layerPath (path);
+  error_code code;
+  if (fresh)
+    filesystem::create_directories (filesystem::path (filename).parent_path (),
+                                    code);
+
+  ofstream ofs{ filename, fresh ? ios::trunc : ios::app };
+  if (!ofs.is_open ())
+    {
+      qWarning () << "can't write ocr text layer " << filename;
+      return;
+    }
+
+  if (fresh)
+    ofs << "apvlv-ocr 1 " << mtime << " " << size << "\t" << path << "\n";
+  ofs << "page " << pn << " " << page.text.size () << " "
+      << page.words.size () << "\n"
+      << page.text << "\n";
+  for (auto const &word : page.words)
+    {
+      ofs << word.rect.p1x << " " << word.rect.p1y << " " << word.rect.p2x
+          << " " << word.rect.p2y << " " << word.word << "\n";
+    }
+  if (!ofs)
+    return;
+
+  // the document may have changed while the page was written
+  lock_guard<mutex> lock (mMutex);
+  auto doc = layer (path);
+  if (doc != nullptr && doc->mtime == mtime && doc->size == size)
+    doc->pages[pn] = page;
+}
+
+unique_ptr<WordListRectangle>
+OCRTextLayer::pageSearch (const string &path, int pn, const string &str)
+{
+  // the words are joined by single spaces, a match covers every word it
+  // overlaps
+  istringstream iss{ lowerString (str) };
+  string query, term;
+  while (iss >> term)
+    {
+      query += (query.empty () ? "" : " ") + term;
+    }
+  if (query.empty ())
+    return nullptr;
+
+  refresh (path);
+  lock_guard<mutex> lock (mMutex);
+  auto doc = layer (path);
+  if (doc == nullptr)
+    return nullptr;
+  auto itr = doc->pages.find (pn);
+  if (itr == doc->pages.end () || itr->second.words.empty ())
+    return nullptr;
+
+  auto const &words = itr->second.words;
+  string joined;
+  vector<size_t> offsets;
+  for (auto const &word : words)
+    {
+      if (!joined.empty ())
+        joined += ' ';
+      offsets.push_back (joined.size ());
+      joined += lowerString (word.word);
+    }
+
+  auto list = make_unique<WordListRectangle> ();
+  for (auto pos = joined.find (query); pos != string::npos;
+       pos = joined.find (query, pos + query.size ()))
+    {
+      auto first = std::ranges::upper_bound (offsets, pos) - offsets.begin ();
+      auto last = std::ranges::upper_bound (offsets, pos + query.size () - 1)
+                  - offsets.begin ();
+      WordRectangle rectangle;
+      rectangle.word = str;
+      for (auto i = first - 1; i < last; ++i)
+        {
+          rectangle.rect_list.push_back (words[i].rect);
+        }
+      list->push_back (rectangle);
+    }
+
+  if (list->empty ())
+    return nullptr;
+  return list;
+}
+
+void
+OCRTextLayer::refresh (const string &path)
+{
+  Layer doc;
+  error_code code;
+  doc.size = filesystem::file_size (path, code);
+  auto mtime = filesystem::last_write_time (path, code);
+  if (!code)
+    doc.mtime = filesystemTimeToMSeconds (mtime);
+
+  auto current = [&] () {
+    auto itr = mLayers.find (path);
+    return itr != mLayers.end () && itr->second.mtime == doc.mtime
+           && itr->second.size == doc.size;
+  };
+
+  {
+    lock_guard<mutex> lock (mMutex);
+    if (current ())
+      return;
+  }
+
+  if (!loadLayer (path, doc))
+    doc.pages.clear ();
+
+  // a changed document is recognized again
+  lock_guard<mutex> lock (mMutex);
+  if (current ())
+    return;
+  if (auto itr = mLayers.find (path); itr != mLayers.end ())
+    {
+      mRecent.erase (itr->second.recent);
+      mLayers.erase (itr);
+    }
+
+  mRecent.push_front (path);
+  doc.recent = mRecent.begin ();
+  mLayers.emplace (path, std::move (doc));
+  while (mRecent.size () > LAYER_CACHE)
+    {
+      mLayers.erase (mRecent.back ());
+      mRecent.pop_back ();
+    }
+}
+
+OCRTextLayer::Layer *
+OCRTextLayer::layer (const string &path)
+{
+  auto itr = mLayers.find (path);
+  if (itr == mLayers.end ())
+    return nullptr;
+
+  mRecent.splice (mRecent.begin (), mRecent, itr->second.recent);
+  return &itr->second;
+}
+
+string
+OCRTextLayer::layerPath (const string &path)
+{
+  stringstream ss;
+  ss << hex << std::hash<string>{}(path);
+  return CacheDir + PATH_SEP_S + "ocr" + PATH_SEP_S + ss.str ();
+}
+
+bool
+OCRTextLayer::loadLayer (const string &path, Layer &doc)
+{
+  ifstream ifs{ layerPath (path), ios::binary };
+  if (!ifs.is_open ())
+    return false;
+
+  string line;
+  getline (ifs, line);
+  stringstream header;
+  header << "apvlv-ocr 1 " << doc.mtime << " " << doc.size << "\t" << path;
+  if (line != header.str ())
+    {
+      qDebug () << "ocr text layer of " << QString::fromLocal8Bit (path)
+                << " is stale";
+      return false;
+    }
+
+  string tag;
+  int pn;
+  size_t length, count;
+  while (ifs >> tag >> pn >> length >> count && tag == "page")
+    {
+      OCRPage page;
+      ifs.get ();
+      page.text.resize (length);
+      ifs.read (page.text.data (), static_cast<streamsize> (length));
+      ifs.get ();
+      for (size_t i = 0; i < count && ifs; ++i)
+        {
+          OCRWord word;
+          ifs >> word.rect.p1x >> word.rect.p1y >> word.rect.p2x
+              >> word.rect.p2y;
+          ifs.get ();
+          getline (ifs, word.word);
+          page.words.push_back (word);
+        }
+
+      // a truncated tail is recognized again
+      if (!ifs)
+        break;
+      doc.pages[pn] = std::move (page);
+    }
+
+  return true;
+}
+
+OCRPipeline::OCRPipeline ()
+{
+  // the text layer must outlive the workers
+  OCRTextLayer::instance ();
+}
+
+OCRPipeline::~OCRPipeline ()
+{
+  mQuit.store (true);
+  for (auto &task : mTasks)
+    {
+      task.join ();
+    }
+}
+
+void
+OCRPipeline::submit (const string &path)
+{
+  auto params = ApvlvParams::instance ();
+  if (!params->get (BoolParam::OCR_BACKGROUND))
+    return;
+
+  {
+    lock_guard<mutex> lock (mSubmittedMutex);
+    if (mSubmitted.contains (path))
+      return;
+    mSubmitted.insert (path);
+
+    auto count = params->get (IntParam::OCR_THREADS);
+    auto limit = static_cast<int> (thread::hardware_concurrency ());
+    count = std::clamp (count, 1, std::max (limit, 1));
+    mWorkers.store (count);
+    for (auto i = static_cast<int> (mTasks.size ()); i < count; ++i)
+      {
+        mTasks.emplace_back (&OCRPipeline::workerLoop, this, i);
+      }
+  }
+
+  qDebug () << "ocr queued " << QString::fromLocal8Bit (path);
+  mQueue.push (path);
+}
+
+void
+OCRPipeline::workerLoop (int index)
+{
+  OCR ocr;
+  while (mQuit.load () == false)
+    {
+      string path;
+      if (index < mWorkers.load () && mQueue.pop (path))
+        {
+          document (ocr, path);
+        }
+      else
+        {
+          this_thread::sleep_for (500ms);
+        }
+    }
+}
+
+void
+OCRPipeline::document (OCR &ocr, const string &path)
+{
+  auto file = FileFactory::loadFile (path);
+  if (!file || file->getDisplayType () != DISPLAY_TYPE::IMAGE)
+    return;
+
+  auto zm = OCR::zoomrate ();
+  auto layer = OCRTextLayer::instance ();
+  for (auto pn = 0; pn < file->sum (); ++pn)
+    {
+      if (!waitIdle ())
+        return;
+
+      if (layer->hasPage (path, pn))
+        continue;
+
+      // text pages are stored empty, they are not checked again
+      OCRPage page;
+      if (file->pageIsOnlyImage (pn))
+        {
+          QImage image;
+          if (!file->pageRenderToImage (pn, zm, 0, &image))
+            continue;
+
+          auto result = ocr.recognize (image, zm, &mQuit);
+          if (!result)
+            continue;
+          page = std::move (*result);
+        }
+      layer->store (path, pn, page);
+    }
+
+  qDebug () << "ocr finished " << QString::fromLocal8Bit (path);
+}
+
+bool
+OCRPipeline::waitIdle ()
+{
+  // keep off the cpu while pages are rendered interactively, and a
+  // moment after that
+  while (mQuit.load () == false)
+    {
+      if (mInteractive.load () == 0
+          && steadyMSeconds () - mLastInteractive.load () > 500)
+        return true;
+      this_thread::sleep_for (100ms);
+    }
+  return false;
+}
+
+OCRPipeline::Throttle::Throttle () { instance ()->mInteractive++; }
+
+OCRPipeline::Throttle::~Throttle ()
+{
+  auto pipeline = instance ();
+  pipeline->mLastInteractive.store (steadyMSeconds ());
+  pipeline->mInteractive--;
 }
 
 }
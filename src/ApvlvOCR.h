@@ -28,16 +28,44 @@
 #ifndef _APVLV_OCR_H_
 #define _APVLV_OCR_H_
 
+#include <QImage>
 #include <QPixmap>
 #include <QRect>
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
 #include <tesseract/capi.h>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
+#include "ApvlvFile.h"
+#include "ApvlvQueue.h"
+
 namespace apvlv
 {
 
-using TextAreaVector = std::vector<QRect>;
+//
+// a recognized word, the rectangle is in page coordinates (zoom 1.0),
+// p1y is the bottom and p2y the top like the search results
+//
+struct OCRWord
+{
+  std::string word;
+  Rectangle rect;
+};
+
+struct OCRPage
+{
+  std::string text;
+  std::vector<OCRWord> words;
+};
 
 class OCR final
 {
@@ -45,14 +73,118 @@ public:
   OCR ();
   ~OCR ();
 
-  std::unique_ptr<TextAreaVector> getTextArea (const QPixmap &pixmap);
-  std::unique_ptr<char> getTextFromPixmap (const QPixmap &pixmap,
-                                           QRect area = QRect ());
+  // recognize an image rendered at zoom zm, the recognition stops as soon
+  // as cancel is set
+  std::unique_ptr<OCRPage> recognize (const QImage &image, double zm,
+                                      const std::atomic<bool> *cancel
+                                      = nullptr);
+
+  // the zoom rate of the pages rendered for recognition
+  static double zoomrate ();
 
 private:
   TessBaseAPI mTessBaseAPI;
 };
 
+//
+// the persistent OCR text layer, one file per document in the cache
+// directory, pages are appended as they are recognized
+//
+// The layers of the recently used documents are kept in memory, a layer
+// is read again when its document has changed.
+//
+class OCRTextLayer final
+{
+public:
+  static OCRTextLayer *
+  instance ()
+  {
+    static OCRTextLayer inst;
+    return &inst;
+  }
+
+  bool hasPage (const std::string &path, int pn);
+  std::optional<std::string> pageText (const std::string &path, int pn);
+  void store (const std::string &path, int pn, const OCRPage &page);
+
+  std::unique_ptr<WordListRectangle> pageSearch (const std::string &path,
+                                                 int pn,
+                                                 const std::string &str);
+
+private:
+  struct Layer
+  {
+    std::int64_t mtime{ 0 };
+    std::uintmax_t size{ 0 };
+    std::map<int, OCRPage> pages;
+    // the place in mRecent
+    std::list<std::string>::iterator recent;
+  };
+
+  // reads the layer again when the document has changed, without the
+  // lock held
+  void refresh (const std::string &path);
+  // with the lock held, nullptr when the layer is not loaded
+  Layer *layer (const std::string &path);
+  static std::string layerPath (const std::string &path);
+  static bool loadLayer (const std::string &path, Layer &layer);
+
+  std::mutex mMutex;
+  // the layer files are written under this one
+  std::mutex mWriteMutex;
+  std::unordered_map<std::string, Layer> mLayers;
+  // the documents of mLayers, the most recently used first
+  std::list<std::string> mRecent;
+};
+
+//
+// background OCR of image-only pages
+//
+// Documents are processed by a bounded pool, every worker owns its
+// TessBaseAPI and its own File. Workers wait while a page is rendered
+// interactively, see OCRPipeline::Throttle.
+//
+class OCRPipeline final
+{
+public:
+  static OCRPipeline *
+  instance ()
+  {
+    static OCRPipeline inst;
+    return &inst;
+  }
+
+  ~OCRPipeline ();
+
+  void submit (const std::string &path);
+
+  class Throttle final
+  {
+  public:
+    Throttle ();
+    ~Throttle ();
+  };
+
+private:
+  OCRPipeline ();
+
+  // the workers beyond the threads setting idle
+  void workerLoop (int index);
+  void document (OCR &ocr, const std::string &path);
+  bool waitIdle ();
+
+  std::vector<std::thread> mTasks;
+  std::atomic<int> mWorkers{ 0 };
+  LockQueue<std::string> mQueue;
+
+  std::mutex mSubmittedMutex;
+  std::set<std::string> mSubmitted;
+
+  std::atomic<bool> mQuit{ false };
+  std::atomic<int> mInteractive{ 0 };
+  std::atomic<std::int64_t> mLastInteractive{ 0 };
+};
+
 }
 
 #endif
@@ -25,7 +25,9 @@
  *  Author: Alf <naihe2010@126.com>
  */
 
+#include <QApplication>
 #include <algorithm>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <sstream>
@@ -38,44 +40,176 @@ namespace apvlv
 {
 using namespace std;
 
+// the keys of the settings and their defaults, in the order of the enums,
+// the defaults are pushed by the constructor
+const array<pair<const char *, const char *>,
+            static_cast<size_t> (BoolParam::COUNT)>
+    BOOL_KEYS{ {
+        { "inverted", "no" },
+        { "fullscreen", "no" },
+        { "continuous", "yes" },
+        { "autoscrollpage", "yes" },
+        { "autoscrolldoc", "yes" },
+        { "noinfo", "no" },
+        { "wrapscan", "yes" },
+        { "ocr:background", "no" },
+        { "metadata:background", "yes" },
+    } };
+
+const array<pair<const char *, const char *>,
+            static_cast<size_t> (IntParam::COUNT)>
+    INT_KEYS{ {
+        { "width", "800" },
+        { "height", "600" },
+        { "fix_width", "0" },
+        { "fix_height", "0" },
+        { "autoreload", "3" },
+        { "thread_count", "auto" },
+        { "cache_count", "10" },
+        { "max_info", "10000" },
+        { "ocr:threads", "1" },
+        { "ocr:dpi", "300" },
+        { "metadata:threads", "2" },
+        { "thumbnail:threads", "2" },
+        { "thumbnail:cache", "256" },
+        { "thumbnail:prefetch", "4" },
+    } };
+
+const array<pair<const char *, const char *>,
+            static_cast<size_t> (StringParam::COUNT)>
+    STRING_KEYS{ {
+        { "zoom", "fitwidth" },
+        { "guioptions", "mTsS" },
+#ifdef WIN32
+        { "defaultdir", "C:\\" },
+#else
+        { "defaultdir", "/tmp" },
+#endif
+        { "info_sync", "compact" },
+        { "lok_path", "/usr/lib64/libreoffice/program" },
+        { "ocr:lang", "eng+chi_sim" },
+    } };
+
+static bool
+parseBool (const string &value)
+{
+  return value == "true" || value == "yes" || value == "on" || value == "1";
+}
+
+string
+ParamsSnapshot::engine (const string &ext) const
+{
+  auto itr = engines.find (ext);
+  return itr != engines.end () ? itr->second : string{};
+}
+
 ApvlvParams::ApvlvParams ()
 {
-  push ("inverted", "no");
-  push ("fullscreen", "no");
-  push ("zoom", "fitwidth");
-  push ("continuous", "yes");
-  push ("autoscrollpage", "yes");
-  push ("autoscrolldoc", "yes");
-  push ("noinfo", "no");
-  push ("width", "800");
-  push ("height", "600");
-  push ("fix_width", "0");
-  push ("fix_height", "0");
+  auto defaults = [this] (auto const &keys) {
+    for (auto const &[key, value] : keys)
+      {
+        push (key, value);
+      }
+  };
+  defaults (BOOL_KEYS);
+  defaults (INT_KEYS);
+  defaults (STRING_KEYS);
+
   push ("background", "");
-  push ("warpscan", "yes");
   push ("commandtimeout", "1000");
-#ifdef WIN32
-  push ("defaultdir", "C:\\");
-#else
-  push ("defaultdir", "/tmp");
-#endif
-  push ("guioptions", "mTsS");
-  push ("autoreload", "3");
-  push ("thread_count", "auto");
-  push ("lok_path", "/usr/lib64/libreoffice/program");
 
   push (".pdf:engine", "MuPDF");
   push (".epub:engine", "Web");
   push (".fb2:engine", "Web");
   push (".txt:engine", "MuPDF");
 
-  push ("ocr:lang", "eng+chi_sim");
+  push ("log:search", "info");
+  push ("log:render", "info");
+  push ("log:completion", "info");
+
+  mDefaults = mParamMap;
+  publish ();
 }
 
 ApvlvParams::~ApvlvParams () = default;
 
+// an editor writes a file in a few steps
+const int RELOAD_DELAY = 500;
+
 bool
 ApvlvParams::loadFile (const std::string &filename)
+{
+  if (std::ranges::find (mFiles, filename) == mFiles.end ())
+    mFiles.push_back (filename);
+  return parse (filename);
+}
+
+void
+ApvlvParams::watch ()
+{
+  if (mWatcher == nullptr)
+    {
+      mWatcher = new QFileSystemWatcher (qApp);
+      mReloadTimer = new QTimer (qApp);
+      mReloadTimer->setSingleShot (true);
+      mReloadTimer->setInterval (RELOAD_DELAY);
+      QObject::connect (mWatcher, SIGNAL (fileChanged (const QString &)),
+                        mReloadTimer, SLOT (start ()));
+      QObject::connect (mReloadTimer, SIGNAL (timeout ()), this,
+                        SLOT (reload ()));
+    }
+
+  // a replaced file is not watched any more
+  auto watched = mWatcher->files ();
+  for (auto const &file : mFiles)
+    {
+      auto path = QString::fromLocal8Bit (file);
+      if (!watched.contains (path) && filesystem::exists (file))
+        mWatcher->addPath (path);
+    }
+}
+
+void
+ApvlvParams::reload ()
+{
+  map<string, string> old;
+  {
+    lock_guard<mutex> lock (mMutex);
+    old = mParamMap;
+    mParamMap = mDefaults;
+  }
+
+  mReloading = true;
+  for (auto const &file : mFiles)
+    {
+      parse (file);
+    }
+  mReloading = false;
+  publish ();
+
+  map<string, string> now;
+  {
+    lock_guard<mutex> lock (mMutex);
+    now = mParamMap;
+  }
+  qDebug () << "configuration reloaded";
+  for (auto const &[key, value] : now)
+    {
+      auto itr = old.find (key);
+      if (itr == old.end () || itr->second != value)
+        emit changed (QString::fromStdString (key));
+    }
+  for (auto const &[key, value] : old)
+    {
+      if (!now.contains (key))
+        emit changed (QString::fromStdString (key));
+    }
+
+  watch ();
+}
+
+bool
+ApvlvParams::parse (const std::string &filename)
 {
   string str;
   fstream os (filename, ios::in);
@@ -159,41 +293,77 @@ ApvlvParams::loadFile (const std::string &filename)
 bool
 ApvlvParams::push (string_view ch, string_view str)
 {
-  mParamMap[string (ch)] = str;
+  auto key = string (ch);
+  {
+    lock_guard<mutex> lock (mMutex);
+    auto itr = mParamMap.find (key);
+    if (itr != mParamMap.end () && itr->second == str)
+      return true;
+    mParamMap[key] = str;
+  }
+
+  // the defaults are published once by the constructor, a reload once
+  // after reading the files
+  if (mSnapshot.load () != nullptr && !mReloading)
+    {
+      publish ();
+      emit changed (QString::fromStdString (key));
+    }
   return true;
 }
 
+void
+ApvlvParams::publish ()
+{
+  auto snap = make_shared<ParamsSnapshot> ();
+  lock_guard<mutex> lock (mMutex);
+  auto lookup = [this] (const char *key) -> const string * {
+    auto itr = mParamMap.find (key);
+    if (itr == mParamMap.end () || itr->second.empty ())
+      return nullptr;
+    return &itr->second;
+  };
+
+  for (size_t i = 0; i < BOOL_KEYS.size (); ++i)
+    {
+      auto value = lookup (BOOL_KEYS[i].first);
+      snap->bools[i] = parseBool (value ? *value : BOOL_KEYS[i].second);
+    }
+  for (size_t i = 0; i < INT_KEYS.size (); ++i)
+    {
+      auto value = lookup (INT_KEYS[i].first);
+      auto str = value ? value->c_str () : INT_KEYS[i].second;
+      snap->ints[i] = int (strtol (str, nullptr, 10));
+    }
+  for (size_t i = 0; i < STRING_KEYS.size (); ++i)
+    {
+      auto value = lookup (STRING_KEYS[i].first);
+      snap->strings[i] = value ? *value : STRING_KEYS[i].second;
+    }
+
+  for (auto const &[key, value] : mParamMap)
+    {
+      if (key.ends_with (":engine") && !value.empty ())
+        snap->engines[key.substr (0, key.size () - 7)] = value;
+    }
+
+  mSnapshot.store (std::move (snap), memory_order_release);
+}
+
 string
 ApvlvParams::getGroupStringOrDefault (std::string_view entry,
                                       std::string_view key,
                                       const std::string &defs)
 {
-  auto itr = std::ranges::find_if (
-      mParamMap, [entry, key] (const pair<string, string> &p) -> bool {
-        if (p.first.find (':') == string::npos)
-          return false;
-        else
-          {
-            auto pos = p.first.find (':');
-            auto pentry = p.first.substr (0, pos);
-            auto pkey = p.first.substr (pos + 1);
-            return pentry == entry && pkey == key;
-          }
-      });
-  if (itr != mParamMap.cend ())
-    {
-      return itr->second;
-    }
-  return defs;
+  auto name = string (entry) + ":" + string (key);
+  return getStringOrDefault (name, defs);
 }
 
 string
 ApvlvParams::getStringOrDefault (string_view key, const string &defs)
 {
-  auto itr = std::ranges::find_if (
-      mParamMap, [key] (const pair<string, string> &p) -> bool {
-        return p.first == key;
-      });
+  lock_guard<mutex> lock (mMutex);
+  auto itr = mParamMap.find (string (key));
   if (itr != mParamMap.cend ())
     {
       return itr->second;
@@ -218,14 +388,7 @@ ApvlvParams::getBoolOrDefault (string_view key, bool defb)
   if (values.empty ())
     return defb;
 
-  if (values == "true" || values == "yes" || values == "on" || values == "1")
-    {
-      return true;
-    }
-  else
-    {
-      return false;
-    }
+  return parseBool (values);
 }
 }
 
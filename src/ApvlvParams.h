@@ -28,15 +28,104 @@
 #ifndef _APVLV_PARAMS_H_
 #define _APVLV_PARAMS_H_
 
+#include <QFileSystemWatcher>
+#include <QObject>
+#include <QTimer>
+#include <array>
+#include <atomic>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <string_view>
+#include <unordered_map>
+#include <vector>
 
 namespace apvlv
 {
 
-class ApvlvParams final
+// the settings of apvlv, the other keys are looked up by their names
+enum class BoolParam
 {
+  INVERTED,
+  FULLSCREEN,
+  CONTINUOUS,
+  AUTOSCROLLPAGE,
+  AUTOSCROLLDOC,
+  NOINFO,
+  WRAPSCAN,
+  OCR_BACKGROUND,
+  METADATA_BACKGROUND,
+  COUNT
+};
+
+enum class IntParam
+{
+  WIDTH,
+  HEIGHT,
+  FIX_WIDTH,
+  FIX_HEIGHT,
+  AUTORELOAD,
+  // 0 is auto
+  THREAD_COUNT,
+  CACHE_COUNT,
+  MAX_INFO,
+  OCR_THREADS,
+  OCR_DPI,
+  METADATA_THREADS,
+  THUMBNAIL_THREADS,
+  THUMBNAIL_CACHE,
+  THUMBNAIL_PREFETCH,
+  COUNT
+};
+
+enum class StringParam
+{
+  ZOOM,
+  GUIOPTIONS,
+  DEFAULTDIR,
+  INFO_SYNC,
+  LOK_PATH,
+  OCR_LANG,
+  COUNT
+};
+
+//
+// the settings parsed when they are set, a snapshot is never changed
+//
+struct ParamsSnapshot
+{
+  std::array<bool, static_cast<size_t> (BoolParam::COUNT)> bools{};
+  std::array<int, static_cast<size_t> (IntParam::COUNT)> ints{};
+  std::array<std::string, static_cast<size_t> (StringParam::COUNT)> strings;
+  // the engine of every extension, like ".pdf" to "MuPDF"
+  std::unordered_map<std::string, std::string> engines;
+
+  [[nodiscard]] bool
+  get (BoolParam param) const
+  {
+    return bools[static_cast<size_t> (param)];
+  }
+
+  [[nodiscard]] int
+  get (IntParam param) const
+  {
+    return ints[static_cast<size_t> (param)];
+  }
+
+  [[nodiscard]] const std::string &
+  get (StringParam param) const
+  {
+    return strings[static_cast<size_t> (param)];
+  }
+
+  // empty when not set
+  [[nodiscard]] std::string engine (const std::string &ext) const;
+};
+
+class ApvlvParams final : public QObject
+{
+  Q_OBJECT
 public:
   ApvlvParams (const ApvlvParams &) = delete;
   const ApvlvParams &operator= (const ApvlvParams &) = delete;
@@ -45,6 +134,10 @@ public:
 
   bool loadFile (const std::string &filename);
 
+  // the loaded files are read again when they are changed, the settings
+  // not in them go back to the defaults
+  void watch ();
+
   bool push (std::string_view ch, std::string_view str);
 
   std::string getGroupStringOrDefault (std::string_view entry,
@@ -58,6 +151,33 @@ public:
 
   bool getBoolOrDefault (std::string_view key, bool defb = false);
 
+  // the settings of now, read by any thread without taking mMutex; the
+  // atomic shared_ptr of libstdc++ locks internally, but only for the
+  // copy of the pointer
+  [[nodiscard]] std::shared_ptr<const ParamsSnapshot>
+  snapshot () const
+  {
+    return mSnapshot.load (std::memory_order_acquire);
+  }
+
+  [[nodiscard]] bool
+  get (BoolParam param) const
+  {
+    return snapshot ()->get (param);
+  }
+
+  [[nodiscard]] int
+  get (IntParam param) const
+  {
+    return snapshot ()->get (param);
+  }
+
+  [[nodiscard]] std::string
+  get (StringParam param) const
+  {
+    return snapshot ()->get (param);
+  }
+
   static ApvlvParams *
   instance ()
   {
@@ -65,11 +185,30 @@ public:
     return &inst;
   }
 
+signals:
+  // emitted after the new snapshot is published
+  void changed (const QString &key);
+
+private slots:
+  void reload ();
+
 private:
   ApvlvParams ();
-  ~ApvlvParams ();
+  ~ApvlvParams () override;
+
+  bool parse (const std::string &filename);
+  void publish ();
 
+  mutable std::mutex mMutex;
   std::map<std::string, std::string> mParamMap;
+  std::map<std::string, std::string> mDefaults;
+  std::vector<std::string> mFiles;
+  bool mReloading{ false };
+
+  // they live with the application
+  QFileSystemWatcher *mWatcher{ nullptr };
+  QTimer *mReloadTimer{ nullptr };
+  std::atomic<std::shared_ptr<const ParamsSnapshot>> mSnapshot;
 };
 
 }
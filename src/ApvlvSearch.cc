@@ -27,13 +27,19 @@
 
 #include <QDebug>
 #include <algorithm>
+#include <cmath>
 #include <filesystem>
+#include <fstream>
 #include <regex>
+#include <sstream>
 #include <stack>
 
 #include "ApvlvFile.h"
+#include "ApvlvLog.h"
 #include "ApvlvParams.h"
 #include "ApvlvSearch.h"
+#include "ApvlvTrace.h"
+#include "ApvlvUtil.h"
 
 namespace apvlv
 {
@@ -41,23 +47,9 @@ using namespace std;
 
 Searcher::Searcher () : mRestart (false), mQuit (false)
 {
+  resizeWorkers ();
   auto task = thread (&Searcher::dispatch, this);
   mTasks.emplace_back (std::move (task));
-
-  auto thread_count = thread::hardware_concurrency () - 1;
-  auto thread_value
-      = ApvlvParams::instance ()->getStringOrDefault ("thread_count", "auto");
-  if (thread_value != "auto")
-    {
-      thread_count = ApvlvParams::instance ()->getIntOrDefault ("thread_count",
-                                                                thread_count);
-    }
-
-  for (auto ind = 0u; ind < thread_count; ++ind)
-    {
-      task = thread (&Searcher::fileLoopFunc, this);
-      mTasks.emplace_back (std::move (task));
-    }
 }
 
 Searcher::~Searcher ()
@@ -65,18 +57,14 @@ Searcher::~Searcher ()
   mRestart.store (true);
   mQuit.store (true);
   std::ranges::for_each (mTasks, [] (thread &task) { task.join (); });
-  qDebug ("all search threads ended");
+  std::ranges::for_each (mWorkers, [] (thread &task) { task.join (); });
+  qCDebug (lcSearch) << "all search threads ended";
 }
 
 void
 Searcher::submit (const SearchOptions &options)
 {
   mOptions = options;
-  auto path = filesystem::path (options.mFromDir);
-  if (is_regular_file (path))
-    {
-      mFilenameQueue.push (absolute (path).string ());
-    }
   mRestart.store (true);
 }
 
@@ -88,17 +76,60 @@ Searcher::get ()
   return ptr;
 }
 
+SearchCorpus
+Searcher::corpus ()
+{
+  lock_guard<mutex> lock (mCorpusMutex);
+  if (mFinished.load () == false && mStoredCorpus
+      && mStoredCorpus->files >= mCorpus.files)
+    {
+      return mStoredCorpus.value ();
+    }
+  return mCorpus;
+}
+
+void
+Searcher::resizeWorkers ()
+{
+  auto thread_count = thread::hardware_concurrency () - 1;
+  auto thread_value = ApvlvParams::instance ()->get (IntParam::THREAD_COUNT);
+  if (thread_value > 0)
+    {
+      thread_count = thread_value;
+    }
+
+  mWorkerCount.store (thread_count);
+  for (auto ind = static_cast<unsigned int> (mWorkers.size ());
+       ind < thread_count; ++ind)
+    {
+      mWorkers.emplace_back (&Searcher::fileLoopFunc, this, ind);
+    }
+}
+
 void
 Searcher::dispatch ()
 {
   while (mQuit.load () == false)
     {
+      resizeWorkers ();
       if (mRestart.load () == true)
         {
           this_thread::sleep_for (2s);
 
           mFilenameQueue.clear ();
-          mResults.clear ();
+          {
+            // the workers of the last run check the generation under
+            // this lock before they give their results
+            lock_guard<mutex> lock (mCorpusMutex);
+            mResults.clear ();
+            mGeneration++;
+            mPending.store (0);
+            mScanned.store (false);
+            mFinished.store (false);
+            mCorpusKey = corpusKey (mOptions);
+            mCorpus = {};
+            mStoredCorpus = loadCorpus (mCorpusKey);
+          }
 
           mRestart.store (false);
 
@@ -110,6 +141,13 @@ Searcher::dispatch ()
             {
               qWarning () << "search occurred error: " << ext.what ();
             }
+
+          if (mRestart.load () == false)
+            {
+              mScanned.store (true);
+              if (mPending.load () == 0)
+                finish (mGeneration.load ());
+            }
         }
       else
         {
@@ -121,8 +159,18 @@ Searcher::dispatch ()
 void
 Searcher::dirFunc ()
 {
-  qDebug () << "searching " << QString::fromLocal8Bit (mOptions.mText)
-            << " from " << QString::fromLocal8Bit (mOptions.mFromDir);
+  APVLV_TRACE ("search");
+  qCDebug (lcSearch) << "searching " << QString::fromLocal8Bit (mOptions.mText)
+                     << " from " << QString::fromLocal8Bit (mOptions.mFromDir);
+  auto from = filesystem::path (mOptions.mFromDir);
+  if (filesystem::is_regular_file (from))
+    {
+      mPending++;
+      mFilenameQueue.push ({ mGeneration.load (),
+                             filesystem::absolute (from).string () });
+      return;
+    }
+
   stack<string> dirs;
   dirs.push (mOptions.mFromDir);
   while (!dirs.empty ())
@@ -159,7 +207,9 @@ Searcher::dirFunc ()
                           entry.path ().extension ());
               if (titr != mOptions.mTypes.end ())
                 {
-                  mFilenameQueue.push (entry.path ().string ());
+                  mPending++;
+                  mFilenameQueue.push (
+                      { mGeneration.load (), entry.path ().string () });
                 }
             }
         }
@@ -167,14 +217,14 @@ Searcher::dirFunc ()
 }
 
 void
-Searcher::fileLoopFunc ()
+Searcher::fileLoopFunc (unsigned int index)
 {
   while (mQuit.load () == false)
     {
-      string name;
-      if (mFilenameQueue.pop (name))
+      pair<unsigned int, string> name;
+      if (index < mWorkerCount.load () && mFilenameQueue.pop (name))
         {
-          fileFunc (name);
+          fileFunc (name.second, name.first);
         }
       else
         {
@@ -184,17 +234,265 @@ Searcher::fileLoopFunc ()
 }
 
 void
-Searcher::fileFunc (const string &path)
+Searcher::fileFunc (const string &path, unsigned int generation)
 {
+  APVLV_TRACE ("search.file");
+  SearchCorpus stats;
+  unique_ptr<SearchFileMatch> result;
   auto file = FileFactory::loadFile (path);
   if (file)
     {
-      qDebug () << "searching for " << QString::fromLocal8Bit (path);
-      auto result = file->grepFile (mOptions.mText, mOptions.mCaseSensitive,
-                                    mOptions.mRegex, mRestart);
-      if (result)
-        mResults.push (std::move (result));
+      qCDebug (lcSearch) << "searching for " << QString::fromLocal8Bit (path);
+      result = file->grepFile (mOptions.mText, mOptions.mCaseSensitive,
+                               mOptions.mRegex, mRestart, &stats);
     }
+
+  bool done;
+  {
+    lock_guard<mutex> lock (mCorpusMutex);
+    // the search was restarted while this file was grepped
+    if (generation != mGeneration.load ())
+      return;
+
+    mCorpus.files += stats.files;
+    mCorpus.pages += stats.pages;
+    mCorpus.terms += stats.terms;
+    if (result)
+      mResults.push (std::move (result));
+    done = --mPending == 0 && mScanned.load ();
+  }
+
+  if (done)
+    finish (generation);
+}
+
+void
+Searcher::finish (unsigned int generation)
+{
+  string key;
+  SearchCorpus corpus;
+  {
+    lock_guard<mutex> lock (mCorpusMutex);
+    if (generation != mGeneration.load () || mFinished.exchange (true))
+      return;
+
+    key = mCorpusKey;
+    corpus = mCorpus;
+  }
+
+  qCDebug (lcSearch) << "search finished, " << corpus.files << " files, "
+                     << corpus.pages << " pages, " << corpus.terms << " terms";
+  if (corpus.files > 0)
+    saveCorpus (key, corpus);
+}
+
+string
+Searcher::corpusKey (const SearchOptions &options)
+{
+  auto key = options.mFromDir + "|";
+  for (auto const &type : options.mTypes)
+    {
+      key += type + ",";
+    }
+  return key;
+}
+
+optional<SearchCorpus>
+Searcher::loadCorpus (const string &key)
+{
+  ifstream ifs{ CacheDir + PATH_SEP_S + "search-corpus" };
+  string line;
+  while (getline (ifs, line))
+    {
+      auto tab = line.find ('\t');
+      if (tab == string::npos || line.substr (tab + 1) != key)
+        continue;
+
+      SearchCorpus corpus;
+      istringstream iss{ line.substr (0, tab) };
+      if (iss >> corpus.files >> corpus.pages >> corpus.terms)
+        return corpus;
+    }
+
+  return nullopt;
+}
+
+void
+Searcher::saveCorpus (const string &key, const SearchCorpus &corpus)
+{
+  auto path = CacheDir + PATH_SEP_S + "search-corpus";
+  vector<string> lines;
+  {
+    ifstream ifs{ path };
+    string line;
+    while (getline (ifs, line))
+      {
+        auto tab = line.find ('\t');
+        if (tab != string::npos && line.substr (tab + 1) != key)
+          lines.emplace_back (line);
+      }
+  }
+
+  error_code code;
+  filesystem::create_directories (CacheDir, code);
+
+  auto tmp = path + ".tmp";
+  ofstream ofs{ tmp };
+  if (!ofs.is_open ())
+    {
+      qWarning () << "can't save search corpus to " << path;
+      return;
+    }
+  for (auto const &line : lines)
+    {
+      ofs << line << "\n";
+    }
+  ofs << corpus.files << " " << corpus.pages << " " << corpus.terms << "\t"
+      << key << "\n";
+  ofs.close ();
+  filesystem::rename (tmp, path, code);
+}
+
+constexpr double BM25_K1 = 1.2;
+constexpr double BM25_B = 0.75;
+
+static double
+bm25 (double tf, double length, double average)
+{
+  if (average <= 0.0)
+    average = std::max (length, 1.0);
+  auto norm = BM25_K1 * (1.0 - BM25_B + BM25_B * length / average);
+  return tf * (BM25_K1 + 1.0) / (tf + norm);
+}
+
+static bool
+rankLess (const SearchRanker::Row &a, const SearchRanker::Row &b)
+{
+  if (a.file_score != b.file_score)
+    return a.file_score > b.file_score;
+  if (a.file != b.file)
+    return a.file < b.file;
+  if (a.page_score != b.page_score)
+    return a.page_score > b.page_score;
+  return a.seq < b.seq;
+}
+
+void
+SearchRanker::clear ()
+{
+  mFiles.clear ();
+  mFileScores.clear ();
+  mRows.clear ();
+  mPositions.clear ();
+  mRanked = 0;
+  mScoredFiles = 0;
+  mCorpus = {};
+  mPageAverage = 0.0;
+  mFileAverage = 0.0;
+}
+
+size_t
+SearchRanker::append (unique_ptr<SearchFileMatch> result)
+{
+  auto file = static_cast<uint32_t> (mFiles.size ());
+  auto first = mRows.size ();
+  for (size_t p = 0; p < result->page_matches.size (); ++p)
+    {
+      auto const &page = result->page_matches[p];
+      for (size_t m = 0; m < page.matches.size (); ++m)
+        {
+          auto seq = static_cast<uint32_t> (mRows.size ());
+          mRows.push_back ({ file, static_cast<uint32_t> (p),
+                             static_cast<uint32_t> (m), seq, 0.0, 0.0 });
+          mPositions.push_back (mRows.size () - 1);
+        }
+    }
+
+  mFiles.push_back (std::move (result));
+  mFileScores.push_back (0.0);
+  return mRows.size () - first;
+}
+
+bool
+SearchRanker::rank (const SearchCorpus &corpus)
+{
+  auto page_average = corpus.pages > 0 ? double (corpus.terms) / corpus.pages
+                                       : 0.0;
+  auto file_average = corpus.files > 0 ? double (corpus.terms) / corpus.files
+                                       : 0.0;
+  auto drift = [] (double value, double last) {
+    return last <= 0.0 || std::fabs (value - last) > last * 0.01;
+  };
+
+  auto full = mRanked == 0 || drift (page_average, mPageAverage)
+              || drift (file_average, mFileAverage);
+  mCorpus = corpus;
+  if (!full && mRanked == mRows.size ())
+    return false;
+
+  if (full)
+    {
+      mPageAverage = page_average;
+      mFileAverage = file_average;
+      mScoredFiles = 0;
+    }
+
+  for (auto f = mScoredFiles; f < mFiles.size (); ++f)
+    {
+      double tf = 0.0;
+      for (auto const &page : mFiles[f]->page_matches)
+        {
+          tf += static_cast<double> (page.matches.size ());
+        }
+      mFileScores[f] = bm25 (tf, static_cast<double> (mFiles[f]->terms),
+                             mFileAverage);
+    }
+  mScoredFiles = mFiles.size ();
+
+  // the scores are not shown, only the order is left to apply ()
+  mSortFrom = full ? 0 : mRanked;
+  auto first = mRows.begin () + static_cast<ptrdiff_t> (mSortFrom);
+  std::for_each (first, mRows.end (), [this] (Row &row) { score (row); });
+
+  // the ranked rows are sorted, the new ones only move when they are not
+  // in order after the last of them
+  auto from = mSortFrom > 0 ? first - 1 : first;
+  if (std::is_sorted (from, mRows.end (), rankLess))
+    {
+      mRanked = mRows.size ();
+      return false;
+    }
+  return true;
+}
+
+void
+SearchRanker::apply ()
+{
+  auto first = mRows.begin () + static_cast<ptrdiff_t> (mSortFrom);
+  if (mSortFrom == 0)
+    {
+      std::sort (mRows.begin (), mRows.end (), rankLess);
+    }
+  else
+    {
+      std::sort (first, mRows.end (), rankLess);
+      std::inplace_merge (mRows.begin (), first, mRows.end (), rankLess);
+    }
+  mRanked = mRows.size ();
+
+  for (size_t pos = 0; pos < mRows.size (); ++pos)
+    {
+      mPositions[mRows[pos].seq] = pos;
+    }
+}
+
+void
+SearchRanker::score (Row &row) const
+{
+  auto const &page = mFiles[row.file]->page_matches[row.page];
+  row.file_score = mFileScores[row.file];
+  row.page_score = bm25 (static_cast<double> (page.matches.size ()),
+                         static_cast<double> (page.terms), mPageAverage);
 }
 
 vector<pair<size_t, size_t>>
@@ -247,4 +545,19 @@ grep (const string &source, const string &text, bool is_case, bool is_regex)
   return results;
 }
 
+size_t
+countTerms (const string &source)
+{
+  size_t count = 0;
+  bool in_term = false;
+  for (auto c : source)
+    {
+      auto space = isspace (static_cast<unsigned char> (c)) != 0;
+      if (!space && !in_term)
+        ++count;
+      in_term = !space;
+    }
+  return count;
+}
+
 }
@@ -29,6 +29,10 @@
 #define _APVLV_SEARCH_H_
 
 #include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
 #include <thread>
 #include <vector>
@@ -52,12 +56,31 @@ struct SearchPageMatch
 {
   int page;
   SearchMatchList matches;
+  size_t terms{ 0 };
 };
 
 struct SearchFileMatch
 {
   std::string filename;
   std::vector<SearchPageMatch> page_matches;
+  size_t terms{ 0 };
+};
+
+//
+// collection statistics of a search, files and pages are the documents,
+// terms are the whitespace separated words of the extracted text
+//
+struct SearchCorpus
+{
+  std::uint64_t files{ 0 };
+  std::uint64_t pages{ 0 };
+  std::uint64_t terms{ 0 };
+
+  friend bool
+  operator== (const SearchCorpus &a, const SearchCorpus &b)
+  {
+    return a.files == b.files && a.pages == b.pages && a.terms == b.terms;
+  }
 };
 
 class SearchOptions
@@ -87,26 +110,137 @@ public:
 
   void submit (const SearchOptions &options);
   std::unique_ptr<SearchFileMatch> get ();
+  SearchCorpus corpus ();
 
 private:
   void dispatch ();
   void dirFunc ();
-  void fileLoopFunc ();
-  void fileFunc (const std::string &path);
+  // the workers follow the thread_count setting, the ones beyond it idle
+  void resizeWorkers ();
+  void fileLoopFunc (unsigned int index);
+  void fileFunc (const std::string &path, unsigned int generation);
+  void finish (unsigned int generation);
+
+  static std::string corpusKey (const SearchOptions &options);
+  static std::optional<SearchCorpus> loadCorpus (const std::string &key);
+  static void saveCorpus (const std::string &key, const SearchCorpus &corpus);
 
   std::vector<std::thread> mTasks;
+  // grown by the dispatch thread, joined after it
+  std::vector<std::thread> mWorkers;
+  std::atomic<unsigned int> mWorkerCount{ 0 };
 
   SearchOptions mOptions;
-  LockQueue<std::string> mFilenameQueue;
+  LockQueue<std::pair<unsigned int, std::string>> mFilenameQueue;
   LockQueue<std::unique_ptr<SearchFileMatch>> mResults;
   std::atomic<bool> mRestart;
   std::atomic<bool> mQuit;
+
+  std::atomic<unsigned int> mGeneration{ 0 };
+  std::atomic<std::int64_t> mPending{ 0 };
+  std::atomic<bool> mScanned{ false };
+  std::atomic<bool> mFinished{ false };
+
+  // also held to reset a run and to give a result to it
+  std::mutex mCorpusMutex;
+  std::string mCorpusKey;
+  SearchCorpus mCorpus;
+  std::optional<SearchCorpus> mStoredCorpus;
+};
+
+//
+// BM25 ranking of the streamed search results
+//
+// Every matched line is a row, rows are grouped by file, files are ordered
+// by their BM25 score, pages inside a file by the page BM25 score, equal
+// scores keep the arrival order.
+//
+// The query is searched as one phrase, so its idf is the same for every
+// document and only the term frequency part of BM25 decides the order.
+// New rows are merged into the ranked ones, the whole list is only sorted
+// again when the average document length of the corpus drifts.
+//
+class SearchRanker
+{
+public:
+  struct Row
+  {
+    std::uint32_t file;
+    std::uint32_t page;
+    std::uint32_t match;
+    std::uint32_t seq;
+    double file_score;
+    double page_score;
+  };
+
+  void clear ();
+
+  size_t append (std::unique_ptr<SearchFileMatch> result);
+
+  // scores the rows, true when a row has to move and apply () has to sort
+  // them, an order that moves no row is taken at once
+  bool rank (const SearchCorpus &corpus);
+  void apply ();
+
+  [[nodiscard]] size_t
+  size () const
+  {
+    return mRows.size ();
+  }
+
+  [[nodiscard]] const Row &
+  row (size_t pos) const
+  {
+    return mRows[pos];
+  }
+
+  [[nodiscard]] size_t
+  position (std::uint32_t seq) const
+  {
+    return mPositions[seq];
+  }
+
+  [[nodiscard]] const SearchFileMatch &
+  file (const Row &row) const
+  {
+    return *mFiles[row.file];
+  }
+
+  [[nodiscard]] const SearchPageMatch &
+  page (const Row &row) const
+  {
+    return mFiles[row.file]->page_matches[row.page];
+  }
+
+  [[nodiscard]] const SearchMatch &
+  match (const Row &row) const
+  {
+    return page (row).matches[row.match];
+  }
+
+private:
+  void score (Row &row) const;
+
+  std::vector<std::unique_ptr<SearchFileMatch>> mFiles;
+  std::vector<double> mFileScores;
+  std::vector<Row> mRows;
+  std::vector<size_t> mPositions;
+  size_t mRanked{ 0 };
+  // the first row apply () sorts, the rows before it are merged
+  size_t mSortFrom{ 0 };
+  size_t mScoredFiles{ 0 };
+
+  SearchCorpus mCorpus;
+  double mPageAverage{ 0.0 };
+  double mFileAverage{ 0.0 };
 };
 
 std::vector<std::pair<size_t, size_t>> grep (const std::string &source,
                                              const std::string &text,
                                              bool is_case, bool is_regex);
 
+size_t countTerms (const std::string &source);
+
 }
 
 #endif
@@ -27,16 +27,107 @@
 
 #include <QFileDialog>
 #include <algorithm>
+#include <map>
 #include <regex>
 #include <stack>
 
 #include "ApvlvFile.h"
+#include "ApvlvNoteCatalog.h"
 #include "ApvlvSearchDialog.h"
 
 namespace apvlv
 {
 using namespace std;
 
+SearchResultModel::SearchResultModel (QObject *parent)
+    : QAbstractListModel (parent)
+{
+}
+
+void
+SearchResultModel::clear ()
+{
+  beginResetModel ();
+  mRanker.clear ();
+  mCorpus = {};
+  endResetModel ();
+}
+
+void
+SearchResultModel::append (vector<unique_ptr<SearchFileMatch>> results,
+                           const SearchCorpus &corpus)
+{
+  if (results.empty () && corpus == mCorpus)
+    return;
+
+  for (auto &result : results)
+    {
+      auto first = static_cast<int> (mRanker.size ());
+      auto count = static_cast<int> (mRanker.append (std::move (result)));
+      if (count > 0)
+        {
+          // new rows are appended unranked, the ranking below moves them
+          beginInsertRows ({}, first, first + count - 1);
+          endInsertRows ();
+        }
+    }
+
+  mCorpus = corpus;
+  if (!mRanker.rank (mCorpus))
+    return;
+
+  // the ranked order is staged, the view only hears of it when rows move
+  emit layoutAboutToBeChanged ();
+  auto persistents = persistentIndexList ();
+  vector<size_t> seqs;
+  seqs.reserve (persistents.size ());
+  for (auto const &index : persistents)
+    {
+      seqs.push_back (mRanker.row (index.row ()).seq);
+    }
+
+  mRanker.apply ();
+  QModelIndexList moved;
+  moved.reserve (persistents.size ());
+  for (auto seq : seqs)
+    {
+      moved.append (index (static_cast<int> (mRanker.position (seq)), 0));
+    }
+  changePersistentIndexList (persistents, moved);
+  emit layoutChanged ();
+}
+
+int
+SearchResultModel::rowCount (const QModelIndex &parent) const
+{
+  if (parent.isValid ())
+    return 0;
+  return static_cast<int> (mRanker.size ());
+}
+
+QVariant
+SearchResultModel::data (const QModelIndex &index, int role) const
+{
+  if (!index.isValid () || index.row () >= rowCount ({}))
+    return {};
+
+  auto const &row = mRanker.row (index.row ());
+  auto const &file = mRanker.file (row);
+  auto const &page = mRanker.page (row);
+  auto path = QString::fromLocal8Bit (file.filename);
+  switch (role)
+    {
+    case Qt::DisplayRole:
+      return QString::fromLocal8Bit (mRanker.match (row).line);
+    case Qt::ToolTipRole:
+      return path + ':' + QString::number (page.page + 1);
+    case Qt::UserRole:
+      return QStringList{ path, QString::number (page.page) };
+    default:
+      return {};
+    }
+}
+
 SearchDialog::SearchDialog (QWidget *parent)
     : QDialog (parent), mPreviewIsFinished (true)
 {
@@ -71,6 +162,10 @@ SearchDialog::SearchDialog (QWidget *parent)
   mRegex.setText (tr ("Regular expression"));
   mHBox.addWidget (&mRegex);
 
+  mNotes.setText (tr ("Notes"));
+  mHBox.addWidget (&mNotes);
+  NoteCatalog::instance ()->refresh ();
+
   // file type line
   mVBox.addLayout (&mHBox3);
 
@@ -86,15 +181,17 @@ SearchDialog::SearchDialog (QWidget *parent)
 
   mSplitter.setOrientation (Qt::Vertical);
 
+  mResults.setModel (&mResultModel);
+  mResults.setUniformItemSizes (true);
+  mResults.setSelectionMode (QAbstractItemView::SingleSelection);
   mSplitter.addWidget (&mResults);
   mSplitter.addWidget (&mPreview);
   mPreview.resize (400, 300);
-  QObject::connect (
-      &mResults,
-      SIGNAL (currentItemChanged (QListWidgetItem *, QListWidgetItem *)), this,
-      SLOT (previewItem (QListWidgetItem *)));
-  QObject::connect (&mResults, SIGNAL (itemActivated (QListWidgetItem *)),
-                    this, SLOT (activateItem (QListWidgetItem *)));
+  QObject::connect (mResults.selectionModel (),
+                    SIGNAL (currentChanged (QModelIndex, QModelIndex)), this,
+                    SLOT (previewItem (QModelIndex)));
+  QObject::connect (&mResults, SIGNAL (activated (QModelIndex)), this,
+                    SLOT (activateItem (QModelIndex)));
   QObject::connect (&mPreview, SIGNAL (loadFinished (bool)), this,
                     SLOT (loadFinish (bool)));
 
@@ -103,9 +200,26 @@ SearchDialog::SearchDialog (QWidget *parent)
   mGetTimer.start (100);
 }
 
+void
+SearchDialog::searchNotes (const QString &query)
+{
+  mNotes.setChecked (true);
+  mSearchEdit.setText (query);
+  search ();
+  show ();
+}
+
 void
 SearchDialog::search ()
 {
+  if (mNotes.isChecked ())
+    {
+      // a document search after it starts again
+      mOptions = SearchOptions{};
+      showNotes (mSearchEdit.text ().trimmed ().toStdString ());
+      return;
+    }
+
   SearchOptions options;
   options.mText = mSearchEdit.text ().trimmed ().toStdString ();
   options.mCaseSensitive = mCaseSensitive.isChecked ();
@@ -121,30 +235,77 @@ SearchDialog::search ()
     return;
 
   mSearcher.submit (options);
-  mResults.clear ();
+  mResultModel.clear ();
   mOptions = options;
 }
 
 void
 SearchDialog::getResults ()
 {
+  vector<unique_ptr<SearchFileMatch>> results;
   unique_ptr<SearchFileMatch> result;
   while ((result = mSearcher.get ()) != nullptr)
     {
-      displayResult (std::move (result));
+      results.emplace_back (std::move (result));
+    }
+
+  // the notes are shown instead
+  if (mNotes.isChecked ())
+    return;
+
+  mResultModel.append (std::move (results), mSearcher.corpus ());
+}
+
+void
+SearchDialog::showNotes (const string &query)
+{
+  auto matches = NoteCatalog::instance ()->query (NoteQuery::parse (query));
+
+  // a file of the results is a document, a page holds its comments
+  vector<unique_ptr<SearchFileMatch>> results;
+  map<string, size_t> files;
+  SearchCorpus corpus;
+  for (auto &match : matches)
+    {
+      auto [itr, added] = files.emplace (match.document, results.size ());
+      if (added)
+        {
+          results.push_back (make_unique<SearchFileMatch> ());
+          results.back ()->filename = match.document;
+          corpus.files++;
+        }
+
+      auto &file = *results[itr->second];
+      if (file.page_matches.empty ()
+          || file.page_matches.back ().page != match.page)
+        {
+          file.page_matches.push_back ({ match.page, {} });
+          corpus.pages++;
+        }
+
+      auto terms = countTerms (match.line);
+      auto &page = file.page_matches.back ();
+      page.matches.push_back (
+          { match.line, match.line, 0, match.line.size () });
+      page.terms += terms;
+      file.terms += terms;
+      corpus.terms += terms;
     }
+
+  mResultModel.clear ();
+  mResultModel.append (std::move (results), corpus);
 }
 
 void
-SearchDialog::previewItem (QListWidgetItem *item)
+SearchDialog::previewItem (const QModelIndex &index)
 {
-  if (item == nullptr)
+  if (!index.isValid ())
     return;
 
   if (mPreviewIsFinished == false)
     return;
 
-  auto words = item->data (Qt::UserRole).toStringList ();
+  auto words = index.data (Qt::UserRole).toStringList ();
   auto path = words[0].toStdString ();
   auto pn = words[1].toInt ();
   if (mPreviewFile && mPreviewFile->getFilename () != path)
@@ -162,34 +323,18 @@ SearchDialog::previewItem (QListWidgetItem *item)
 }
 
 void
-SearchDialog::activateItem (QListWidgetItem *item)
+SearchDialog::activateItem (const QModelIndex &index)
 {
-  auto words = item->data (Qt::UserRole).toStringList ();
+  if (!index.isValid ())
+    return;
+
+  auto words = index.data (Qt::UserRole).toStringList ();
   auto path = words[0];
   auto pn = words[1].toInt ();
   emit loadFile (path.toStdString (), pn);
   // accept ();
 }
 
-void
-SearchDialog::displayResult (unique_ptr<SearchFileMatch> result)
-{
-  auto line = QString::fromLocal8Bit (result->filename);
-  for (const auto &page : result->page_matches)
-    {
-      auto pos = line + ':' + QString::number (page.page + 1);
-      for_each (page.matches.begin (), page.matches.end (),
-                [&] (const auto &match) {
-                  auto matchitem = new QListWidgetItem (
-                      { QString::fromLocal8Bit (match.line) });
-                  matchitem->setToolTip (pos);
-                  QStringList data{ line, QString::number (page.page) };
-                  matchitem->setData (Qt::UserRole, data);
-                  mResults.addItem (matchitem);
-                });
-    }
-}
-
 void
 SearchDialog::loadFinish ([[maybe_unused]] bool ret)
 {
@@ -28,11 +28,12 @@
 #ifndef _APVLV_SEARCH_DIALOG_H_
 #define _APVLV_SEARCH_DIALOG_H_
 
+#include <QAbstractListModel>
 #include <QCheckBox>
 #include <QDialog>
 #include <QLabel>
 #include <QLineEdit>
-#include <QListWidget>
+#include <QListView>
 #include <QPushButton>
 #include <QSplitter>
 #include <QTimer>
@@ -40,11 +41,36 @@
 #include <string>
 #include <vector>
 
+#include "ApvlvSearch.h"
 #include "ApvlvWebViewWidget.h"
 
 namespace apvlv
 {
 
+//
+// the ranked search results, rows are only materialized by the view
+// when they are painted
+//
+class SearchResultModel : public QAbstractListModel
+{
+  Q_OBJECT
+public:
+  explicit SearchResultModel (QObject *parent = nullptr);
+  ~SearchResultModel () override = default;
+
+  void clear ();
+  void append (std::vector<std::unique_ptr<SearchFileMatch>> results,
+               const SearchCorpus &corpus);
+
+  [[nodiscard]] int rowCount (const QModelIndex &parent) const override;
+  [[nodiscard]] QVariant data (const QModelIndex &index,
+                               int role) const override;
+
+private:
+  SearchRanker mRanker;
+  SearchCorpus mCorpus;
+};
+
 class File;
 class SearchDialog : public QDialog
 {
@@ -53,19 +79,20 @@ public:
   explicit SearchDialog (QWidget *parent = nullptr);
   ~SearchDialog () override = default;
 
+  // the query of the notes catalog, see NoteQuery
+  void searchNotes (const QString &query);
+
 signals:
   void loadFile (const std::string &path, int pn);
 
 private slots:
   void search ();
   void getResults ();
-  void previewItem (QListWidgetItem *item);
-  void activateItem (QListWidgetItem *item);
+  void previewItem (const QModelIndex &index);
+  void activateItem (const QModelIndex &index);
   void loadFinish (bool ret);
 
 private:
-  void displayResult (std::unique_ptr<SearchFileMatch> result);
-
   QVBoxLayout mVBox;
   QHBoxLayout mHBox2;
   QHBoxLayout mHBox;
@@ -85,13 +112,17 @@ private:
   QLineEdit mSearchEdit;
   QCheckBox mCaseSensitive;
   QCheckBox mRegex;
+  QCheckBox mNotes;
   std::vector<QCheckBox *> mTypes;
   QLineEdit mFromDir;
-  QListWidget mResults;
+  SearchResultModel mResultModel;
+  QListView mResults;
   WebView mPreview;
 
   std::unique_ptr<File> mPreviewFile;
   bool mPreviewIsFinished;
+
+  void showNotes (const std::string &query);
 };
 
 }
@@ -0,0 +1,569 @@
+/*
+ * This file is part of the apvlv package
+ *
+ * Copyright (C) 2008 Alf.
+ *
+ * Contact: Alf <naihe2010@126.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2.0 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+/* @CPPFILE ApvlvThumbnail.cc
+ *
+ *  Author: Alf <naihe2010@126.com>
+ */
+
+#include <QBuffer>
+#include <QDebug>
+#include <algorithm>
+#include <filesystem>
+#include <numeric>
+#include <sstream>
+
+#include "ApvlvFile.h"
+#include "ApvlvParams.h"
+#include "ApvlvThumbnail.h"
+#include "ApvlvUtil.h"
+
+namespace apvlv
+{
+
+using namespace std;
+
+const int REQUEST_INTERVAL = 300;
+const int SCAN_STEP = 8;
+const int STRIP_MARGIN = 40;
+
+static string
+imageKey (const string &path, int pn)
+{
+  return path + "\n" + to_string (pn);
+}
+
+ThumbnailCache::ThumbnailCache () = default;
+
+ThumbnailCache::~ThumbnailCache ()
+{
+  mQuit.store (true);
+  for (auto &task : mTasks)
+    {
+      task.join ();
+    }
+}
+
+QImage
+ThumbnailCache::find (const string &path, int pn)
+{
+  lock_guard<mutex> lock (mMutex);
+  auto itr = mImageIndex.find (imageKey (path, pn));
+  if (itr == mImageIndex.end ())
+    return {};
+
+  mImages.splice (mImages.begin (), mImages, itr->second);
+  return itr->second->second;
+}
+
+void
+ThumbnailCache::request (const string &path, const vector<int> &pages,
+                         bool visible)
+{
+  lock_guard<mutex> lock (mMutex);
+  if (visible)
+    {
+      mVisible.clear ();
+      for (auto pn : pages)
+        {
+          mVisible.push_back ({ path, pn });
+        }
+    }
+  else
+    {
+      // the background requests follow the current document
+      if (path != mQueuePath)
+        {
+          mQueue.clear ();
+          mQueued.clear ();
+          mQueuePath = path;
+        }
+      for (auto pn : pages)
+        {
+          if (mQueued.insert (pn).second)
+            mQueue.push_back ({ path, pn });
+        }
+    }
+
+  auto params = ApvlvParams::instance ();
+  auto count = params->get (IntParam::THUMBNAIL_THREADS);
+  auto limit = static_cast<int> (thread::hardware_concurrency ());
+  count = std::clamp (count, 1, std::max (limit, 1));
+  mWorkers.store (count);
+  for (auto i = static_cast<int> (mTasks.size ()); i < count; ++i)
+    {
+      mTasks.emplace_back (&ThumbnailCache::workerLoop, this, i);
+    }
+}
+
+void
+ThumbnailCache::workerLoop (int index)
+{
+  // every worker renders with its own File
+  string path;
+  unique_ptr<File> file;
+  while (mQuit.load () == false)
+    {
+      Task task;
+      if (index < mWorkers.load () && pop (task))
+        {
+          render (task, path, file);
+        }
+      else
+        {
+          this_thread::sleep_for (100ms);
+        }
+    }
+}
+
+bool
+ThumbnailCache::pop (Task &task)
+{
+  lock_guard<mutex> lock (mMutex);
+  auto &queue = mVisible.empty () ? mQueue : mVisible;
+  if (queue.empty ())
+    return false;
+
+  task = std::move (queue.front ());
+  task.visible = &queue == &mVisible;
+  queue.pop_front ();
+  if (&queue == &mQueue)
+    mQueued.erase (task.pn);
+  return true;
+}
+
+void
+ThumbnailCache::render (const Task &task, string &path,
+                        unique_ptr<File> &file)
+{
+  auto key = imageKey (task.path, task.pn);
+  store (task.path);
+  pair<streamoff, size_t> page{ 0, 0 };
+  {
+    lock_guard<mutex> lock (mMutex);
+    if (mImageIndex.contains (key))
+      return;
+    auto const &pages = mStores[task.path].pages;
+    if (auto itr = pages.find (task.pn); itr != pages.end ())
+      {
+        // the stored pages are only decoded for the strip
+        if (!task.visible)
+          return;
+        page = itr->second;
+      }
+    if (!mRendering.insert (key).second)
+      return;
+  }
+
+  QImage image;
+  if (page.second > 0)
+    image = loadImage (task.path, page);
+
+  // a stored page that can't be read is rendered again
+  if (image.isNull ())
+    {
+      if (path != task.path)
+        {
+          path = task.path;
+          file = FileFactory::loadFile (path);
+        }
+
+      string bytes;
+      if (file && task.pn >= 0 && task.pn < file->sum ())
+        {
+          auto size = file->pageSizeF (task.pn, 0);
+          if (size.height > 0
+              && file->pageRenderToImage (
+                  task.pn, THUMBNAIL_HEIGHT / size.height, 0, &image))
+            {
+              QByteArray array;
+              QBuffer buffer (&array);
+              buffer.open (QIODevice::WriteOnly);
+              image.save (&buffer, "JPG", 80);
+              bytes = array.toStdString ();
+            }
+        }
+
+      if (bytes.empty ())
+        {
+          qDebug () << "can't render thumbnail " << task.pn << " of "
+                    << QString::fromLocal8Bit (task.path);
+          lock_guard<mutex> lock (mMutex);
+          mRendering.erase (key);
+          return;
+        }
+
+      appendStore (task.path, task.pn, bytes);
+    }
+
+  {
+    lock_guard<mutex> lock (mMutex);
+    mRendering.erase (key);
+    remember (key, image);
+  }
+  emit rendered (QString::fromLocal8Bit (task.path), task.pn);
+}
+
+void
+ThumbnailCache::store (const string &path)
+{
+  Store doc;
+  error_code code;
+  doc.size = filesystem::file_size (path, code);
+  auto mtime = filesystem::last_write_time (path, code);
+  if (!code)
+    doc.mtime = filesystemTimeToMSeconds (mtime);
+
+  {
+    lock_guard<mutex> lock (mMutex);
+    auto itr = mStores.find (path);
+    if (itr != mStores.end () && itr->second.mtime == doc.mtime
+        && itr->second.size == doc.size)
+      return;
+  }
+
+  if (!loadStore (path, doc))
+    doc.pages.clear ();
+
+  lock_guard<mutex> lock (mMutex);
+  auto itr = mStores.find (path);
+  if (itr != mStores.end () && itr->second.mtime == doc.mtime
+      && itr->second.size == doc.size)
+    return;
+
+  // the images of the changed document are rendered again
+  mStores[path] = std::move (doc);
+  auto prefix = imageKey (path, 0);
+  prefix.pop_back ();
+  for (auto image = mImages.begin (); image != mImages.end ();)
+    {
+      if (image->first.starts_with (prefix))
+        {
+          mImageIndex.erase (image->first);
+          image = mImages.erase (image);
+        }
+      else
+        {
+          ++image;
+        }
+    }
+}
+
+string
+ThumbnailCache::storePath (const string &path)
+{
+  stringstream ss;
+  ss << hex << std::hash<string>{}(path);
+  return CacheDir + PATH_SEP_S + "thumbnail" + PATH_SEP_S + ss.str ();
+}
+
+bool
+ThumbnailCache::loadStore (const string &path, Store &doc)
+{
+  ifstream ifs{ storePath (path), ios::binary };
+  if (!ifs.is_open ())
+    return false;
+
+  string line;
+  getline (ifs, line);
+  stringstream header;
+  header << "apvlv-thumbnail 1 " << doc.mtime << " " << doc.size << "\t"
+         << path;
+  if (line != header.str ())
+    {
+      qDebug () << "thumbnails of " << QString::fromLocal8Bit (path)
+                << " are stale";
+      return false;
+    }
+
+  // only the offsets are read, the images are decoded when shown
+  string tag;
+  int pn;
+  size_t length;
+  while (ifs >> tag >> pn >> length && tag == "page")
+    {
+      ifs.get ();
+      auto offset = ifs.tellg ();
+      ifs.seekg (static_cast<streamoff> (length), ios::cur);
+      // a truncated tail is rendered again
+      if (ifs.get () != '\n')
+        break;
+      doc.pages[pn] = { offset, length };
+    }
+
+  return true;
+}
+
+QImage
+ThumbnailCache::loadImage (const string &path,
+                           const pair<streamoff, size_t> &page)
+{
+  ifstream ifs{ storePath (path), ios::binary };
+  string bytes (page.second, '\0');
+  ifs.seekg (page.first);
+  ifs.read (bytes.data (), static_cast<streamsize> (bytes.size ()));
+  if (!ifs)
+    return {};
+
+  QImage image;
+  image.loadFromData (QByteArray::fromStdString (bytes), "JPG");
+  return image;
+}
+
+void
+ThumbnailCache::appendStore (const string &path, int pn, const string &bytes)
+{
+  // the workers write one at a time, without the lock of find
+  lock_guard<mutex> write (mWriteMutex);
+  int64_t mtime;
+  uintmax_t size;
+  bool fresh;
+  {
+    lock_guard<mutex> lock (mMutex);
+    auto const &doc = mStores[path];
+    mtime = doc.mtime;
+    size = doc.size;
+    fresh = doc.pages.empty ();
+  }
+
+  auto filename = storePath (path);
+  error_code code;
+  if (fresh)
+    filesystem::create_directories (filesystem::path (filename).parent_path (),
+                                    code);
+
+  ofstream ofs{ filename, ios::binary | (fresh ? ios::trunc : ios::app) };
+  if (!ofs.is_open ())
+    {
+      qWarning () << "can't write thumbnails " << filename;
+      return;
+    }
+
+  if (fresh)
+    ofs << "apvlv-thumbnail 1 " << mtime << " " << size << "\t" << path
+        << "\n";
+  ofs << "page " << pn << " " << bytes.size () << "\n";
+  auto offset = static_cast<streamoff> (ofs.tellp ());
+  ofs << bytes << "\n";
+  if (!ofs)
+    return;
+
+  // the document may have changed while the page was written
+  lock_guard<mutex> lock (mMutex);
+  auto &doc = mStores[path];
+  if (doc.mtime == mtime && doc.size == size)
+    doc.pages[pn] = { offset, bytes.size () };
+}
+
+void
+ThumbnailCache::remember (const string &key, const QImage &image)
+{
+  if (auto itr = mImageIndex.find (key); itr != mImageIndex.end ())
+    {
+      mImages.erase (itr->second);
+      mImageIndex.erase (itr);
+    }
+
+  mImages.emplace_front (key, image);
+  mImageIndex[key] = mImages.begin ();
+  // 256 of them are about 16M
+  auto images = ApvlvParams::instance ()->get (IntParam::THUMBNAIL_CACHE);
+  while (mImages.size () > static_cast<size_t> (std::max (images, 1)))
+    {
+      mImageIndex.erase (mImages.back ().first);
+      mImages.pop_back ();
+    }
+}
+
+ThumbnailModel::ThumbnailModel ()
+    : mPlaceholder (ThumbnailCache::THUMBNAIL_HEIGHT * 3 / 4,
+                    ThumbnailCache::THUMBNAIL_HEIGHT)
+{
+  mPlaceholder.fill (Qt::lightGray);
+  QObject::connect (ThumbnailCache::instance (),
+                    SIGNAL (rendered (const QString &, int)), this,
+                    SLOT (onRendered (const QString &, int)));
+}
+
+void
+ThumbnailModel::setFile (const string &path, int pages)
+{
+  beginResetModel ();
+  mPath = path;
+  mPages = pages;
+  endResetModel ();
+}
+
+int
+ThumbnailModel::rowCount (const QModelIndex &parent) const
+{
+  return parent.isValid () ? 0 : mPages;
+}
+
+QVariant
+ThumbnailModel::data (const QModelIndex &index, int role) const
+{
+  if (!index.isValid () || index.row () >= mPages)
+    return {};
+
+  if (role == Qt::DisplayRole)
+    {
+      return QString::number (index.row () + 1);
+    }
+  else if (role == Qt::DecorationRole)
+    {
+      auto image = ThumbnailCache::instance ()->find (mPath, index.row ());
+      if (image.isNull ())
+        return mPlaceholder;
+      return QPixmap::fromImage (image);
+    }
+
+  return {};
+}
+
+void
+ThumbnailModel::onRendered (const QString &path, int pn)
+{
+  if (pn < 0 || pn >= mPages || path.toLocal8Bit ().toStdString () != mPath)
+    return;
+
+  auto changed = index (pn);
+  emit dataChanged (changed, changed, { Qt::DecorationRole });
+}
+
+ThumbnailStrip::ThumbnailStrip ()
+{
+  setModel (&mModel);
+  setFlow (QListView::LeftToRight);
+  setWrapping (false);
+  setUniformItemSizes (true);
+  setSelectionMode (QAbstractItemView::SingleSelection);
+  setIconSize (QSize (ThumbnailCache::THUMBNAIL_HEIGHT,
+                      ThumbnailCache::THUMBNAIL_HEIGHT));
+  setVerticalScrollBarPolicy (Qt::ScrollBarAlwaysOff);
+  setFixedHeight (ThumbnailCache::THUMBNAIL_HEIGHT + STRIP_MARGIN);
+
+  QObject::connect (this, SIGNAL (clicked (const QModelIndex &)), this,
+                    SLOT (onClicked (const QModelIndex &)));
+  QObject::connect (&mRequestTimer, SIGNAL (timeout ()), this,
+                    SLOT (requestVisible ()));
+  mRequestTimer.start (REQUEST_INTERVAL);
+}
+
+void
+ThumbnailStrip::setFile (const string &path, int pages)
+{
+  mModel.setFile (path, pages);
+  mVisiblePages.clear ();
+  if (isVisible ())
+    requestDocument ();
+}
+
+void
+ThumbnailStrip::setCurrentPage (int pn)
+{
+  if (pn < 0 || pn >= mModel.rowCount (QModelIndex ()))
+    return;
+
+  auto index = mModel.index (pn);
+  if (index == currentIndex ())
+    return;
+
+  setCurrentIndex (index);
+  scrollTo (index, QAbstractItemView::PositionAtCenter);
+}
+
+void
+ThumbnailStrip::showEvent (QShowEvent *event)
+{
+  QListView::showEvent (event);
+  requestDocument ();
+}
+
+void
+ThumbnailStrip::requestDocument ()
+{
+  if (mModel.path ().empty ())
+    return;
+
+  // the rest of the document is rendered when the strip is idle, so it
+  // is complete the next time it is opened
+  vector<int> pages (mModel.rowCount (QModelIndex ()));
+  iota (pages.begin (), pages.end (), 0);
+  ThumbnailCache::instance ()->request (mModel.path (), pages, false);
+}
+
+void
+ThumbnailStrip::requestVisible ()
+{
+  if (!isVisible () || mModel.path ().empty ())
+    return;
+
+  auto width = viewport ()->width ();
+  auto middle = viewport ()->height () / 2;
+  QModelIndex index;
+  for (auto x = 0; !index.isValid () && x < width; x += SCAN_STEP)
+    {
+      index = indexAt (QPoint (x, middle));
+    }
+  if (!index.isValid ())
+    return;
+
+  auto rows = mModel.rowCount (QModelIndex ());
+  auto last = index.row ();
+  while (last + 1 < rows
+         && visualRect (mModel.index (last + 1)).left () < width)
+    {
+      last++;
+    }
+
+  vector<int> pages;
+  auto cache = ThumbnailCache::instance ();
+  // the pages requested on both sides of the strip
+  auto prefetch = ApvlvParams::instance ()->get (IntParam::THUMBNAIL_PREFETCH);
+  auto first = std::max (index.row () - prefetch, 0);
+  last = std::min (last + prefetch, rows - 1);
+  for (auto pn = first; pn <= last; ++pn)
+    {
+      if (cache->find (mModel.path (), pn).isNull ())
+        pages.push_back (pn);
+    }
+
+  // the request replaces the last visible pages, send it when they change
+  if (pages == mVisiblePages)
+    return;
+  mVisiblePages = std::move (pages);
+  cache->request (mModel.path (), mVisiblePages, true);
+}
+
+void
+ThumbnailStrip::onClicked (const QModelIndex &index)
+{
+  if (index.isValid ())
+    emit pageActivated (index.row ());
+}
+
+}
+
+// Local Variables:
+// mode: c++
+// End:
@@ -0,0 +1,212 @@
+/*
+ * This file is part of the apvlv package
+ *
+ * Copyright (C) 2008 Alf.
+ *
+ * Contact: Alf <naihe2010@126.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2.0 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+/* @CPPFILE ApvlvThumbnail.h
+ *
+ *  Author: Alf <naihe2010@126.com>
+ */
+
+#ifndef _APVLV_THUMBNAIL_H_
+#define _APVLV_THUMBNAIL_H_
+
+#include <QAbstractListModel>
+#include <QImage>
+#include <QListView>
+#include <QPixmap>
+#include <QTimer>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace apvlv
+{
+
+class File;
+
+//
+// the page thumbnails of the image documents, rendered at a low zoom by a
+// bounded pool and kept in one file per document in the cache directory
+//
+// The pages shown by the strip are rendered before the other requests,
+// they are replaced on every scroll. Only the offsets of the stored pages
+// and a bounded number of decoded images are kept in memory, the stored
+// pages shown by the strip are decoded by the workers too.
+//
+class ThumbnailCache final : public QObject
+{
+  Q_OBJECT
+public:
+  static ThumbnailCache *
+  instance ()
+  {
+    static ThumbnailCache inst;
+    return &inst;
+  }
+
+  ~ThumbnailCache () override;
+
+  // a null image when the page is not decoded yet, it never reads the
+  // store, the visible requests decode the page and emit rendered
+  QImage find (const std::string &path, int pn);
+
+  void request (const std::string &path, const std::vector<int> &pages,
+                bool visible);
+
+  // the height of the thumbnails
+  static const int THUMBNAIL_HEIGHT = 160;
+
+signals:
+  // emitted by a worker thread
+  void rendered (const QString &path, int pn);
+
+private:
+  ThumbnailCache ();
+
+  struct Task
+  {
+    std::string path;
+    int pn;
+    bool visible{ false };
+  };
+
+  struct Store
+  {
+    std::int64_t mtime{ 0 };
+    std::uintmax_t size{ 0 };
+    // offset and length of the JPEG of every stored page
+    std::unordered_map<int, std::pair<std::streamoff, std::size_t>> pages;
+  };
+
+  // the workers beyond the threads setting idle
+  void workerLoop (int index);
+  bool pop (Task &task);
+  void render (const Task &task, std::string &path,
+               std::unique_ptr<File> &file);
+
+  // reads the store again when the document has changed, without the
+  // lock held
+  void store (const std::string &path);
+  static std::string storePath (const std::string &path);
+  static bool loadStore (const std::string &path, Store &doc);
+  static QImage loadImage (const std::string &path,
+                           const std::pair<std::streamoff, std::size_t> &page);
+  void appendStore (const std::string &path, int pn,
+                    const std::string &bytes);
+
+  void remember (const std::string &key, const QImage &image);
+
+  std::mutex mMutex;
+  // the store files are written under this one
+  std::mutex mWriteMutex;
+  std::unordered_map<std::string, Store> mStores;
+  std::deque<Task> mVisible;
+  std::deque<Task> mQueue;
+  std::string mQueuePath;
+  std::unordered_set<int> mQueued;
+  std::unordered_set<std::string> mRendering;
+
+  // the decoded thumbnails, the most recently used first
+  std::list<std::pair<std::string, QImage>> mImages;
+  std::unordered_map<std::string,
+                     std::list<std::pair<std::string, QImage>>::iterator>
+      mImageIndex;
+
+  std::vector<std::thread> mTasks;
+  std::atomic<int> mWorkers{ 0 };
+  std::atomic<bool> mQuit{ false };
+};
+
+class ThumbnailModel final : public QAbstractListModel
+{
+  Q_OBJECT
+public:
+  ThumbnailModel ();
+
+  void setFile (const std::string &path, int pages);
+
+  [[nodiscard]] const std::string &
+  path () const
+  {
+    return mPath;
+  }
+
+  [[nodiscard]] int rowCount (const QModelIndex &parent) const override;
+  [[nodiscard]] QVariant data (const QModelIndex &index,
+                               int role) const override;
+
+public slots:
+  void onRendered (const QString &path, int pn);
+
+private:
+  std::string mPath;
+  int mPages{ 0 };
+  QPixmap mPlaceholder;
+};
+
+//
+// a horizontal strip of the page thumbnails, only the items on screen
+// are painted and requested
+//
+class ThumbnailStrip final : public QListView
+{
+  Q_OBJECT
+public:
+  ThumbnailStrip ();
+
+  void setFile (const std::string &path, int pages);
+
+  void setCurrentPage (int pn);
+
+signals:
+  void pageActivated (int pn);
+
+protected:
+  void showEvent (QShowEvent *event) override;
+
+private:
+  ThumbnailModel mModel;
+  QTimer mRequestTimer;
+  std::vector<int> mVisiblePages;
+
+  void requestDocument ();
+
+private slots:
+  void requestVisible ();
+  void onClicked (const QModelIndex &index);
+};
+
+}
+
+#endif
+
+/* Local Variables: */
+/* mode: c++ */
+/* End: */
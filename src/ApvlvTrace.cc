@@ -0,0 +1,141 @@
+/*
+ * This file is part of the apvlv package
+ * Copyright (C) <2024> Alf
+ *
+ * Contact: Alf <naihe2010@126.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+/* @CPPFILE ApvlvTrace.cc
+ *
+ *  Author: Alf <naihe2010@126.com>
+ */
+
+#include <QDebug>
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+
+#include "ApvlvTrace.h"
+
+namespace apvlv
+{
+
+using namespace std;
+
+Tracer *
+Tracer::instance ()
+{
+  static Tracer inst;
+  return &inst;
+}
+
+Tracer::ThreadEvents *
+Tracer::threadEvents ()
+{
+  // kept by the tracer too, a pool thread may end before the dump
+  thread_local shared_ptr<ThreadEvents> events;
+  if (!events)
+    {
+      events = make_shared<ThreadEvents> ();
+      auto tracer = instance ();
+      lock_guard<mutex> lock (tracer->mMutex);
+      events->tid = static_cast<int> (tracer->mThreads.size ()) + 1;
+      tracer->mThreads.push_back (events);
+    }
+  return events.get ();
+}
+
+void
+Tracer::record (const char *name, int64_t begin, int64_t end)
+{
+  auto thread = threadEvents ();
+  lock_guard<mutex> lock (thread->mutex);
+  if (thread->events.size () < THREAD_EVENTS)
+    {
+      thread->events.push_back ({ name, begin, end });
+    }
+  else
+    {
+      thread->events[thread->next] = { name, begin, end };
+      thread->next = (thread->next + 1) % THREAD_EVENTS;
+    }
+}
+
+bool
+Tracer::dump (const string &path)
+{
+  vector<pair<int, vector<Event>>> threads;
+  {
+    lock_guard<mutex> lock (mMutex);
+    for (auto const &thread : mThreads)
+      {
+        lock_guard<mutex> thread_lock (thread->mutex);
+        threads.emplace_back (thread->tid, thread->events);
+      }
+  }
+
+  int64_t origin = INT64_MAX;
+  size_t count = 0;
+  for (auto const &[tid, events] : threads)
+    {
+      for (auto const &event : events)
+        origin = std::min (origin, event.begin);
+      count += events.size ();
+    }
+
+  error_code code;
+  filesystem::create_directories (filesystem::path (path).parent_path (),
+                                  code);
+  ofstream ofs{ path, ios::binary | ios::trunc };
+  if (!ofs.is_open ())
+    {
+      qWarning () << "can't write trace " << QString::fromLocal8Bit (path);
+      return false;
+    }
+
+  // the times of the trace events are in microseconds
+  char line[256];
+  auto first = true;
+  ofs << "{\"traceEvents\":[\n";
+  for (auto const &[tid, events] : threads)
+    {
+      for (auto const &event : events)
+        {
+          snprintf (line, sizeof (line),
+                    "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+                    "\"ts\":%.3f,\"dur\":%.3f}",
+                    first ? "" : ",\n", event.name, tid,
+                    static_cast<double> (event.begin - origin) / 1000.0,
+                    static_cast<double> (event.end - event.begin) / 1000.0);
+          ofs << line;
+          first = false;
+        }
+    }
+  ofs << "\n],\"displayTimeUnit\":\"ms\"}\n";
+  ofs.close ();
+
+  qDebug () << "trace of " << count << " spans written to "
+            << QString::fromLocal8Bit (path);
+  return !ofs.fail ();
+}
+
+}
+
+// Local Variables:
+// mode: c++
+// End:
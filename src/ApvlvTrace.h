@@ -0,0 +1,130 @@
+/*
+ * This file is part of the apvlv package
+ * Copyright (C) <2024> Alf
+ *
+ * Contact: Alf <naihe2010@126.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+/* @CPPFILE ApvlvTrace.h
+ *
+ *  Author: Alf <naihe2010@126.com>
+ */
+
+#ifndef _APVLV_TRACE_H_
+#define _APVLV_TRACE_H_
+
+#ifdef APVLV_WITH_TRACE
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace apvlv
+{
+
+//
+// the spans of the main paths, dumped as a Chrome trace that
+// chrome://tracing and Perfetto open
+//
+// Every thread records into its own bounded ring, the oldest spans are
+// overwritten. Without APVLV_WITH_TRACE the spans are compiled out.
+//
+class Tracer final
+{
+public:
+  Tracer (const Tracer &) = delete;
+  const Tracer &operator= (const Tracer &) = delete;
+
+  static Tracer *instance ();
+
+  // the name is a literal, the times are of now ()
+  static void record (const char *name, std::int64_t begin,
+                      std::int64_t end);
+
+  bool dump (const std::string &path);
+
+  static std::int64_t
+  now ()
+  {
+    auto since = std::chrono::steady_clock::now ().time_since_epoch ();
+    return std::chrono::duration_cast<std::chrono::nanoseconds> (since)
+        .count ();
+  }
+
+  static const size_t THREAD_EVENTS = 16384;
+
+private:
+  Tracer () = default;
+
+  struct Event
+  {
+    const char *name;
+    std::int64_t begin;
+    std::int64_t end;
+  };
+
+  struct ThreadEvents
+  {
+    std::mutex mutex;
+    int tid{ 0 };
+    std::vector<Event> events;
+    size_t next{ 0 };
+  };
+
+  static ThreadEvents *threadEvents ();
+
+  std::mutex mMutex;
+  std::vector<std::shared_ptr<ThreadEvents>> mThreads;
+};
+
+class TraceSpan final
+{
+public:
+  explicit TraceSpan (const char *name)
+      : mName (name), mBegin (Tracer::now ())
+  {
+  }
+  ~TraceSpan () { Tracer::record (mName, mBegin, Tracer::now ()); }
+
+  TraceSpan (const TraceSpan &) = delete;
+  const TraceSpan &operator= (const TraceSpan &) = delete;
+
+private:
+  const char *mName;
+  std::int64_t mBegin;
+};
+
+}
+
+#define APVLV_TRACE_VAR2(line) apvlvTraceSpan##line
+#define APVLV_TRACE_VAR(line) APVLV_TRACE_VAR2 (line)
+#define APVLV_TRACE(name) apvlv::TraceSpan APVLV_TRACE_VAR (__LINE__) (name)
+
+#else
+
+#define APVLV_TRACE(name) static_cast<void> (0)
+
+#endif
+
+#endif
+
+/* Local Variables: */
+/* mode: c++ */
+/* End: */
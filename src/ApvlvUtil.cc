@@ -51,6 +51,7 @@ string Translations;
 
 string IniFile;
 string SessionFile;
+string CacheDir;
 string LogFile;
 string NotesDir;
 
@@ -94,13 +95,16 @@ getXdgOrCachePath (const QString &appdir)
     }
 
   SessionFile = appdir.toStdString () + "/apvlvinfo";
+  CacheDir = appdir.toStdString () + "/cache";
   if (!xdgdir.empty ())
     {
       SessionFile = xdgdir + "/apvlvinfo";
+      CacheDir = xdgdir + "/apvlv";
     }
   else if (!homedir.empty ())
     {
       SessionFile = homedir + "/.cache/apvlvinfo";
+      CacheDir = homedir + "/.cache/apvlv";
     }
 }
 
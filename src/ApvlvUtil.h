@@ -47,6 +47,7 @@ extern std::string Translations;
 
 extern std::string IniFile;
 extern std::string SessionFile;
+extern std::string CacheDir;
 extern std::string LogFile;
 extern std::string NotesDir;
 
@@ -36,6 +36,8 @@
 #include "ApvlvInfo.h"
 #include "ApvlvParams.h"
 #include "ApvlvSearchDialog.h"
+#include "ApvlvTrace.h"
+#include "ApvlvUtil.h"
 #include "ApvlvView.h"
 
 namespace apvlv
@@ -94,8 +96,7 @@ ApvlvView::ApvlvView (ApvlvView *parent) : mCmds (this), mSearchDialog (this)
       mParent->appendChild (this);
     }
 
-  auto guiopt
-      = ApvlvParams::instance ()->getStringOrDefault ("guioptions", "mTS");
+  auto guiopt = ApvlvParams::instance ()->get (StringParam::GUIOPTIONS);
 
   mCmdType = CmdStatusType::CMD_NONE;
 
@@ -110,10 +111,10 @@ ApvlvView::ApvlvView (ApvlvView *parent) : mCmds (this), mSearchDialog (this)
 
   processInLast = false;
 
-  int w = ApvlvParams::instance ()->getIntOrDefault ("width");
-  int h = ApvlvParams::instance ()->getIntOrDefault ("height");
+  int w = ApvlvParams::instance ()->get (IntParam::WIDTH);
+  int h = ApvlvParams::instance ()->get (IntParam::HEIGHT);
 
-  if (ApvlvParams::instance ()->getBoolOrDefault ("fullscreen"))
+  if (ApvlvParams::instance ()->get (BoolParam::FULLSCREEN))
     {
       fullScreen ();
     }
@@ -458,8 +459,7 @@ ApvlvView::hasLoaded (string_view abpath)
 void
 ApvlvView::regLoaded (ApvlvFrame *doc)
 {
-  auto cache_count
-      = ApvlvParams::instance ()->getIntOrDefault ("cache_count", 10);
+  auto cache_count = ApvlvParams::instance ()->get (IntParam::CACHE_COUNT);
   if (mDocs.size () >= static_cast<size_t> (cache_count))
     {
       auto found_itr = mDocs.end ();
@@ -1073,6 +1073,18 @@ ApvlvView::runCommand (const char *str)
         {
           currentFrame ()->toggleDirectory ();
         }
+      else if (cmd == "thumbnails")
+        {
+          currentFrame ()->toggleThumbnails ();
+        }
+      else if (cmd == "notes")
+        {
+          // the query is the rest of the command, it has spaces
+          string query{ str };
+          query = query.substr (query.find (cmd) + cmd.size ());
+          mSearchDialog.searchNotes (
+              QString::fromLocal8Bit (query).trimmed ());
+        }
       else if (cmd == "goto" || cmd == "g")
         {
           currentFrame ()->markposition ('\'');
@@ -1115,6 +1127,20 @@ ApvlvView::runCommand (const char *str)
         {
           loadFile (currentFrame ()->filename ());
         }
+      else if (cmd == "trace")
+        {
+#ifdef APVLV_WITH_TRACE
+          auto path = subcmd.empty () ? CacheDir + PATH_SEP_S + "trace.json"
+                                      : subcmd;
+          ret = Tracer::instance ()->dump (path);
+          if (!ret)
+            errorMessage (string ("can't write trace: "), path);
+#else
+          errorMessage (string ("no trace: "),
+                        "build with APVLV_WITH_TRACE");
+          ret = false;
+#endif
+        }
       else
         {
           bool isn = true;
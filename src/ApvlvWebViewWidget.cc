@@ -31,6 +31,7 @@
 #include <sstream>
 
 #include "ApvlvWebViewWidget.h"
+#include "ApvlvTrace.h"
 
 namespace apvlv
 {
@@ -40,6 +41,7 @@ using namespace std;
 void
 ApvlvSchemeHandler::requestStarted (QWebEngineUrlRequestJob *job)
 {
+  APVLV_TRACE ("requestStarted");
   auto url = job->requestUrl ();
   auto path = url.path ().toStdString ();
   auto key = path.substr (1);
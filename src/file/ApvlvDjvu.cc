@@ -27,6 +27,8 @@
 #include <QDebug>
 
 #include "ApvlvDjvu.h"
+#include "ApvlvLog.h"
+#include "ApvlvTrace.h"
 #include "ApvlvUtil.h"
 
 namespace apvlv
@@ -41,7 +43,7 @@ handleDdjvuMessages (ddjvu_context_t *ctx, int wait)
     ddjvu_message_wait (ctx);
   while ((msg = ddjvu_message_peek (ctx)))
     {
-      qDebug () << "tag: " << msg->m_any.tag;
+      qCDebug (lcRender) << "tag: " << msg->m_any.tag;
       switch (msg->m_any.tag)
         {
         case DDJVU_ERROR:
@@ -133,6 +135,7 @@ ApvlvDJVU::sum ()
 bool
 ApvlvDJVU::pageRenderToImage (int pn, double zm, int rot, QImage *pix)
 {
+  APVLV_TRACE ("pageRenderToImage");
   ddjvu_page_t *tpage;
 
   if ((tpage = ddjvu_page_create_by_pageno (mDoc, pn)) == nullptr)
@@ -167,7 +170,7 @@ ApvlvDJVU::pageRenderToImage (int pn, double zm, int rot, QImage *pix)
     {
       this_thread::sleep_for (50ms);
       ++retry;
-      qDebug () << "fender failed, retry " << retry;
+      qCDebug (lcRender) << "fender failed, retry " << retry;
     }
 
   auto image = QImage (ix, iy, QImage::Format_RGB888);
@@ -76,6 +76,17 @@ ApvlvEPUB::load (const string &filename)
     }
 
   ncxSetIndex (idSrcs["ncx"]);
+
+  // some books have a cover page instead of a cover image
+  auto cover = idSrcs.find ("cover");
+  if (cover != idSrcs.end ()
+      && srcMimeTypes[cover->second].starts_with ("image/"))
+    {
+      auto content
+          = getZipFileContents (QString::fromLocal8Bit (cover->second));
+      if (content)
+        mCover = { content->toStdString (), srcMimeTypes[cover->second] };
+    }
   return true;
 }
 
@@ -168,7 +179,19 @@ ApvlvEPUB::contentGetMedia (const string &contentfile)
           && !(xml->isEndElement () && xml->name ().toString () == "metadata"))
         {
           xml->readNext ();
-          if (xml->isStartElement () && xml->name ().toString () == "meta")
+          if (xml->isStartElement () && xml->name ().toString () == "title"
+              && mMetadata.title.empty ())
+            {
+              mMetadata.title = xml->readElementText ().toStdString ();
+            }
+          else if (xml->isStartElement ()
+                   && xml->name ().toString () == "creator"
+                   && mMetadata.author.empty ())
+            {
+              mMetadata.author = xml->readElementText ().toStdString ();
+            }
+          else if (xml->isStartElement ()
+                   && xml->name ().toString () == "meta")
             {
               auto attrs = xml->attributes ();
               for (auto const &attr : attrs)
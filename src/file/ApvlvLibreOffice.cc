@@ -131,8 +131,9 @@ ApvlvOFFICE::initLokInstance ()
   lock_guard<mutex> lk (mLokMutex);
   if (mOffice == nullptr)
     {
-      auto lok_path = ApvlvParams::instance ()->getStringOrDefault (
-          "lok_path", DEFAULT_LOK_PATH);
+      auto lok_path = ApvlvParams::instance ()->get (StringParam::LOK_PATH);
+      if (lok_path.empty ())
+        lok_path = DEFAULT_LOK_PATH;
       mOffice
           = unique_ptr<lok::Office>{ lok::lok_cpp_init (lok_path.c_str ()) };
     }
@@ -30,6 +30,7 @@
 #include <mupdf/fitz.h>
 
 #include "ApvlvMuPdf.h"
+#include "ApvlvTrace.h"
 
 namespace apvlv
 {
@@ -60,6 +61,16 @@ ApvlvMuPDF::load (const string &filename)
       return false;
     }
 
+  char value[256];
+  if (fz_lookup_metadata (mContext, mDoc, FZ_META_INFO_TITLE, value,
+                          sizeof (value))
+      > 0)
+    mMetadata.title = value;
+  if (fz_lookup_metadata (mContext, mDoc, FZ_META_INFO_AUTHOR, value,
+                          sizeof (value))
+      > 0)
+    mMetadata.author = value;
+
   generateIndex ();
   return true;
 }
@@ -100,17 +111,26 @@ ApvlvMuPDF::pageIsOnlyImage (int pn)
 bool
 ApvlvMuPDF::pageRenderToImage (int pn, double zm, int rot, QImage *pix)
 {
+  APVLV_TRACE ("pageRenderToImage");
   auto scale = fz_scale (static_cast<float> (zm), static_cast<float> (zm));
   auto mat = fz_pre_rotate (scale, static_cast<float> (rot));
   auto color = fz_device_rgb (mContext);
-  auto pixmap
-      = fz_new_pixmap_from_page_number (mContext, mDoc, pn, mat, color, 0);
+  fz_pixmap *pixmap;
+  {
+    APVLV_TRACE ("pageRenderToImage.render");
+    pixmap = fz_new_pixmap_from_page_number (mContext, mDoc, pn, mat, color,
+                                             0);
+  }
   if (pixmap == nullptr)
     return false;
 
-  auto comments = mNote.getCommentsInPage (pn);
-  pageRenderComments (pn, pixmap, comments, mat);
+  {
+    APVLV_TRACE ("pageRenderToImage.comments");
+    auto comments = mNote.getCommentsInPage (pn);
+    pageRenderComments (pn, pixmap, comments, mat);
+  }
 
+  APVLV_TRACE ("pageRenderToImage.convert");
   QImage img{ pixmap->w, pixmap->h, QImage::Format_RGB32 };
   for (auto y = 0; y < pixmap->h; ++y)
     {
@@ -195,7 +215,7 @@ ApvlvMuPDF::pageSearch (int pn, const char *str)
 
 void
 ApvlvMuPDF::pageRenderComments (int pn, fz_pixmap *pixmap,
-                                const vector<Comment> &comments,
+                                const PageComments &comments,
                                 const fz_matrix &mat)
 {
   if (comments.empty ())
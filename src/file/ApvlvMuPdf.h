@@ -72,7 +72,7 @@ private:
   fz_document *mDoc;
 
   void pageRenderComments (int pn, fz_pixmap *pixmap,
-                           const std::vector<Comment> &comments,
+                           const PageComments &comments,
                            const fz_matrix &mat);
   void generateIndex ();
   void generateIndexRecursively (FileIndex &index, const fz_outline *outline);
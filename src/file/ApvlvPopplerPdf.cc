@@ -24,13 +24,16 @@
  *  Author: Alf <naihe2010@126.com>
  */
 
+#include <QApplication>
 #include <QInputDialog>
 #include <QMessageBox>
+#include <QThread>
 #include <filesystem>
 #include <fstream>
 #include <qt6/poppler-qt6.h>
 
 #include "ApvlvPopplerPdf.h"
+#include "ApvlvTrace.h"
 #include "ApvlvView.h"
 
 namespace apvlv
@@ -44,7 +47,8 @@ bool
 ApvlvPopplerPDF::load (const string &filename)
 {
   mDoc = Document::load (QString::fromLocal8Bit (filename));
-  if (mDoc == nullptr)
+  if (mDoc == nullptr
+      && QThread::currentThread () == QApplication::instance ()->thread ())
     {
       auto text
           = QInputDialog::getText (nullptr, "password", "input password");
@@ -57,6 +61,9 @@ ApvlvPopplerPDF::load (const string &filename)
       return false;
     }
 
+  mMetadata.title = mDoc->info ("Title").toStdString ();
+  mMetadata.author = mDoc->info ("Author").toStdString ();
+
   generateIndex ();
   return true;
 }
@@ -115,6 +122,7 @@ ApvlvPopplerPDF::pageIsOnlyImage (int pn)
 bool
 ApvlvPopplerPDF::pageRenderToImage (int pn, double zm, int rot, QImage *pix)
 {
+  APVLV_TRACE ("pageRenderToImage");
   if (mDoc == nullptr)
     return false;
 
@@ -34,6 +34,7 @@
 #include <fstream>
 
 #include "ApvlvQtPdf.h"
+#include "ApvlvTrace.h"
 #include "ApvlvUtil.h"
 
 namespace apvlv
@@ -75,6 +76,10 @@ ApvlvPDF::load (const string &filename)
   mSearchModel = make_unique<QPdfSearchModel> ();
   mSearchModel->setDocument (mDoc.get ());
 
+  using enum QPdfDocument::MetaDataField;
+  mMetadata.title = mDoc->metaData (Title).toString ().toStdString ();
+  mMetadata.author = mDoc->metaData (Author).toString ().toStdString ();
+
   generateIndex ();
   return true;
 }
@@ -143,6 +148,7 @@ ApvlvPDF::pageIsOnlyImage (int pn)
 bool
 ApvlvPDF::pageRenderToImage (int pn, double zm, int rot, QImage *pix)
 {
+  APVLV_TRACE ("pageRenderToImage");
   if (mDoc == nullptr)
     return false;
 
@@ -159,10 +165,14 @@ ApvlvPDF::pageRenderToImage (int pn, double zm, int rot, QImage *pix)
   QPdfDocumentRenderOptions options{};
   options.setRotation (prot);
   options.setScaledSize (image_size);
-  *pix = mDoc->render (pn, image_size, options);
+  {
+    APVLV_TRACE ("pageRenderToImage.render");
+    *pix = mDoc->render (pn, image_size, options);
+  }
 
   if (auto comments = mNote.getCommentsInPage (pn); !comments.empty ())
     {
+      APVLV_TRACE ("pageRenderToImage.comments");
       pageRenderComments (pn, pix, comments);
     }
 
@@ -183,7 +193,7 @@ ApvlvPDF::pageText (int pn, const Rectangle &rect, string &text)
 
 void
 ApvlvPDF::pageRenderComments (int pn, QImage *img,
-                          const std::vector<Comment> &comments)
+                          const PageComments &comments)
 {
   auto model = make_unique<QPdfSearchModel> ();
   model->setDocument (mDoc.get ());
@@ -141,6 +141,7 @@ parseCommandLine (const QCoreApplication &app)
    * */
   qDebug () << "using config: " << IniFile;
   ApvlvParams::instance ()->loadFile (IniFile);
+  ApvlvParams::instance ()->watch ();
 
   list<string> paths;
   auto pathlist = parser.positionalArguments ();
@@ -193,6 +194,11 @@ main (int argc, char *argv[])
                                                                 NotesDir);
 
   ApvlvLog::instance ()->setLogFile (LogFile);
+  QObject::connect (ApvlvParams::instance (), &ApvlvParams::changed,
+                    [] (const QString &key) {
+                      if (key.startsWith ("log:"))
+                        ApvlvLog::setFilterRules ();
+                    });
 
   string path = HelpPdf;
   if (!paths.empty ())
@@ -0,0 +1,309 @@
+/*
+ * This file is part of the apvlv package
+ *
+ * Copyright (C) 2008 Alf.
+ *
+ * Contact: Alf <naihe2010@126.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2.0 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+/* @CPPFILE testFileIndex.cc
+ *
+ *  Author: Alf <naihe2010@126.com>
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <stack>
+#include <thread>
+
+#include "ApvlvFileIndex.h"
+#include "ApvlvUtil.h"
+
+//
+// count the heap usage, every block has its size before it
+//
+static std::atomic<size_t> allocations = 0;
+static std::atomic<size_t> allocated_bytes = 0;
+
+void *
+operator new (size_t size)
+{
+  auto block = static_cast<size_t *> (malloc (size + sizeof (max_align_t)));
+  if (block == nullptr)
+    throw std::bad_alloc ();
+  *block = size;
+  allocations++;
+  allocated_bytes += size;
+  return reinterpret_cast<char *> (block) + sizeof (max_align_t);
+}
+
+void
+operator delete (void *ptr) noexcept
+{
+  if (ptr == nullptr)
+    return;
+  auto block = reinterpret_cast<size_t *> (static_cast<char *> (ptr)
+                                           - sizeof (max_align_t));
+  allocated_bytes -= *block;
+  free (block);
+}
+
+void
+operator delete (void *ptr, size_t) noexcept
+{
+  operator delete (ptr);
+}
+
+using namespace std;
+using namespace apvlv;
+
+// a library of 100 directories of 100 directories of 9 files
+const int FANOUT = 100;
+const int FILES = 9;
+
+static FileIndex
+buildLibrary ()
+{
+  FileIndex root ("", 0, "/home/user/library", FileIndexType::DIR);
+  for (int i = 0; i < FANOUT; ++i)
+    {
+      auto title = "author " + to_string (i);
+      FileIndex author (title, 0, root.path + "/" + title,
+                        FileIndexType::DIR);
+      for (int j = 0; j < FANOUT; ++j)
+        {
+          auto title2 = "series " + to_string (j);
+          FileIndex series (title2, 0, author.path + "/" + title2,
+                            FileIndexType::DIR);
+          for (int k = 0; k < FILES; ++k)
+            {
+              auto title3 = "volume " + to_string (k) + ".pdf";
+              FileIndex file (title3, 0, series.path + "/" + title3,
+                              FileIndexType::FILE);
+              file.size = 1024 * 1024;
+              file.mtime = 1700000000 + k;
+              series.mChildrenIndex.emplace_back (std::move (file));
+            }
+          author.mChildrenIndex.emplace_back (std::move (series));
+        }
+      root.mChildrenIndex.emplace_back (std::move (author));
+    }
+  return root;
+}
+
+static size_t
+walk (const FileIndex &index)
+{
+  size_t length = index.title.size () + index.path.size ();
+  for (auto const &child : index.mChildrenIndex)
+    length += walk (child);
+  return length;
+}
+
+static size_t
+walk (const FileIndexTree &tree)
+{
+  size_t length = 0;
+  stack<FileIndexTree::Id> ids;
+  ids.push (tree.root ());
+  while (!ids.empty ())
+    {
+      auto id = ids.top ();
+      ids.pop ();
+      length += tree.title (id).size ();
+      for (auto child : tree.children (id))
+        ids.push (child);
+    }
+  return length;
+}
+
+static double
+milliseconds (chrono::steady_clock::time_point begin)
+{
+  chrono::duration<double, milli> elapsed = chrono::steady_clock::now ()
+                                            - begin;
+  return elapsed.count ();
+}
+
+static void
+report (const char *name, size_t nodes, size_t allocs, size_t bytes,
+        double build, double walk)
+{
+  cout << name << ": " << nodes << " nodes, " << allocs << " allocations, "
+       << bytes << " bytes (" << bytes / nodes << " per node), build "
+       << build << " ms, walk " << walk << " ms" << endl;
+}
+
+// the scan of the tree before DirectoryScanner, one thread and a stat
+// call for every property
+static size_t
+scanRecursive (const filesystem::path &path, const vector<string> &exts)
+{
+  size_t files = 0;
+  for (auto &entry : filesystem::directory_iterator (path))
+    {
+      if (entry.is_directory ())
+        {
+          files += scanRecursive (entry.path (), exts);
+          entry.last_write_time ();
+        }
+      else if (entry.file_size () > 0)
+        {
+          auto ext = filenameExtension (entry.path ().string ());
+          if (std::ranges::find (exts, ext) != exts.end ())
+            {
+              entry.last_write_time ();
+              files++;
+            }
+        }
+    }
+  return files;
+}
+
+static size_t
+countFiles (const FileIndexTree &tree)
+{
+  size_t files = 0;
+  for (FileIndexTree::Id id = 0; id < tree.capacity (); ++id)
+    {
+      if (tree.node (id).type == FileIndexType::FILE)
+        files++;
+    }
+  return files;
+}
+
+static void
+makeFiles (const filesystem::path &dir, int count)
+{
+  filesystem::create_directories (dir);
+  for (int i = 0; i < count; ++i)
+    {
+      ofstream (dir / ("book " + to_string (i) + ".pdf")) << "%PDF";
+      ofstream (dir / ("notes " + to_string (i) + ".txt")) << "text";
+    }
+}
+
+// wide is 2000 directories of 5 books, deep is 10 chains of 200
+// directories of 3 books, every book has a text file beside it
+static bool
+benchmarkScan (const char *name, const filesystem::path &root,
+               size_t expected)
+{
+  vector<string> exts{ ".pdf", ".epub", ".djvu", ".cbz", ".txt.gz" };
+  auto begin = chrono::steady_clock::now ();
+  auto files = scanRecursive (root, exts);
+  auto recursive = milliseconds (begin);
+
+  cout << name << ": " << files << " files, recursive " << recursive
+       << " ms";
+  for (auto threads : { 1u, max (thread::hardware_concurrency (), 1u) })
+    {
+      DirectoryScanner scanner (exts, threads);
+      FileIndexTree tree (FileIndex ("", 0, root.string (),
+                                     FileIndexType::DIR));
+      begin = chrono::steady_clock::now ();
+      scanner.scan (tree, { tree.root () }, [] (auto) { return true; });
+      cout << ", " << threads << " threads " << milliseconds (begin)
+           << " ms";
+      if (countFiles (tree) != expected)
+        files = 0;
+    }
+  cout << endl;
+
+  if (files != expected)
+    {
+      cerr << name << ": the scans found different files" << endl;
+      return false;
+    }
+  return true;
+}
+
+int
+main ()
+{
+  auto nodes = 1 + FANOUT + FANOUT * FANOUT * (1 + FILES);
+
+  size_t allocs = allocations;
+  size_t bytes = allocated_bytes;
+  auto begin = chrono::steady_clock::now ();
+  auto library = buildLibrary ();
+  auto build = milliseconds (begin);
+  allocs = allocations - allocs;
+  bytes = allocated_bytes - bytes;
+
+  begin = chrono::steady_clock::now ();
+  auto length = walk (library);
+  report ("FileIndex", nodes, allocs, bytes, build, milliseconds (begin));
+
+  allocs = allocations;
+  bytes = allocated_bytes;
+  begin = chrono::steady_clock::now ();
+  FileIndexTree tree (library);
+  build = milliseconds (begin);
+  allocs = allocations - allocs;
+  bytes = allocated_bytes - bytes;
+
+  begin = chrono::steady_clock::now ();
+  auto tree_length = walk (tree);
+  report ("FileIndexTree", tree.capacity (), allocs, bytes, build,
+          milliseconds (begin));
+
+  // the tree keeps the paths and the order of the children
+  auto copy = tree.toFileIndex (tree.root (), true);
+  if (tree.capacity () != static_cast<size_t> (nodes) || walk (copy) != length
+      || tree_length > length || !(copy.mChildrenIndex == library.mChildrenIndex))
+    {
+      cerr << "the tree is not the same as the index" << endl;
+      return 1;
+    }
+
+  auto file = tree.child (tree.child (tree.child (0, 42), 7), 3);
+  if (tree.path (file) != "/home/user/library/author 42/series 7/volume 3.pdf")
+    {
+      cerr << "bad path: " << tree.path (file) << endl;
+      return 1;
+    }
+
+  auto scan_root = filesystem::temp_directory_path () / "apvlv-scan-bench";
+  filesystem::remove_all (scan_root);
+  for (int i = 0; i < 2000; ++i)
+    makeFiles (scan_root / "wide" / ("dir " + to_string (i)), 5);
+  for (int i = 0; i < 10; ++i)
+    {
+      auto dir = scan_root / "deep" / ("chain " + to_string (i));
+      for (int j = 0; j < 200; ++j)
+        {
+          makeFiles (dir, 3);
+          dir /= "level " + to_string (j);
+        }
+    }
+
+  auto scanned = benchmarkScan ("wide", scan_root / "wide", 2000 * 5)
+                 && benchmarkScan ("deep", scan_root / "deep", 10 * 200 * 3);
+  filesystem::remove_all (scan_root);
+  return scanned ? 0 : 1;
+}
+
+// Local Variables:
+// mode: c++
+// End:
@@ -25,14 +25,18 @@
  *  Author: Alf <naihe2010@126.com>
  */
 
+#include <algorithm>
+#include <chrono>
 #include <filesystem>
 #include <fstream>
+#include <iostream>
 
 #include "ApvlvNote.h"
 
 namespace apvlv
 {
 std::string NotesDir = "/tmp";
+std::string CacheDir = "/tmp";
 }
 
 using namespace std;
@@ -74,5 +78,52 @@ main (int argc, const char *argv[])
   note1.dumpStream (fos2);
   fos2.close ();
 
+  // a heavily annotated book
+  auto big = Note{ nullptr };
+  for (auto i = 0; i < 10000; ++i)
+    {
+      auto comment = Comment{};
+      comment.quoteText = "quote " + to_string (i)
+                          + " with *markdown* [chars]\n\n# and lines\n";
+      comment.commentText = "comment " + to_string (i) + "\n```\n";
+      comment.begin = Location{ i / 10, 1.0, 2.0 + i % 10, i };
+      comment.end = Location{ i / 10, 2.0, 3.0 + i % 10, i + 1 };
+      big.addComment (comment);
+    }
+
+  auto start = chrono::steady_clock::now ();
+  auto bos = ofstream{ "/tmp/testNote3.md" };
+  big.dumpStream (bos);
+  bos.close ();
+  auto dumped = chrono::steady_clock::now ();
+
+  auto bis = ifstream{ "/tmp/testNote3.md" };
+  auto loaded = Note{ nullptr };
+  loaded.loadStream (bis);
+  auto finished = chrono::steady_clock::now ();
+
+  cout << "10000 comments: dump "
+       << chrono::duration_cast<chrono::milliseconds> (dumped - start).count ()
+       << " ms, load "
+       << chrono::duration_cast<chrono::milliseconds> (finished - dumped)
+              .count ()
+       << " ms" << endl;
+
+  // the texts are read back as they are written
+  for (auto page = 0; page < 1000; ++page)
+    {
+      auto written = big.getCommentsInPage (page);
+      auto read = loaded.getCommentsInPage (page);
+      if (!std::ranges::equal (written, read, [] (auto &a, auto &b) {
+            return a.quoteText == b.quoteText
+                   && a.commentText == b.commentText
+                   && a.end.offset == b.end.offset;
+          }))
+        {
+          cerr << "comments of page " << page << " differ" << endl;
+          return 1;
+        }
+    }
+
   return 0;
 }
\ No newline at end of file